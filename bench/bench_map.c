@@ -0,0 +1,78 @@
+// Header file
+#include "../include/map.h"
+
+
+/// Estimated bytes of an entry with 8 byte key and value at the average
+/// load factor, used to size the working set
+#define BENCH_MAP_ENTRY 32
+
+
+
+void bench_map(BenchConfig *config) {
+    size_t sets[4];
+    const size_t set_count = bench_working_sets(config, sets);
+    for (size_t s = 0; s < set_count; ++s) {
+        const size_t n = sets[s] / BENCH_MAP_ENTRY;
+        const size_t queries = BENCH_QUERIES;
+        const size_t removes = n < BENCH_QUERIES ? n : BENCH_QUERIES;
+        uint64_t *inserts = malloc(n * sizeof(uint64_t));
+        uint64_t *keys = malloc(queries * sizeof(uint64_t));
+        if (inserts == NULL || keys == NULL) {
+            fprintf(stderr, "bench_map: out of memory\n");
+            exit(1);
+        }
+
+        for (int dist = 0; dist < BENCH_DISTS; ++dist) {
+            Map *map = map_init(malloc, free, NULL, sizeof(uint64_t), sizeof(uint64_t));
+            if (map == NULL || !bench_keys(inserts, n, n, (BenchDist)dist, 1) ||
+                    !bench_keys(keys, queries, n, (BenchDist)dist, 2)) {
+                exit(1);
+            }
+
+            // Zipfian inserts repeat keys, the missing ones are added untimed
+            BenchRun run;
+            if (!bench_run_begin(config, &run, "map", "put", (BenchDist)dist, n, sets[s], n)) {
+                exit(1);
+            }
+            BENCH_LOOP(&run, n, map_put(map, inserts + i, inserts + i););
+            bench_run_end(config, &run);
+            for (uint64_t key = 0; key < n; ++key) {
+                map_put(map, &key, &key);
+            }
+
+            if (!bench_run_begin(config, &run, "map", "get", (BenchDist)dist, n, sets[s], queries)) {
+                exit(1);
+            }
+            uint64_t found = 0;
+            BENCH_LOOP(&run, queries, found += map_get(map, keys + i) != NULL;);
+            bench_sink = found;
+            bench_run_end(config, &run);
+
+            // One map_get_batch call per timed batch
+            if (!bench_run_begin(config, &run, "map", "get_batch", (BenchDist)dist, n, sets[s], queries)) {
+                exit(1);
+            }
+            void *out[BENCH_BATCH];
+            for (size_t start = 0; start < queries; start += BENCH_BATCH) {
+                const size_t count = queries - start < BENCH_BATCH ? queries - start : BENCH_BATCH;
+                const uint64_t t0 = bench_now_ns();
+                found += map_get_batch(map, keys + start, count, out);
+                bench_sample(&run, bench_now_ns() - t0, count);
+            }
+            bench_sink = found;
+            bench_run_end(config, &run);
+
+            if (!bench_run_begin(config, &run, "map", "remove", (BenchDist)dist, n, sets[s], removes)) {
+                exit(1);
+            }
+            BENCH_LOOP(&run, removes, found += map_remove(map, keys + i););
+            bench_sink = found;
+            bench_run_end(config, &run);
+
+            map_free(map);
+        }
+
+        free(inserts);
+        free(keys);
+    }
+}
@@ -0,0 +1,70 @@
+// Header file
+#include "../include/tree.h"
+
+
+/// Estimated bytes of a node with an 8 byte key, used to size the working set
+#define BENCH_TREE_NODE 48
+
+
+
+static int bench_compare_u64(const void *a, const void *b, size_t size) {
+    (void)size;
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+
+void bench_tree(BenchConfig *config) {
+    size_t sets[4];
+    const size_t set_count = bench_working_sets(config, sets);
+    for (size_t s = 0; s < set_count; ++s) {
+        const size_t n = sets[s] / BENCH_TREE_NODE;
+        const size_t queries = BENCH_QUERIES;
+        const size_t deletes = n < BENCH_QUERIES ? n : BENCH_QUERIES;
+        uint64_t *inserts = malloc(n * sizeof(uint64_t));
+        uint64_t *keys = malloc(queries * sizeof(uint64_t));
+        if (inserts == NULL || keys == NULL) {
+            fprintf(stderr, "bench_tree: out of memory\n");
+            exit(1);
+        }
+
+        for (int dist = 0; dist < BENCH_DISTS; ++dist) {
+            Tree *tree = tree_init(sizeof(uint64_t), malloc, free, bench_compare_u64);
+            if (tree == NULL || !bench_keys(inserts, n, n, (BenchDist)dist, 1) ||
+                    !bench_keys(keys, queries, n, (BenchDist)dist, 2)) {
+                exit(1);
+            }
+
+            // Zipfian inserts repeat keys, the missing ones are added untimed
+            BenchRun run;
+            if (!bench_run_begin(config, &run, "tree", "insert", (BenchDist)dist, n, sets[s], n)) {
+                exit(1);
+            }
+            BENCH_LOOP(&run, n, tree_insert(tree, inserts + i, sizeof(uint64_t)););
+            bench_run_end(config, &run);
+            for (uint64_t key = 0; key < n; ++key) {
+                tree_insert(tree, &key, sizeof(key));
+            }
+
+            if (!bench_run_begin(config, &run, "tree", "lookup", (BenchDist)dist, n, sets[s], queries)) {
+                exit(1);
+            }
+            uint64_t found = 0;
+            BENCH_LOOP(&run, queries, found += tree_lookup(tree, keys + i) != NULL;);
+            bench_sink = found;
+            bench_run_end(config, &run);
+
+            if (!bench_run_begin(config, &run, "tree", "delete", (BenchDist)dist, n, sets[s], deletes)) {
+                exit(1);
+            }
+            BENCH_LOOP(&run, deletes, tree_delete(tree, keys + i););
+            bench_run_end(config, &run);
+
+            tree_free(tree);
+        }
+
+        free(inserts);
+        free(keys);
+    }
+}
@@ -0,0 +1,332 @@
+// Libraries
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/perf.h"
+
+
+/// Shared harness of the benchmarks. Operations are timed in batches of
+/// BENCH_BATCH, a clock read per operation would cost more than most of the
+/// operations themselves. Percentiles are over the ns/op of the batches.
+
+
+/// Operations per timed batch
+#define BENCH_BATCH 64
+
+/// Lookups and deletions per run, inserts always build the whole container
+#define BENCH_QUERIES ((size_t)1 << 20)
+
+/// Skew of the Zipfian distribution, the value YCSB uses
+#define BENCH_ZIPF_THETA 0.99
+
+
+typedef enum {
+    BENCH_SEQ,
+    BENCH_RANDOM,
+    BENCH_ZIPF,
+    BENCH_DISTS,
+} BenchDist;
+
+static const char *const bench_dist_names[BENCH_DISTS] = {"sequential", "random", "zipfian"};
+
+
+/// Settings and cache sizes of a run
+typedef struct {
+    size_t l1_bytes;
+    size_t l2_bytes;
+    size_t llc_bytes;
+    size_t max_bytes; /* Largest working set that is measured */
+    const char *only; /* Container to run, NULL for all */
+    int first_result; /* No result was printed yet */
+    DsPerf *perf; /* Hardware counters of every run, NULL if not requested */
+} BenchConfig;
+
+
+/// One measured operation
+typedef struct {
+    const char *container;
+    const char *op;
+    BenchDist dist;
+    size_t size; /* Elements in the container */
+    size_t ws_bytes; /* Estimated working set */
+    double *samples; /* ns/op of every batch */
+    size_t batches;
+    size_t ops;
+    uint64_t total_ns;
+    DsPerf *perf;
+} BenchRun;
+
+
+/// Keeps the compiler from dropping the measured operations
+static volatile uint64_t bench_sink;
+
+
+
+static uint64_t bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+
+/// splitmix64, every run uses the same seed so runs can be compared
+static uint64_t bench_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+
+
+/// Size of the cache of [level] from sysfs, [fallback] if it is not there
+static size_t bench_cache_bytes(const int level, const size_t fallback) {
+    size_t largest = 0;
+    for (int index = 0; index < 8; ++index) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        FILE *file = fopen(path, "r");
+        if (file == NULL) {
+            break;
+        }
+        int found = 0;
+        const int ok = fscanf(file, "%d", &found) == 1;
+        fclose(file);
+        if (!ok || found != level) {
+            continue;
+        }
+
+        // Instruction caches do not hold data
+        char type[32] = "";
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        file = fopen(path, "r");
+        if (file != NULL) {
+            if (fscanf(file, "%31s", type) != 1) {
+                type[0] = '\0';
+            }
+            fclose(file);
+        }
+        if (strcmp(type, "Instruction") == 0) {
+            continue;
+        }
+
+        unsigned long size = 0;
+        char unit = '\0';
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        file = fopen(path, "r");
+        if (file != NULL) {
+            if (fscanf(file, "%lu%c", &size, &unit) < 1) {
+                size = 0;
+            }
+            fclose(file);
+        }
+        size *= unit == 'K' ? 1024 : unit == 'M' ? 1024 * 1024 : 1;
+        if (size > largest) {
+            largest = size;
+        }
+    }
+    return largest == 0 ? fallback : largest;
+}
+
+
+
+/// Working sets from L1 resident to 10 times the last level cache, each
+/// capped at [config->max_bytes]. Returns the number written to [out].
+static size_t bench_working_sets(const BenchConfig *config, size_t out[4]) {
+    const size_t wanted[4] = {config->l1_bytes / 2, config->l2_bytes / 2, config->llc_bytes / 2,
+            config->llc_bytes * 10};
+    size_t count = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        if (wanted[i] <= config->max_bytes && (count == 0 || wanted[i] > out[count - 1])) {
+            out[count++] = wanted[i];
+        }
+    }
+    return count;
+}
+
+
+
+/// Shuffle [keys] with Fisher-Yates
+static void bench_shuffle(uint64_t *keys, const size_t n, uint64_t *state) {
+    for (size_t i = n; i > 1; --i) {
+        const size_t j = bench_random(state) % i;
+        const uint64_t tmp = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = tmp;
+    }
+}
+
+
+
+/// Zipfian ranks in [0, n) after Gray et al., "Quickly generating
+/// billion-record synthetic databases"
+typedef struct {
+    size_t n;
+    double alpha;
+    double zetan;
+    double eta;
+    double half_pow;
+} BenchZipf;
+
+static void bench_zipf_init(BenchZipf *zipf, const size_t n) {
+    double zetan = 0;
+    for (size_t i = 1; i <= n; ++i) {
+        zetan += 1.0 / pow((double)i, BENCH_ZIPF_THETA);
+    }
+    const double zeta2 = 1.0 + 1.0 / pow(2.0, BENCH_ZIPF_THETA);
+    zipf->n = n;
+    zipf->alpha = 1.0 / (1.0 - BENCH_ZIPF_THETA);
+    zipf->zetan = zetan;
+    zipf->eta = (1.0 - pow(2.0 / (double)n, 1.0 - BENCH_ZIPF_THETA)) / (1.0 - zeta2 / zetan);
+    zipf->half_pow = 1.0 + pow(0.5, BENCH_ZIPF_THETA);
+}
+
+static size_t bench_zipf_next(const BenchZipf *zipf, uint64_t *state) {
+    const double u = (double)(bench_random(state) >> 11) / 9007199254740992.0;
+    const double uz = u * zipf->zetan;
+    if (uz < 1.0) {
+        return 0;
+    }
+    if (uz < zipf->half_pow) {
+        return zipf->n > 1 ? 1 : 0;
+    }
+    const size_t rank = (size_t)((double)zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return rank < zipf->n ? rank : zipf->n - 1;
+}
+
+
+
+/// Fill [out] with [count] keys in [0, n) in the order of [dist]
+///
+/// Sequential keys count up and wrap around, random keys are a permutation
+/// of [0, n) repeated as often as needed and Zipfian keys are ranks of a
+/// Zipfian distribution mapped through a permutation, so the hot keys are
+/// spread over the key space.
+static int bench_keys(uint64_t *out, const size_t count, const size_t n, const BenchDist dist, uint64_t seed) {
+    if (dist == BENCH_SEQ) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = i % n;
+        }
+        return 1;
+    }
+
+    uint64_t *perm = malloc(n * sizeof(uint64_t));
+    if (perm == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        perm[i] = i;
+    }
+    bench_shuffle(perm, n, &seed);
+
+    if (dist == BENCH_RANDOM) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = perm[i % n];
+        }
+    } else {
+        BenchZipf zipf;
+        bench_zipf_init(&zipf, n);
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = perm[bench_zipf_next(&zipf, &seed)];
+        }
+    }
+    free(perm);
+    return 1;
+}
+
+
+
+/// Start [run], the counters of config->perf run until `bench_run_end`. They
+/// also see the two clock reads per batch, which is noise next to BENCH_BATCH
+/// operations.
+static int bench_run_begin(const BenchConfig *config, BenchRun *run, const char *container, const char *op, const BenchDist dist,
+        const size_t size, const size_t ws_bytes, const size_t ops) {
+    run->container = container;
+    run->op = op;
+    run->dist = dist;
+    run->size = size;
+    run->ws_bytes = ws_bytes;
+    run->batches = 0;
+    run->ops = 0;
+    run->total_ns = 0;
+    run->perf = config->perf;
+    run->samples = malloc((ops / BENCH_BATCH + 1) * sizeof(double));
+    if (run->samples == NULL) {
+        return 0;
+    }
+    ds_perf_begin(run->perf);
+    return 1;
+}
+
+static void bench_sample(BenchRun *run, const uint64_t ns, const size_t ops) {
+    run->samples[run->batches++] = (double)ns / (double)ops;
+    run->ops += ops;
+    run->total_ns += ns;
+}
+
+
+
+static int bench_compare_double(const void *a, const void *b) {
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double bench_percentile(const double *sorted, const size_t count, const double p) {
+    if (count == 0) {
+        return 0;
+    }
+    const size_t index = (size_t)(p * (double)(count - 1) + 0.5);
+    return sorted[index];
+}
+
+
+
+/// Print [run] as one JSON object of the results array and release it
+static void bench_run_end(BenchConfig *config, BenchRun *run) {
+    DsPerfCounts counts;
+    ds_perf_end(run->perf, &counts);
+
+    qsort(run->samples, run->batches, sizeof(double), bench_compare_double);
+    const double ns_per_op = run->ops == 0 ? 0 : (double)run->total_ns / (double)run->ops;
+
+    printf("%s\n    {\"container\": \"%s\", \"op\": \"%s\", \"dist\": \"%s\", \"size\": %zu, \"ws_bytes\": %zu, "
+            "\"ops\": %zu, \"ns_per_op\": %.2f, \"mops_per_s\": %.2f, "
+            "\"p50_ns\": %.2f, \"p90_ns\": %.2f, \"p99_ns\": %.2f, \"p999_ns\": %.2f",
+            config->first_result ? "" : ",", run->container, run->op, bench_dist_names[run->dist], run->size,
+            run->ws_bytes, run->ops, ns_per_op, ns_per_op == 0 ? 0 : 1000.0 / ns_per_op,
+            bench_percentile(run->samples, run->batches, 0.5), bench_percentile(run->samples, run->batches, 0.9),
+            bench_percentile(run->samples, run->batches, 0.99),
+            bench_percentile(run->samples, run->batches, 0.999));
+    if (run->perf != NULL) {
+        printf(", \"per_op\": ");
+        ds_perf_print(stdout, &counts, run->ops);
+    }
+    printf("}");
+    fflush(stdout);
+    config->first_result = 0;
+    free(run->samples);
+    run->samples = NULL;
+}
+
+
+
+/// Time [body] for every i in [0, count) in batches of BENCH_BATCH
+#define BENCH_LOOP(run, count, ...) \
+    do { \
+        const size_t bench_count = (count); \
+        for (size_t bench_start = 0; bench_start < bench_count; bench_start += BENCH_BATCH) { \
+            const size_t bench_end = bench_count - bench_start < BENCH_BATCH ? bench_count : \
+                    bench_start + BENCH_BATCH; \
+            const uint64_t bench_t0 = bench_now_ns(); \
+            for (size_t i = bench_start; i < bench_end; ++i) { \
+                __VA_ARGS__ \
+            } \
+            bench_sample((run), bench_now_ns() - bench_t0, bench_end - bench_start); \
+        } \
+    } while (0)
@@ -0,0 +1,40 @@
+// Header file
+#include "../include/vector.h"
+
+
+
+void bench_vector(BenchConfig *config) {
+    size_t sets[4];
+    const size_t set_count = bench_working_sets(config, sets);
+    for (size_t s = 0; s < set_count; ++s) {
+        const size_t n = sets[s] / sizeof(uint64_t);
+        Vector *vec = vector_init(malloc, free, sizeof(uint64_t));
+        uint64_t *keys = malloc(BENCH_QUERIES * sizeof(uint64_t));
+        if (vec == NULL || keys == NULL) {
+            fprintf(stderr, "bench_vector: out of memory\n");
+            exit(1);
+        }
+
+        // Appends do not depend on a key distribution
+        BenchRun run;
+        if (!bench_run_begin(config, &run, "vector", "insert", BENCH_SEQ, n, sets[s], n)) {
+            exit(1);
+        }
+        BENCH_LOOP(&run, n, uint64_t value = i; vector_insert(vec, &value, sizeof(value)););
+        bench_run_end(config, &run);
+
+        for (int dist = 0; dist < BENCH_DISTS; ++dist) {
+            if (!bench_keys(keys, BENCH_QUERIES, n, (BenchDist)dist, 1) ||
+                    !bench_run_begin(config, &run, "vector", "at", (BenchDist)dist, n, sets[s], BENCH_QUERIES)) {
+                exit(1);
+            }
+            uint64_t sum = 0;
+            BENCH_LOOP(&run, BENCH_QUERIES, sum += *(const uint64_t *)vector_at(vec, keys[i]););
+            bench_sink = sum;
+            bench_run_end(config, &run);
+        }
+
+        free(keys);
+        vector_free(vec);
+    }
+}
@@ -0,0 +1,304 @@
+// Needed for clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+// Libraries
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/map.h"
+#include "../include/trace.h"
+#include "../include/tree.h"
+#include "../include/vector.h"
+
+
+/// Replays a trace that was recorded with DS_TRACE against a container as
+/// fast as it can and prints the latency of every operation type as JSON.
+///
+/// Keys are replayed as uint64_t, values are as large as the largest insert
+/// of the trace. Any trace can be replayed against any backend: a Vector
+/// appends on inserts, looks up key modulo its length and can not remove,
+/// removes are counted as skipped. Every operation is timed on its own, the
+/// cost of a pair of clock reads is reported as timer_ns.
+
+
+/// Values are capped at this size
+#define REPLAY_MAX_VALUE 4096
+
+/// Latencies are bucketed by powers of two
+#define REPLAY_BUCKETS 64
+
+
+typedef enum {
+    REPLAY_VECTOR,
+    REPLAY_TREE,
+    REPLAY_MAP,
+    REPLAY_BACKENDS,
+} ReplayBackend;
+
+static const char *const replay_backend_names[REPLAY_BACKENDS] = {"vector", "tree", "map"};
+
+static const char *const replay_op_names[DS_TRACE_OPS] = {"insert", "find", "remove"};
+
+
+/// Latencies of one operation type
+typedef struct {
+    uint64_t *ns;
+    size_t count;
+    uint64_t buckets[REPLAY_BUCKETS]; /* Bucket b holds latencies below 2^b ns */
+} ReplayOp;
+
+
+/// Container under test
+typedef struct {
+    ReplayBackend backend;
+    Vector *vec;
+    Tree *tree;
+    Map *map;
+    unsigned char value[REPLAY_MAX_VALUE];
+    size_t value_bytes;
+} Replay;
+
+
+/// Keeps the compiler from dropping lookups
+static volatile uint64_t replay_sink;
+
+
+
+static uint64_t replay_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+
+static int replay_compare_u64(const void *a, const void *b, size_t size) {
+    (void)size;
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int replay_sort_u64(const void *a, const void *b) {
+    return replay_compare_u64(a, b, sizeof(uint64_t));
+}
+
+
+
+static int replay_init(Replay *replay, const ReplayBackend backend, const size_t value_bytes) {
+    memset(replay, 0, sizeof(*replay));
+    replay->backend = backend;
+    replay->value_bytes = value_bytes;
+    switch (backend) {
+    case REPLAY_VECTOR:
+        replay->vec = vector_init(malloc, free, value_bytes);
+        return replay->vec != NULL;
+    case REPLAY_TREE:
+        replay->tree = tree_init_map(sizeof(uint64_t), value_bytes, malloc, free, replay_compare_u64);
+        return replay->tree != NULL;
+    case REPLAY_MAP:
+    default:
+        replay->map = map_init(malloc, free, NULL, sizeof(uint64_t), value_bytes);
+        return replay->map != NULL;
+    }
+}
+
+static void replay_free(Replay *replay) {
+    vector_free(replay->vec);
+    tree_free(replay->tree);
+    map_free(replay->map);
+}
+
+
+
+/// Returns:
+///   1 if the operation was run, 0 if the backend does not support it
+static int replay_op(Replay *replay, const DsTraceRecord *record) {
+    const uint64_t key = record->key;
+    switch (replay->backend) {
+    case REPLAY_VECTOR: {
+        const size_t len = vector_size(replay->vec);
+        if (record->op == DS_TRACE_INSERT) {
+            vector_insert(replay->vec, replay->value, replay->value_bytes);
+        } else if (record->op == DS_TRACE_FIND) {
+            replay_sink += len == 0 ? 0 : vector_at(replay->vec, key % len) != NULL;
+        } else {
+            return 0;
+        }
+        return 1;
+    }
+    case REPLAY_TREE:
+        if (record->op == DS_TRACE_INSERT) {
+            tree_upsert(replay->tree, &key, replay->value);
+        } else if (record->op == DS_TRACE_FIND) {
+            replay_sink += tree_get_value(replay->tree, &key) != NULL;
+        } else {
+            tree_delete(replay->tree, &key);
+        }
+        return 1;
+    case REPLAY_MAP:
+    default:
+        if (record->op == DS_TRACE_INSERT) {
+            map_put(replay->map, &key, replay->value);
+        } else if (record->op == DS_TRACE_FIND) {
+            replay_sink += map_get(replay->map, &key) != NULL;
+        } else {
+            replay_sink += map_remove(replay->map, &key);
+        }
+        return 1;
+    }
+}
+
+
+
+static void replay_add_sample(ReplayOp *op, const uint64_t ns) {
+    op->ns[op->count++] = ns;
+    unsigned bucket = 0;
+    while (bucket < REPLAY_BUCKETS - 1 && ns >> bucket != 0) {
+        bucket++;
+    }
+    op->buckets[bucket]++;
+}
+
+static uint64_t replay_percentile(const uint64_t *sorted, const size_t count, const double p) {
+    if (count == 0) {
+        return 0;
+    }
+    return sorted[(size_t)(p * (double)(count - 1) + 0.5)];
+}
+
+/// Print [op] as one JSON object of the results array
+static void replay_print_op(const char *name, ReplayOp *op, const int first) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < op->count; ++i) {
+        total += op->ns[i];
+    }
+    qsort(op->ns, op->count, sizeof(uint64_t), replay_sort_u64);
+
+    printf("%s\n    {\"op\": \"%s\", \"count\": %zu, \"ns_per_op\": %.2f, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+            "\"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu, \"histogram\": [",
+            first ? "" : ",", name, op->count, op->count == 0 ? 0 : (double)total / (double)op->count,
+            (unsigned long long)replay_percentile(op->ns, op->count, 0.5),
+            (unsigned long long)replay_percentile(op->ns, op->count, 0.9),
+            (unsigned long long)replay_percentile(op->ns, op->count, 0.99),
+            (unsigned long long)replay_percentile(op->ns, op->count, 0.999),
+            (unsigned long long)(op->count == 0 ? 0 : op->ns[op->count - 1]));
+    int first_bucket = 1;
+    for (unsigned bucket = 0; bucket < REPLAY_BUCKETS; ++bucket) {
+        if (op->buckets[bucket] != 0) {
+            printf("%s{\"lt_ns\": %llu, \"count\": %llu}", first_bucket ? "" : ", ",
+                    (unsigned long long)1 << bucket, (unsigned long long)op->buckets[bucket]);
+            first_bucket = 0;
+        }
+    }
+    printf("]}");
+}
+
+
+
+/// Cheapest pair of clock reads, the floor of every measured latency
+static uint64_t replay_timer_ns(void) {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 1000; ++i) {
+        const uint64_t t0 = replay_now_ns();
+        const uint64_t ns = replay_now_ns() - t0;
+        best = ns < best ? ns : best;
+    }
+    return best;
+}
+
+
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    int backend = -1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            ++i;
+            for (backend = 0; backend < REPLAY_BACKENDS; ++backend) {
+                if (strcmp(argv[i], replay_backend_names[backend]) == 0) {
+                    break;
+                }
+            }
+            if (backend == REPLAY_BACKENDS) {
+                path = NULL;
+                break;
+            }
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s TRACE [--backend vector|tree|map]\n", argv[0]);
+        return 1;
+    }
+
+    size_t count;
+    DsTraceRecord *records = ds_trace_load(path, &count);
+    if (records == NULL) {
+        fprintf(stderr, "ds_replay: can not read trace %s\n", path);
+        return 1;
+    }
+
+    // Default to the container the trace was recorded on
+    if (backend < 0) {
+        backend = count == 0 ? REPLAY_MAP : records[0].source == DS_TRACE_VECTOR ? REPLAY_VECTOR :
+                records[0].source == DS_TRACE_TREE ? REPLAY_TREE : REPLAY_MAP;
+    }
+
+    size_t value_bytes = 1, counts[DS_TRACE_OPS] = {0};
+    for (size_t i = 0; i < count; ++i) {
+        counts[records[i].op]++;
+        if (records[i].op == DS_TRACE_INSERT && records[i].size > value_bytes) {
+            value_bytes = records[i].size < REPLAY_MAX_VALUE ? records[i].size : REPLAY_MAX_VALUE;
+        }
+    }
+
+    ReplayOp ops[DS_TRACE_OPS];
+    memset(ops, 0, sizeof(ops));
+    for (int op = 0; op < DS_TRACE_OPS; ++op) {
+        ops[op].ns = malloc((counts[op] == 0 ? 1 : counts[op]) * sizeof(uint64_t));
+        if (ops[op].ns == NULL) {
+            fprintf(stderr, "ds_replay: out of memory\n");
+            return 1;
+        }
+    }
+    Replay replay;
+    if (!replay_init(&replay, (ReplayBackend)backend, value_bytes)) {
+        fprintf(stderr, "ds_replay: out of memory\n");
+        return 1;
+    }
+
+    size_t skipped = 0;
+    const uint64_t start = replay_now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t t0 = replay_now_ns();
+        const int done = replay_op(&replay, records + i);
+        const uint64_t ns = replay_now_ns() - t0;
+        if (done) {
+            replay_add_sample(ops + records[i].op, ns);
+        } else {
+            skipped++;
+        }
+    }
+    const uint64_t wall_ns = replay_now_ns() - start;
+
+    printf("{\n  \"meta\": {\"trace\": \"%s\", \"records\": %zu, \"backend\": \"%s\", \"value_bytes\": %zu, "
+            "\"skipped\": %zu, \"wall_ns\": %llu, \"recorded_ns\": %llu, \"timer_ns\": %llu},\n  \"results\": [",
+            path, count, replay_backend_names[backend], value_bytes, skipped, (unsigned long long)wall_ns,
+            (unsigned long long)(count == 0 ? 0 : records[count - 1].ns), (unsigned long long)replay_timer_ns());
+    for (int op = 0; op < DS_TRACE_OPS; ++op) {
+        replay_print_op(replay_op_names[op], ops + op, op == 0);
+        free(ops[op].ns);
+    }
+    printf("\n  ]\n}\n");
+
+    replay_free(&replay);
+    free(records);
+    return 0;
+}
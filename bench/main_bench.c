@@ -0,0 +1,80 @@
+// Needed for clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+// Libraries
+#include <stdio.h>
+
+#include "bench_util.c"
+#include "bench_vec.c"
+#include "bench_tree.c"
+#include "bench_map.c"
+
+
+/// Parse a byte count with an optional K, M or G suffix
+static size_t bench_parse_bytes(const char *text) {
+    char *end;
+    size_t bytes = (size_t)strtoull(text, &end, 10);
+    if (*end == 'K' || *end == 'k') {
+        bytes <<= 10;
+    } else if (*end == 'M' || *end == 'm') {
+        bytes <<= 20;
+    } else if (*end == 'G' || *end == 'g') {
+        bytes <<= 30;
+    }
+    return bytes;
+}
+
+
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    config.l1_bytes = bench_cache_bytes(1, (size_t)32 << 10);
+    config.l2_bytes = bench_cache_bytes(2, (size_t)1 << 20);
+    config.llc_bytes = bench_cache_bytes(3, config.l2_bytes * 8);
+    config.max_bytes = config.llc_bytes * 10;
+    config.only = NULL;
+    config.first_result = 1;
+    config.perf = NULL;
+
+    // Leave room for the key arrays next to the largest container
+#if defined(_SC_PHYS_PAGES)
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0 && config.max_bytes > (size_t)pages * (size_t)page_size / 8) {
+        config.max_bytes = (size_t)pages * (size_t)page_size / 8;
+    }
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--max-bytes") == 0 && i + 1 < argc) {
+            config.max_bytes = bench_parse_bytes(argv[++i]);
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            config.only = argv[++i];
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            if (config.perf == NULL && (config.perf = ds_perf_init()) == NULL) {
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--max-bytes N[K|M|G]] [--only vector|tree|map] [--perf]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("{\n  \"meta\": {\"l1_bytes\": %zu, \"l2_bytes\": %zu, \"llc_bytes\": %zu, \"max_bytes\": %zu, "
+            "\"batch\": %d, \"zipf_theta\": %.2f},\n  \"results\": [",
+            config.l1_bytes, config.l2_bytes, config.llc_bytes, config.max_bytes, BENCH_BATCH, BENCH_ZIPF_THETA);
+
+    if (config.only == NULL || strcmp(config.only, "vector") == 0) {
+        bench_vector(&config);
+    }
+    if (config.only == NULL || strcmp(config.only, "tree") == 0) {
+        bench_tree(&config);
+    }
+    if (config.only == NULL || strcmp(config.only, "map") == 0) {
+        bench_map(&config);
+    }
+
+    printf("\n  ]\n}\n");
+    ds_perf_free(config.perf);
+    return 0;
+}
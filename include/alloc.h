@@ -0,0 +1,208 @@
+#ifndef JAZZY_ALLOC_H
+#define JAZZY_ALLOC_H
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// Alignment every allocation of a DsAllocator has at least
+#define DS_ALLOC_MIN_ALIGN (2 * sizeof(void *))
+
+
+/// Allocator with a context
+///
+/// Containers that were initialized with a DsAllocator call its hooks with
+/// [ctx] and pass the size of every block they free, so the allocator does
+/// not have to keep a header per block. Allocations have to be aligned to
+/// at least DS_ALLOC_MIN_ALIGN. Containers copy the struct, but not what
+/// [ctx] points to, which has to outlive them.
+///
+/// Fields:
+///   - ctx: passed to every hook
+///   - alloc: returns [size] bytes or NULL
+///   - realloc: resizes a block of [old_size] bytes to [new_size] bytes.
+///     May be NULL, then `alloc`, memcpy and `free_sized` are used
+///   - free_sized: releases a block of [size] bytes, [ptr] is never NULL
+///   - aligned_alloc: returns [size] bytes aligned to [alignment], a power
+///     of 2. The block is released with `free_sized`. May be NULL if no
+///     more than DS_ALLOC_MIN_ALIGN is ever needed
+typedef struct {
+    void *ctx;
+    void *(*alloc)(void *ctx, size_t size);
+    void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void (*free_sized)(void *ctx, void *ptr, size_t size);
+    void *(*aligned_alloc)(void *ctx, size_t alignment, size_t size);
+} DsAllocator;
+
+
+
+/// Allocation counters of a container
+///
+/// They are only counted if the library was built with DS_STATS, all fields
+/// are 0 otherwise.
+///
+/// Fields:
+///   - allocs: blocks allocated, a resize counts as one
+///   - alloc_bytes: bytes of all blocks allocated
+///   - frees: blocks released, a resize counts as one
+///   - live_bytes: bytes of the blocks that are still allocated
+typedef struct {
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    uint64_t frees;
+    uint64_t live_bytes;
+} DsAllocStats;
+
+
+
+/// Get the allocator that uses malloc and free
+///
+/// Returns:
+///   the allocator, its ctx is NULL
+DsAllocator ds_allocator_default(void);
+
+
+
+/// Allocate memory with an allocator
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for `ds_allocator_default`
+///   - size: amount of bytes needed
+///
+/// Returns:
+///   pointer to [size] bytes or NULL if the allocation fails
+void *ds_alloc(const DsAllocator *allocator, size_t size);
+
+
+
+/// Resize memory of an allocator
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for `ds_allocator_default`
+///   - ptr: block that was returned by [allocator], may be NULL
+///   - old_size: size [ptr] was allocated with, 0 if [ptr] is NULL
+///   - new_size: amount of bytes needed
+///
+/// Returns:
+///   pointer to the resized block or NULL if the allocation fails. [ptr] is
+///   still valid then
+void *ds_realloc(const DsAllocator *allocator, void *ptr, size_t old_size, size_t new_size);
+
+
+
+/// Allocate aligned memory with an allocator
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for `ds_allocator_default`
+///   - alignment: a power of 2
+///   - size: amount of bytes needed
+///
+/// Returns:
+///   pointer to [size] bytes aligned to [alignment] or NULL if the allocation
+///   fails or the allocator can not align that much
+void *ds_aligned_alloc(const DsAllocator *allocator, size_t alignment, size_t size);
+
+
+
+/// Release memory of an allocator
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for `ds_allocator_default`
+///   - ptr: block that was returned by [allocator], may be NULL
+///   - size: size [ptr] was allocated with
+void ds_free(const DsAllocator *allocator, void *ptr, size_t size);
+
+
+
+/********************************* Bump arena *********************************/
+
+/// Handle to a bump arena
+///
+/// An arena hands out memory from large blocks by bumping a pointer. Freeing
+/// only gives memory back if it was the latest allocation, everything else
+/// is released at once by `ds_arena_reset` or `ds_arena_free`. Containers
+/// that live in an arena do not have to be freed one by one. An arena must
+/// not be used by two threads at the same time.
+typedef struct ds_arena DsArena;
+
+
+
+/// Initialize a bump arena
+///
+/// Parameters:
+///   - parent: allocator of the blocks, NULL for `ds_allocator_default`
+///   - block_size: bytes of a block, 0 for 64 KiB. Larger allocations get a
+///     block of their own
+///
+/// Returns:
+///   A pointer to an arena or NULL if the memory allocation fails
+DsArena *ds_arena_init(const DsAllocator *parent, size_t block_size);
+
+
+
+/// Get an allocator that allocates from an arena
+///
+/// Parameters:
+///   - arena: handle to an arena that was returned by `ds_arena_init`
+///
+/// Returns:
+///   the allocator, it is valid until [arena] is freed
+DsAllocator ds_arena_allocator(DsArena *arena);
+
+
+
+/// Release every allocation of an arena
+///
+/// The block that is in use is kept for the next allocations, all others
+/// are given back to the parent allocator.
+///
+/// Parameters:
+///   - arena: handle to an arena that was returned by `ds_arena_init`
+void ds_arena_reset(DsArena *arena);
+
+
+
+/// Get the number of bytes an arena has handed out
+///
+/// Parameters:
+///   - arena: handle to an arena that was returned by `ds_arena_init`
+///
+/// Returns:
+///   bytes handed out since the last reset including alignment padding
+size_t ds_arena_used(const DsArena *arena);
+
+
+
+/// Free an arena and every allocation of it
+///
+/// Parameters:
+///   - arena: handle to an arena that was returned by `ds_arena_init`
+void ds_arena_free(DsArena *arena);
+
+
+
+/****************************** Thread local pool *****************************/
+
+/// Largest block the pool caches
+#define DS_POOL_MAX_SIZE 2048
+
+
+/// Get the thread local pool allocator
+///
+/// Blocks of up to DS_POOL_MAX_SIZE bytes are rounded up to a power of 2 and
+/// cached in a free list of the freeing thread instead of being returned to
+/// malloc. Larger blocks go straight to malloc. No locks are taken, and a
+/// block may be freed by another thread than the one that allocated it. The
+/// cache of a thread is released when the thread exits.
+///
+/// Returns:
+///   the allocator, its ctx is NULL
+DsAllocator ds_pool_allocator(void);
+
+
+
+/// Release the blocks the pool cached for the calling thread
+void ds_pool_trim(void);
+
+#endif // JAZZY_ALLOC_H
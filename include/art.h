@@ -0,0 +1,185 @@
+#ifndef JAZZY_ART_H
+#define JAZZY_ART_H
+
+// Header file
+#include "alloc.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/// This type represents functions that are used to allocate memory
+/// the function 'malloc' is of this type
+///
+/// Parameters:
+/// - size_t: amount of bytes needed
+typedef void *(*ArtAllocFn)(size_t);
+
+/// This type represents functions that are used to free memory
+/// the function 'free' is of this type
+///
+/// Parameters:
+/// - void *: pointer to memory  to free
+typedef void (*ArtFreeFn)(void *);
+
+/// This type represents functions that are called for the keys of a scan
+///
+/// Parameters:
+///   - const void *: the key
+///   - size_t: length of the key
+///   - void *: the value, which may be changed
+///   - void *: context pointer that was passed along
+///
+/// Returns:
+///   non zero to stop, 0 to continue
+typedef int (*ArtVisitFn)(const void *, size_t, void *, void *);
+
+
+/// A handle to an adaptive radix tree
+///
+/// An ArtTree maps byte strings of any length to values of a fixed size. It
+/// is a radix tree that branches on one key byte per level, so a lookup
+/// takes O(key length) no matter how many keys are stored, and keys are
+/// ordered like memcmp with a shorter key before the keys it is a prefix of.
+///
+/// Inner nodes grow and shrink between 4, 16, 48 and 256 children, so sparse
+/// levels stay small. Runs of bytes without a branch are compressed into the
+/// node below them. This makes it a good fit for URLs, paths and other keys
+/// with long shared prefixes, see `art_prefix_scan`.
+typedef struct art_tree ArtTree;
+
+
+
+/// Initialize an adaptive radix tree
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - val_size: size of the values, may be 0 to use the tree as a set
+///
+/// Returns:
+///   A pointer to a tree or NULL if the memory allocation fails
+ArtTree *art_init(const ArtAllocFn alloc, const ArtFreeFn dealloc, const size_t val_size);
+
+
+
+/// Initialize an adaptive radix tree with a DsAllocator
+///
+/// This function works like `art_init`, but all memory comes from
+/// [allocator]. Nodes and leaves are freed with their size, so an arena or
+/// the pool allocator fits well.
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for malloc and free
+///   - val_size: size of the values, may be 0
+ArtTree *art_init_alloc(const DsAllocator *allocator, const size_t val_size);
+
+
+
+/// Insert or overwrite the value for a key
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `art_init`
+///   - key: the key, it is copied
+///   - key_len: length of the key, may be 0 and must be below 4 GiB
+///   - value: val_size bytes that are copied, NULL to zero a new value and
+///     keep an existing one
+///
+/// Returns:
+///   a pointer to the value slot or NULL if the allocation failed. The slot
+///   stays valid until the key is deleted.
+void *art_insert(ArtTree *tree, const void *key, const size_t key_len, const void *value);
+
+
+
+/// Get the value for a key
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `art_init`
+///   - key: the key
+///   - key_len: length of the key
+///
+/// Returns:
+///   a writable pointer to the value slot or NULL if [key] is not present
+void *art_lookup(const ArtTree *tree, const void *key, const size_t key_len);
+
+
+
+/// Delete a key and its value
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `art_init`
+///   - key: the key
+///   - key_len: length of the key
+///
+/// Returns:
+///   1 if the key was deleted, 0 if it was not present
+int art_delete(ArtTree *tree, const void *key, const size_t key_len);
+
+
+
+/// Visit all keys that start with a prefix
+///
+/// The keys are visited in order. Finding the first one takes O(prefix
+/// length), every key after that is found in O(1) amortized.
+///
+/// Example:
+///   size_t n = art_prefix_scan(routes, "/api/", 5, print_route, NULL);
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `art_init`
+///   - prefix: the prefix, an empty prefix visits every key
+///   - prefix_len: length of the prefix
+///   - visit: called with each key, its value and [ctx], may be NULL to
+///     only count
+///   - ctx: passed to [visit]
+///
+/// Returns:
+///   the number of keys that were visited
+size_t art_prefix_scan(const ArtTree *tree, const void *prefix, const size_t prefix_len, const ArtVisitFn visit,
+        void *ctx);
+
+
+
+/// Visit all keys in a range
+///
+/// The keys from [lo] up to but excluding [hi] are visited in order.
+/// Subtrees that lie outside of the range are skipped.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `art_init`
+///   - lo: first key of the range, NULL to start at the smallest key
+///   - lo_len: length of [lo]
+///   - hi: end of the range, NULL to end after the largest key
+///   - hi_len: length of [hi]
+///   - visit: called with each key, its value and [ctx], may be NULL to
+///     only count
+///   - ctx: passed to [visit]
+///
+/// Returns:
+///   the number of keys that were visited
+size_t art_range_scan(const ArtTree *tree, const void *lo, const size_t lo_len, const void *hi, const size_t hi_len,
+        const ArtVisitFn visit, void *ctx);
+
+
+
+/// Get the amount of keys
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `art_init`
+///
+/// Returns:
+///   the amount of keys, 0 if [tree] is NULL
+size_t art_size(const ArtTree *tree);
+
+
+
+/// Free the tree with all keys and values
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `art_init`
+void art_free(ArtTree *tree);
+
+#endif // JAZZY_ART_H
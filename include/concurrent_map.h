@@ -0,0 +1,101 @@
+#ifndef JAZZY_CONCURRENT_MAP_H
+#define JAZZY_CONCURRENT_MAP_H
+
+// Header file
+#include "map.h"
+
+// Libraries
+#include <stddef.h>
+
+
+/// Handle to a concurrent map
+///
+/// A concurrent map is split into a power of two amount of shards. Every
+/// shard is a map of its own with a reader-writer lock, so threads working
+/// on different shards do not contend and readers of the same shard run in
+/// parallel. Shards grow independently of each other.
+///
+/// Values are copied in and out, pointers into a shard would not outlive
+/// the lock.
+typedef struct concurrent_map ConcurrentMap;
+
+
+
+/// Initialize a concurrent map
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - hash: function used to hash keys, NULL for a built-in hash
+///   - key_len: size of the keys
+///   - val_len: size of the values, may be 0 for a set
+///   - shards: amount of shards, rounded up to a power of two. 0 picks a default
+///
+/// Returns:
+///   A pointer to a concurrent map or NULL if the initialization fails
+ConcurrentMap *concurrent_map_init(const MapAllocFn alloc, const MapFreeFn dealloc, const MapHashFn hash,
+        const size_t key_len, const size_t val_len, size_t shards);
+
+
+
+/// Insert or overwrite a value
+///
+/// Parameters:
+///   - map: handle to a concurrent map that was returned by `concurrent_map_init`
+///   - key: pointer to the key
+///   - value: pointer to the value, may be NULL to zero a new value
+///
+/// Returns:
+///   1 on success, 0 if memory allocation fails
+int concurrent_map_put(ConcurrentMap *map, const void *key, const void *value);
+
+
+
+/// Get a value
+///
+/// Parameters:
+///   - map: handle to a concurrent map that was returned by `concurrent_map_init`
+///   - key: pointer to the key
+///   - out: buffer of val_len bytes the value is copied to, may be NULL
+///
+/// Returns:
+///   1 if [key] is present, 0 otherwise
+int concurrent_map_get(ConcurrentMap *map, const void *key, void *out);
+
+
+
+/// Remove a key
+///
+/// Parameters:
+///   - map: handle to a concurrent map that was returned by `concurrent_map_init`
+///   - key: pointer to the key
+///
+/// Returns:
+///   1 if [key] was removed, 0 if it was not present
+int concurrent_map_remove(ConcurrentMap *map, const void *key);
+
+
+
+/// Get the number of entries
+///
+/// The shards are counted one after another, so with concurrent writers the
+/// result is only a snapshot of each shard.
+///
+/// Parameters:
+///   - map: handle to a concurrent map that was returned by `concurrent_map_init`
+///
+/// Returns:
+///   amount of entries in the map. Size of NULL is 0
+size_t concurrent_map_size(ConcurrentMap *map);
+
+
+
+/// Free the concurrent map
+///
+/// No other thread may use the map while or after it is freed.
+///
+/// Parameters:
+///   - map: handle to a concurrent map that was returned by `concurrent_map_init`
+void concurrent_map_free(ConcurrentMap *map);
+
+#endif // JAZZY_CONCURRENT_MAP_H
@@ -0,0 +1,209 @@
+#ifndef JAZZY_FILTER_H
+#define JAZZY_FILTER_H
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/// This type represents functions that are used to allocate memory
+/// the function 'malloc' is of this type
+///
+/// Parameters:
+/// - size_t: amount of bytes needed
+typedef void *(*FilterAllocFn)(size_t);
+
+/// This type represents functions that are used to free memory
+/// the function 'free' is of this type
+///
+/// Parameters:
+/// - void *: pointer to memory  to free
+typedef void (*FilterFreeFn)(void *);
+
+
+
+/******************************** Bloom filter ********************************/
+
+/// Handle to a blocked Bloom filter
+///
+/// A Bloom filter answers whether a key may have been added. It never misses
+/// a key that was added, but it may claim a key that was not. All bits of a
+/// key are in one block of 64 bytes, so a query touches one cache line.
+/// Keys cannot be removed.
+typedef struct bloom_filter BloomFilter;
+
+
+
+/// Initialize a Bloom filter
+///
+/// With 10 bits per key about 1% of the queries for absent keys answer
+/// yes, with 16 bits per key about 0.1%.
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - capacity: expected amount of keys
+///   - bits_per_key: bits of the filter per expected key
+///
+/// Returns:
+///   A pointer to a Bloom filter or NULL if the memory allocation fails
+BloomFilter *bloom_init(const FilterAllocFn alloc, const FilterFreeFn dealloc, const size_t capacity,
+        const size_t bits_per_key);
+
+
+
+/// Add a key to a Bloom filter
+///
+/// Parameters:
+///   - filter: handle to a Bloom filter that was returned by `bloom_init`
+///   - key: pointer to the key
+///   - len: length of the key
+void bloom_add(BloomFilter *filter, const void *key, size_t len);
+
+
+
+/// Check whether a key may be in a Bloom filter
+///
+/// Parameters:
+///   - filter: handle to a Bloom filter that was returned by `bloom_init`
+///   - key: pointer to the key
+///   - len: length of the key
+///
+/// Returns:
+///   0 if [key] was never added, 1 if it may have been
+int bloom_contains(const BloomFilter *filter, const void *key, size_t len);
+
+
+
+/// Check many keys of the same length
+///
+/// The blocks of a batch of keys are prefetched before they are tested, so
+/// their cache misses overlap.
+///
+/// Parameters:
+///   - filter: handle to a Bloom filter that was returned by `bloom_init`
+///   - keys: [n] keys of [len] bytes one after another
+///   - len: length of every key
+///   - n: amount of keys
+///   - out: receives the result of `bloom_contains` for every key
+///
+/// Returns:
+///   amount of keys that may be in the filter
+size_t bloom_contains_batch(const BloomFilter *filter, const void *keys, size_t len, size_t n, unsigned char *out);
+
+
+
+/// Free a Bloom filter
+///
+/// Parameters:
+///   - filter: handle to a Bloom filter that was returned by `bloom_init`
+void bloom_free(BloomFilter *filter);
+
+
+
+/******************************** Cuckoo filter *******************************/
+
+/// Handle to a cuckoo filter
+///
+/// A cuckoo filter answers the same question as a Bloom filter, but keys can
+/// be removed again. It stores a 16 bit fingerprint of every key in one of
+/// two buckets of four, so about 0.01% of the queries for absent keys
+/// answer yes. A query touches at most two cache lines.
+typedef struct cuckoo_filter CuckooFilter;
+
+
+
+/// Initialize a cuckoo filter
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - capacity: maximum amount of keys
+///
+/// Returns:
+///   A pointer to a cuckoo filter or NULL if the memory allocation fails
+CuckooFilter *cuckoo_init(const FilterAllocFn alloc, const FilterFreeFn dealloc, const size_t capacity);
+
+
+
+/// Add a key to a cuckoo filter
+///
+/// Adding the same key twice stores it twice, it then has to be removed
+/// twice as well.
+///
+/// Parameters:
+///   - filter: handle to a cuckoo filter that was returned by `cuckoo_init`
+///   - key: pointer to the key
+///   - len: length of the key
+///
+/// Returns:
+///   1 if [key] was added, 0 if the filter is full
+int cuckoo_add(CuckooFilter *filter, const void *key, size_t len);
+
+
+
+/// Check whether a key may be in a cuckoo filter
+///
+/// Parameters:
+///   - filter: handle to a cuckoo filter that was returned by `cuckoo_init`
+///   - key: pointer to the key
+///   - len: length of the key
+///
+/// Returns:
+///   0 if [key] is not in the filter, 1 if it may be
+int cuckoo_contains(const CuckooFilter *filter, const void *key, size_t len);
+
+
+
+/// Check many keys of the same length
+///
+/// Works like `bloom_contains_batch`.
+///
+/// Parameters:
+///   - filter: handle to a cuckoo filter that was returned by `cuckoo_init`
+///   - keys: [n] keys of [len] bytes one after another
+///   - len: length of every key
+///   - n: amount of keys
+///   - out: receives the result of `cuckoo_contains` for every key
+///
+/// Returns:
+///   amount of keys that may be in the filter
+size_t cuckoo_contains_batch(const CuckooFilter *filter, const void *keys, size_t len, size_t n, unsigned char *out);
+
+
+
+/// Remove a key from a cuckoo filter
+///
+/// Only keys that were added may be removed, removing any other key may
+/// remove a different key with the same fingerprint.
+///
+/// Parameters:
+///   - filter: handle to a cuckoo filter that was returned by `cuckoo_init`
+///   - key: pointer to the key
+///   - len: length of the key
+///
+/// Returns:
+///   1 if a fingerprint of [key] was removed, 0 otherwise
+int cuckoo_remove(CuckooFilter *filter, const void *key, size_t len);
+
+
+
+/// Get the number of keys in a cuckoo filter
+///
+/// Parameters:
+///   - filter: handle to a cuckoo filter that was returned by `cuckoo_init`
+///
+/// Returns:
+///   amount of keys in the filter. Size of NULL is 0
+size_t cuckoo_size(const CuckooFilter *filter);
+
+
+
+/// Free a cuckoo filter
+///
+/// Parameters:
+///   - filter: handle to a cuckoo filter that was returned by `cuckoo_init`
+void cuckoo_free(CuckooFilter *filter);
+
+#endif // JAZZY_FILTER_H
@@ -0,0 +1,72 @@
+#ifndef JAZZY_HASH_H
+#define JAZZY_HASH_H
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// This type represents functions that are used for hashing
+///
+/// `hash_bytes` is of this type.
+///
+/// Parameters:
+///   - const void *: pointer to the beginning of the key
+///   - size_t: length of the key in bytes
+///   - uint64_t: seed, different seeds give unrelated hashes
+typedef uint64_t (*HashFn)(const void *, size_t, uint64_t);
+
+
+
+/// Hash a byte string
+///
+/// This is a wyhash style hash, it reads the key in 8 byte words and mixes
+/// them with 64x64 -> 128 bit multiplications. Hashes depend on the byte
+/// order of the machine, they should not be stored for use elsewhere.
+///
+/// Parameters:
+///   - key: pointer to the key, may be NULL if [len] is 0
+///   - len: length of the key in bytes
+///   - seed: seed of the hash
+///
+/// Returns:
+///   the 64 bit hash of [key]
+uint64_t hash_bytes(const void *key, size_t len, uint64_t seed);
+
+
+
+/// Hash a 4 byte key
+///
+/// Parameters:
+///   - key: the key
+///   - seed: seed of the hash
+///
+/// Returns:
+///   the same as `hash_bytes(&key, 4, seed)` without the length dispatch
+uint64_t hash_u32(uint32_t key, uint64_t seed);
+
+
+
+/// Hash an 8 byte key
+///
+/// Parameters:
+///   - key: the key
+///   - seed: seed of the hash
+///
+/// Returns:
+///   the same as `hash_bytes(&key, 8, seed)` without the length dispatch
+uint64_t hash_u64(uint64_t key, uint64_t seed);
+
+
+
+/// Get a random seed
+///
+/// The first call reads a secret from /dev/urandom, or derives one from the
+/// clock and the address space if that is not available. Every call returns
+/// a different seed derived from that secret.
+///
+/// Returns:
+///   a random seed
+uint64_t hash_random_seed(void);
+
+#endif // JAZZY_HASH_H
@@ -0,0 +1,250 @@
+#ifndef JAZZY_HEAP_H
+#define JAZZY_HEAP_H
+
+// Header file
+#include "alloc.h"
+#include "vector.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+/// This type represents functions that are used to allocate memory
+/// the function 'malloc' is of this type
+///
+/// Parameters:
+/// - size_t: amount of bytes needed
+typedef void *(*HeapAllocFn)(size_t);
+
+/// This type represents functions that are used to free memory
+/// the function 'free' is of this type
+///
+/// Parameters:
+/// - void *: pointer to memory  to free
+typedef void (*HeapFreeFn)(void *);
+
+/// This type represents functions that are used to compare two elements
+/// the function 'memcmp' is of this type, like a TreeComparator
+///
+/// Parameters:
+///   - void *: first element
+///   - void *: second element
+///   - size_t: size of the elements
+typedef int (*HeapComparator)(const void *, const void *, size_t);
+
+
+/// Arity that is used if 0 is passed
+#define HEAP_DEFAULT_ARITY 4
+
+/// Largest arity
+#define HEAP_MAX_ARITY 16
+
+
+/// Handle to a heap
+///
+/// A heap is a priority queue whose smallest element, according to its
+/// comparator, is on top. Elements are stored in a Vector as a d-ary heap:
+/// the children of position i are the [arity] positions from arity * i + 1.
+/// The storage starts with arity - 1 unused slots, so the children of a
+/// position start at a multiple of [arity] elements from its start. With 8
+/// byte elements and an arity of 8 the children share one cache line if the
+/// allocator returns 64 byte aligned storage. A wider heap is flatter, so a
+/// pop touches fewer lines but compares more children per level.
+///
+/// An indexed heap also gives every element a handle, which can be used to
+/// change or remove the element, like for the decrease-key of Dijkstra's
+/// algorithm.
+typedef struct heap Heap;
+
+
+
+/// Initialize a heap
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - elem_size: size of the elements
+///   - arity: children per position, 2 to HEAP_MAX_ARITY or 0 for
+///     HEAP_DEFAULT_ARITY
+///   - comp: compares two elements, NULL for memcmp
+///
+/// Returns:
+///   A pointer to a heap or NULL if the arity is invalid or the memory
+///   allocation fails
+Heap *heap_init(const HeapAllocFn alloc, const HeapFreeFn dealloc, const size_t elem_size, const size_t arity,
+        const HeapComparator comp);
+
+
+
+/// Initialize a heap with a DsAllocator
+///
+/// This function works like `heap_init`, but all memory comes from
+/// [allocator].
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for malloc and free
+///   - elem_size: size of the elements
+///   - arity: children per position, 0 for HEAP_DEFAULT_ARITY
+///   - comp: compares two elements, NULL for memcmp
+Heap *heap_init_alloc(const DsAllocator *allocator, const size_t elem_size, const size_t arity,
+        const HeapComparator comp);
+
+
+
+/// Initialize an indexed heap
+///
+/// This function works like `heap_init`, but the elements get handles, see
+/// `heap_push_handle`.
+Heap *heap_init_indexed(const HeapAllocFn alloc, const HeapFreeFn dealloc, const size_t elem_size,
+        const size_t arity, const HeapComparator comp);
+
+
+
+/// Turn a vector into a heap
+///
+/// The elements of [vec] are ordered into a heap in O(n), which is faster
+/// than pushing them one by one. The heap takes [vec] over and frees it with
+/// `heap_free`, it must not be used afterwards.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - arity: children per position, 0 for HEAP_DEFAULT_ARITY
+///   - comp: compares two elements, NULL for memcmp
+///
+/// Returns:
+///   A pointer to a heap or NULL if the arity is invalid or the memory
+///   allocation fails, [vec] is left untouched then
+Heap *heap_from_vector(Vector *vec, const size_t arity, const HeapComparator comp);
+
+
+
+/// Add an element
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init`
+///   - elem: the element, elem_size bytes are copied
+///
+/// Returns:
+///   1 on success, 0 if the memory allocation fails
+int heap_push(Heap *heap, const void *elem);
+
+
+
+/// Get the smallest element
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init`
+///
+/// Returns:
+///   a pointer to the element, which must not be changed, or NULL if
+///   [heap] is empty
+const void *heap_peek(const Heap *heap);
+
+
+
+/// Remove the smallest element
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init`
+///   - out: receives a copy of the element, may be NULL
+///
+/// Returns:
+///   1 if an element was removed, 0 if [heap] is empty
+int heap_pop(Heap *heap, void *out);
+
+
+
+/// Get the amount of elements
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init`
+///
+/// Returns:
+///   the amount of elements, 0 if [heap] is NULL
+size_t heap_size(const Heap *heap);
+
+
+
+/// Free the heap and all of its elements
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init`
+void heap_free(Heap *heap);
+
+
+
+
+/********************************** Indexed ***********************************/
+
+/// Add an element to an indexed heap and get its handle
+///
+/// Handles are small integers. A handle stays valid until its element is
+/// popped or removed and is then reused.
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init_indexed`
+///   - elem: the element, elem_size bytes are copied
+///   - handle: receives the handle of the element
+///
+/// Returns:
+///   1 on success, 0 if [heap] is not indexed or the memory allocation
+///   fails
+int heap_push_handle(Heap *heap, const void *elem, size_t *handle);
+
+
+
+/// Remove the smallest element of an indexed heap
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init_indexed`
+///   - out: receives a copy of the element, may be NULL
+///   - handle: receives the handle the element had, may be NULL
+///
+/// Returns:
+///   1 if an element was removed, 0 if [heap] is empty or not indexed
+int heap_pop_handle(Heap *heap, void *out, size_t *handle);
+
+
+
+/// Get the element of a handle
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init_indexed`
+///   - handle: handle of the element
+///
+/// Returns:
+///   a pointer to the element, which must not be changed, or NULL if
+///   [handle] is not in [heap]
+const void *heap_get(const Heap *heap, const size_t handle);
+
+
+
+/// Replace the element of a handle
+///
+/// The element moves up if it got smaller, this is decrease-key, and down if
+/// it got larger.
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init_indexed`
+///   - handle: handle of the element
+///   - elem: the new element
+///
+/// Returns:
+///   1 on success, 0 if [handle] is not in [heap]
+int heap_update(Heap *heap, const size_t handle, const void *elem);
+
+
+
+/// Remove the element of a handle
+///
+/// Parameters:
+///   - heap: handle that was returned by `heap_init_indexed`
+///   - handle: handle of the element
+///
+/// Returns:
+///   1 on success, 0 if [handle] is not in [heap]
+int heap_remove(Heap *heap, const size_t handle);
+
+#endif // JAZZY_HEAP_H
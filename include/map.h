@@ -0,0 +1,543 @@
+#ifndef JAZZY_MAP_H
+#define JAZZY_MAP_H
+
+// Header file
+#include "alloc.h"
+#include "trace.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Handle to a map
+///
+/// This struct represents a handle to a map
+/// A pointer to this is used to pass into functions and
+/// perform operations on it.
+typedef struct map Map;
+
+
+/// This type represents functions that are used to allocate memory
+/// the function 'malloc' is of this type
+///
+/// Parameters:
+/// - size_t: amount of bytes needed
+typedef void *(*MapAllocFn)(size_t);
+
+/// This type represents functions that are used to reallocate memory
+/// the function 'realloc' is of this type
+///
+/// Parameters:
+/// - void *: old pointer
+/// - size_t: amount of bytes needed
+typedef void *(*MapReAllocFn)(void *, size_t);
+
+/// This type represents functions that are used to allocate initialized memory
+/// the function 'calloc' is of this type
+///
+/// Parameters:
+/// - void *: old pointer
+/// - size_t: amount of bytes needed
+typedef void (*MapCallocFn)(size_t);
+
+/// This type represents functions that are used to free memory
+/// the function 'free' is of this type
+///
+/// Parameters:
+/// - void *: pointer to memory  to free
+typedef void (*MapFreeFn)(void *);
+
+
+
+/// This type represents functions that are used for hashing
+/// the function 'hash_bytes' is of this type
+///
+/// Parameters:
+///   - const void *: pointer to the beginning of the key
+///   - size_t: length of the key in bytes
+///   - uint64_t: seed of the map, see `map_init`
+typedef uint64_t (*MapHashFn)(const void *, size_t, uint64_t);
+
+
+
+/// This type represents functions that are called for evicted entries
+///
+/// Parameters:
+///   - const void *: pointer to the key in the map
+///   - void *: pointer to the value in the map
+///   - void *: context that was passed to `map_init_cache`
+typedef void (*MapEvictFn)(const void *, void *, void *);
+
+
+
+/// Counters of a map in cache mode
+typedef struct {
+    uint64_t hits; /* Lookups that found their key */
+    uint64_t misses; /* Lookups that did not */
+    uint64_t evictions; /* Entries evicted to make room */
+} MapCacheStats;
+
+
+
+/// Initialize a map
+///
+/// This function initializes a map from keys of [key_len] bytes to values of
+/// [val_len] bytes. Keys and values are copied into the table itself, there is
+/// no allocation per entry. Keys are compared with memcmp.
+///
+/// Every map gets its own random seed which is passed to [hash], so the
+/// layout of one map says nothing about another and colliding keys cannot
+/// be prepared in advance.
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - hash: function used to hash keys, NULL for the functions in hash.h
+///   - key_len: size of the keys
+///   - val_len: size of the values, may be 0 for a set
+///
+/// Returns:
+///   A pointer to a map or NULL if the memory allocation fails
+Map *map_init(const MapAllocFn alloc, const MapFreeFn dealloc, const MapHashFn hash,
+        const size_t key_len, const size_t val_len);
+
+
+
+/// Initialize a map with a DsAllocator
+///
+/// This function works like `map_init`, but all memory comes from
+/// [allocator].
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for malloc and free
+///   - hash: function used to hash keys, NULL for the functions in hash.h
+///   - key_len: size of the keys
+///   - val_len: size of the values, may be 0 for a set
+///
+/// Returns:
+///   A pointer to a map or NULL if the memory allocation fails
+Map *map_init_alloc(const DsAllocator *allocator, const MapHashFn hash, const size_t key_len, const size_t val_len);
+
+
+
+/// Initialize a map with string keys
+///
+/// This function initializes a map from byte strings of any length to values
+/// of [val_len] bytes. Keys of up to 15 bytes are stored inside the table,
+/// longer keys are copied into an arena owned by the map. The arena only
+/// grows, the bytes of removed long keys are released by `map_free`.
+///
+/// Such a map is used with `map_put_str`, `map_get_str` and `map_remove_str`
+/// only.
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - hash: function used to hash keys, NULL for `hash_bytes`
+///   - val_len: size of the values, may be 0 for a set
+///
+/// Returns:
+///   A pointer to a map or NULL if the memory allocation fails
+Map *map_init_str(const MapAllocFn alloc, const MapFreeFn dealloc, const MapHashFn hash, const size_t val_len);
+
+
+
+/// Initialize a map with string keys and a DsAllocator
+///
+/// This function works like `map_init_str`, but all memory, including the
+/// arena of long keys, comes from [allocator].
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for malloc and free
+///   - hash: function used to hash keys, NULL for `hash_bytes`
+///   - val_len: size of the values, may be 0 for a set
+///
+/// Returns:
+///   A pointer to a map or NULL if the memory allocation fails
+Map *map_init_str_alloc(const DsAllocator *allocator, const MapHashFn hash, const size_t val_len);
+
+
+
+/// Initialize a map in cache mode
+///
+/// A cache is a map with a fixed capacity. When it is full, inserting a new
+/// key evicts an entry that was not used recently, using the CLOCK
+/// algorithm: lookups and overwrites set a reference byte of the entry, a
+/// clock hand that sweeps the table clears it and evicts entries whose
+/// byte is already clear. That byte is the only per entry cost.
+///
+/// In cache mode `map_get` counts hits and misses and marks the entries it
+/// finds, so a cache must not be read by several threads at once.
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - hash: function used to hash keys, NULL for the functions in hash.h
+///   - key_len: size of the keys
+///   - val_len: size of the values
+///   - max_entries: maximum amount of entries, 0 for no entry limit
+///   - max_bytes: maximum size of the table in bytes, 0 for no byte limit. The
+///     table has at least 16 slots
+///   - evict: called with every evicted entry and with every entry that is
+///     left on `map_free`, may be NULL
+///   - ctx: passed to [evict]
+///
+/// Returns:
+///   A pointer to a map or NULL if both limits are 0 or the memory allocation
+///   fails
+Map *map_init_cache(const MapAllocFn alloc, const MapFreeFn dealloc, const MapHashFn hash,
+        const size_t key_len, const size_t val_len, const size_t max_entries, const size_t max_bytes,
+        const MapEvictFn evict, void *ctx);
+
+
+
+/// Insert or overwrite a value
+///
+/// This function copies [key] and [value] into the map. If [key] is already
+/// present, its value is overwritten.
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///   - key: pointer to the key
+///   - value: pointer to the value, may be NULL to zero a new value
+///
+/// Returns:
+///   a pointer to the value in the map or NULL if memory allocation fails.
+///   The pointer is valid until the next insertion or removal.
+void *map_put(Map *map, const void *key, const void *value);
+
+
+
+/// Get a value
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///   - key: pointer to the key
+///
+/// Returns:
+///   a pointer to the value in the map or NULL if [key] is not present.
+///   The pointer is valid until the next insertion or removal.
+void *map_get(const Map *map, const void *key);
+
+
+
+/// Remove a key
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///   - key: pointer to the key
+///
+/// Returns:
+///   1 if [key] was removed, 0 if it was not present
+int map_remove(Map *map, const void *key);
+
+
+
+/// Insert or overwrite a value of a map with string keys
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init_str`
+///   - key: pointer to the bytes of the key
+///   - len: length of the key, less than 4 GiB
+///   - value: pointer to the value, may be NULL to zero a new value
+///
+/// Returns:
+///   a pointer to the value in the map or NULL if memory allocation fails.
+///   The pointer is valid until the next insertion or removal.
+void *map_put_str(Map *map, const void *key, size_t len, const void *value);
+
+
+
+/// Get a value of a map with string keys
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init_str`
+///   - key: pointer to the bytes of the key
+///   - len: length of the key
+///
+/// Returns:
+///   a pointer to the value in the map or NULL if [key] is not present.
+///   The pointer is valid until the next insertion or removal.
+void *map_get_str(const Map *map, const void *key, size_t len);
+
+
+
+/// Remove a key of a map with string keys
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init_str`
+///   - key: pointer to the bytes of the key
+///   - len: length of the key
+///
+/// Returns:
+///   1 if [key] was removed, 0 if it was not present
+int map_remove_str(Map *map, const void *key, size_t len);
+
+
+
+/// Get the counters of a cache
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init_cache`
+///   - stats: filled with the counters, all 0 if [map] is not a cache
+void map_cache_stats(const Map *map, MapCacheStats *stats);
+
+
+
+/// Get the values of many keys
+///
+/// The keys are hashed and their slots are prefetched a batch at a time
+/// before they are looked up, so the cache misses of different keys
+/// overlap. This is faster than calling `map_get` in a loop when the map
+/// does not fit into the cache.
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///   - keys: [n] keys one after another
+///   - n: amount of keys
+///   - out: receives a pointer to the value of every key or NULL, like `map_get`
+///
+/// Returns:
+///   amount of keys that were found
+size_t map_get_batch(const Map *map, const void *keys, size_t n, void **out);
+
+
+
+/// Insert or overwrite many values
+///
+/// The keys are hashed and their slots are prefetched a batch at a time like
+/// in `map_get_batch`. Keys are inserted in order, so for a key that occurs
+/// twice the later value wins.
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///   - keys: [n] keys one after another
+///   - values: [n] values one after another, may be NULL to zero new values
+///   - n: amount of keys
+///
+/// Returns:
+///   amount of keys that were stored, less than [n] only if memory allocation
+///   failed
+size_t map_put_batch(Map *map, const void *keys, const void *values, size_t n);
+
+
+
+/// Advance a pending rehash
+///
+/// Growing the map moves the entries into the bigger table a few at a time,
+/// each insertion and removal moves some of them. Lookups do not, so a map
+/// that is only read from can use this to finish the move early.
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///   - slots: maximum number of old slots to move
+///
+/// Returns:
+///   1 if the rehash is still pending afterwards, 0 otherwise
+int map_rehash_step(Map *map, size_t slots);
+
+
+
+/// Get the number of entries
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///
+/// Returns:
+///   amount of entries in the map. Size of NULL is 0
+size_t map_size(const Map *map);
+
+
+
+/// Statistics of a map
+///
+/// Fields:
+///   - counting: 1 if the library was built with DS_STATS. The counters
+///     alloc, probes, probe_slots and max_probe are only kept then and are 0
+///     otherwise
+///   - alloc: allocations of the map
+///   - probes: table probes of lookups, insertions and removals
+///   - probe_slots: slots from the home slot to where the probes ended, the
+///     average probe length is probe_slots / probes
+///   - max_probe: longest probe
+///   - size: amount of entries
+///   - capacity: slots of the table
+///   - table_bytes: bytes of the tables, including one that is still being
+///     rehashed
+///   - max_displacement: largest distance of an entry from its home slot
+///   - avg_displacement: average distance of an entry from its home slot
+typedef struct {
+    int counting;
+    DsAllocStats alloc;
+    uint64_t probes;
+    uint64_t probe_slots;
+    uint64_t max_probe;
+    size_t size;
+    size_t capacity;
+    size_t table_bytes;
+    size_t max_displacement;
+    double avg_displacement;
+} MapStats;
+
+
+
+/// Get statistics of a map
+///
+/// The displacements are measured by hashing every entry of the table, the
+/// entries of a table that is still being rehashed are not included.
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///   - stats: filled with the statistics, all 0 if [map] is NULL
+void map_stats(const Map *map, MapStats *stats);
+
+
+
+/// Record the operations on a map
+///
+/// Puts, gets and removes, also those of the batch and string functions, are
+/// appended to [trace], keyed by `ds_trace_key` of their key. Recording is
+/// only compiled in if the library was built with DS_TRACE.
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+///   - trace: trace that was returned by `ds_trace_open`, NULL to stop
+///
+/// Returns:
+///   1 if the operations will be recorded, 0 if [map] is NULL or the library
+///   was built without DS_TRACE
+int map_set_trace(Map *map, DsTrace *trace);
+
+
+
+/// Free the map
+///
+/// This function frees the map according to [dealloc] which was specified
+/// in `map_init`. The map should not be used after it has been freed.
+///
+/// Parameters:
+///   - map: handle to a map that was returned by `map_init`
+void map_free(Map *map);
+
+
+
+/// Handle to a static map
+///
+/// A static map is a read-only map that is built once from a known set of
+/// keys. Its index is a minimal perfect hash of about 3.5 bits per key, and
+/// keys and values are stored in exactly as many slots as there are keys.
+/// A lookup reads one pilot and then one slot.
+typedef struct static_map StaticMap;
+
+
+
+/// Build a static map
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - keys: [n] keys of [key_len] bytes one after another
+///   - values: [n] values of [val_len] bytes in the order of [keys], may be
+///     NULL if [val_len] is 0
+///   - n: amount of keys, less than about 4 billion
+///   - key_len: size of the keys
+///   - val_len: size of the values, may be 0 for a set
+///
+/// Returns:
+///   A pointer to a static map or NULL if [keys] contains a key twice or
+///   memory allocation fails
+StaticMap *map_build_static(const MapAllocFn alloc, const MapFreeFn dealloc, const void *keys, const void *values,
+        const size_t n, const size_t key_len, const size_t val_len);
+
+
+
+/// Get a value of a static map
+///
+/// Parameters:
+///   - map: handle to a static map
+///   - key: pointer to the key
+///
+/// Returns:
+///   a pointer to the value in the map or NULL if [key] is not present
+const void *static_map_get(const StaticMap *map, const void *key);
+
+
+
+/// Get the number of entries of a static map
+///
+/// Parameters:
+///   - map: handle to a static map
+///
+/// Returns:
+///   amount of entries in the map. Size of NULL is 0
+size_t static_map_size(const StaticMap *map);
+
+
+
+/// Get the size of a static map in bytes
+///
+/// Parameters:
+///   - map: handle to a static map
+///
+/// Returns:
+///   bytes of index and slots, which is also the size of its snapshot
+size_t static_map_bytes(const StaticMap *map);
+
+
+
+/// Save a static map to a file
+///
+/// The file is in native byte order and hashes depend on it, so it can only
+/// be read on machines of the same byte order.
+///
+/// Parameters:
+///   - map: handle to a static map
+///   - path: path of the file, it is overwritten
+///
+/// Returns:
+///   0 on success, -1 if the file could not be written
+int static_map_save(const StaticMap *map, const char *path);
+
+
+
+/// Load a static map that was saved by `static_map_save`
+///
+/// Parameters:
+///   - path: path of the file
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///
+/// Returns:
+///   A pointer to a static map or NULL if the file is not a valid snapshot or
+///   memory allocation fails
+StaticMap *static_map_load(const char *path, const MapAllocFn alloc, const MapFreeFn dealloc);
+
+
+
+/// Map a static map that was saved by `static_map_save` into memory
+///
+/// The map is used in place from the file without copying it. The checksum
+/// is still verified, which reads the file once.
+///
+/// Parameters:
+///   - path: path of the file
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///
+/// Returns:
+///   A pointer to a static map or NULL if the file is not a valid snapshot or
+///   it could not be mapped
+StaticMap *static_map_map(const char *path, const MapAllocFn alloc, const MapFreeFn dealloc);
+
+
+
+/// Free a static map
+///
+/// Parameters:
+///   - map: handle to a static map
+void static_map_free(StaticMap *map);
+
+#endif // JAZZY_MAP_H
@@ -0,0 +1,115 @@
+#ifndef JAZZY_PERF_H
+#define JAZZY_PERF_H
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/// Hardware and software events a DsPerf counts
+typedef enum {
+    DS_PERF_CYCLES,
+    DS_PERF_INSTRUCTIONS,
+    DS_PERF_L1D_MISSES,
+    DS_PERF_LLC_MISSES,
+    DS_PERF_DTLB_MISSES,
+    DS_PERF_BRANCH_MISSES,
+    DS_PERF_PAGE_FAULTS,
+    DS_PERF_EVENTS,
+} DsPerfEvent;
+
+
+/// Counts of one measurement
+///
+/// Fields:
+///   - ns: wall clock time between `ds_perf_begin` and `ds_perf_end`
+///   - available: bit e is set if event e was counted
+///   - value: count of every event, 0 if it was not counted. Counts are
+///     scaled up if the kernel had to share counters between events
+typedef struct {
+    uint64_t ns;
+    unsigned available;
+    uint64_t value[DS_PERF_EVENTS];
+} DsPerfCounts;
+
+
+/// Handle to a set of counters
+///
+/// The counters belong to the calling thread and only count user space.
+typedef struct ds_perf DsPerf;
+
+
+
+/// Open the counters
+///
+/// Events that can not be opened, because the machine is not Linux, the
+/// CPU has no such counter, or perf_event_paranoid forbids it, are left
+/// out. If no event is available only the time is measured.
+///
+/// Returns:
+///   A pointer to a DsPerf or NULL if the memory allocation fails
+DsPerf *ds_perf_init(void);
+
+
+
+/// Check whether an event is counted
+///
+/// Parameters:
+///   - perf: handle that was returned by `ds_perf_init`
+///   - event: the event
+///
+/// Returns:
+///   1 if [event] is counted, 0 otherwise
+int ds_perf_available(const DsPerf *perf, DsPerfEvent event);
+
+
+
+/// Start a measurement
+///
+/// Parameters:
+///   - perf: handle that was returned by `ds_perf_init`
+void ds_perf_begin(DsPerf *perf);
+
+
+
+/// End a measurement
+///
+/// Parameters:
+///   - perf: handle that was returned by `ds_perf_init`
+///   - counts: receives the counts since `ds_perf_begin`
+void ds_perf_end(DsPerf *perf, DsPerfCounts *counts);
+
+
+
+/// Get the name of an event
+///
+/// Parameters:
+///   - event: the event
+///
+/// Returns:
+///   a name like "cycles", NULL if [event] is out of range
+const char *ds_perf_event_name(DsPerfEvent event);
+
+
+
+/// Print the counts per operation as a JSON object
+///
+/// The object has "ns" and one member per available event, each divided by
+/// [ops], and "ipc" if cycles and instructions are available.
+///
+/// Parameters:
+///   - out: stream to print to
+///   - counts: counts that were filled by `ds_perf_end`
+///   - ops: operations that were measured, 0 is treated as 1
+void ds_perf_print(FILE *out, const DsPerfCounts *counts, size_t ops);
+
+
+
+/// Close the counters
+///
+/// Parameters:
+///   - perf: handle that was returned by `ds_perf_init`
+void ds_perf_free(DsPerf *perf);
+
+#endif // JAZZY_PERF_H
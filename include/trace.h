@@ -0,0 +1,128 @@
+#ifndef JAZZY_TRACE_H
+#define JAZZY_TRACE_H
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// Operation of a trace record
+typedef enum {
+    DS_TRACE_INSERT,
+    DS_TRACE_FIND,
+    DS_TRACE_REMOVE,
+    DS_TRACE_OPS,
+} DsTraceOp;
+
+
+/// Container a trace record came from
+typedef enum {
+    DS_TRACE_VECTOR,
+    DS_TRACE_TREE,
+    DS_TRACE_MAP,
+    DS_TRACE_SOURCES,
+} DsTraceSource;
+
+
+/// One recorded operation
+///
+/// Fields:
+///   - ns: time since the trace was opened
+///   - key: the key as returned by `ds_trace_key`, the index for a Vector
+///   - size: bytes of the element or value that was inserted
+///   - op: a DsTraceOp
+///   - source: a DsTraceSource
+typedef struct {
+    uint64_t ns;
+    uint64_t key;
+    uint32_t size;
+    uint8_t op;
+    uint8_t source;
+} DsTraceRecord;
+
+
+/// Handle to a trace that is being written
+///
+/// A trace is not thread safe, just like the containers it records.
+typedef struct ds_trace DsTrace;
+
+
+
+/// Create a trace file
+///
+/// Containers record into a trace that was attached with `vector_set_trace`,
+/// `tree_set_trace` or `map_set_trace`. Recording is only compiled into the
+/// library if it was built with DS_TRACE.
+///
+/// Parameters:
+///   - path: file to write, it is truncated if it exists
+///
+/// Returns:
+///   A pointer to a DsTrace or NULL if the file could not be created or the
+///   memory allocation fails
+DsTrace *ds_trace_open(const char *path);
+
+
+
+/// Append a record to a trace
+///
+/// Parameters:
+///   - trace: handle that was returned by `ds_trace_open`
+///   - source: container of the operation
+///   - op: the operation
+///   - key: the key, see `ds_trace_key`
+///   - size: bytes that were inserted, 0 for other operations
+void ds_trace_record(DsTrace *trace, DsTraceSource source, DsTraceOp op, uint64_t key, size_t size);
+
+
+
+/// Reduce a key to 64 bits
+///
+/// Keys of up to 8 bytes are stored as a little endian integer, so they keep
+/// their order if they are integers. Longer keys are hashed.
+///
+/// Parameters:
+///   - key: the key
+///   - len: bytes of [key]
+///
+/// Returns:
+///   the 64 bit key
+uint64_t ds_trace_key(const void *key, size_t len);
+
+
+
+/// Get the records that were written so far
+///
+/// Parameters:
+///   - trace: handle that was returned by `ds_trace_open`
+///
+/// Returns:
+///   the amount of records, 0 if [trace] is NULL
+size_t ds_trace_size(const DsTrace *trace);
+
+
+
+/// Flush and close a trace
+///
+/// Parameters:
+///   - trace: handle that was returned by `ds_trace_open`
+///
+/// Returns:
+///   1 if all records were written, 0 if a write failed
+int ds_trace_close(DsTrace *trace);
+
+
+
+/// Read a trace file
+///
+/// Parameters:
+///   - path: file that was written by a DsTrace
+///   - count: receives the amount of records
+///
+/// Returns:
+///   an array of [count] records that has to be released with free, NULL if
+///   the file could not be read, is not a trace or the memory allocation
+///   fails. An empty trace gives a non NULL array
+DsTraceRecord *ds_trace_load(const char *path, size_t *count);
+
+#endif // JAZZY_TRACE_H
@@ -1,8 +1,13 @@
 #ifndef JAZZY_TREE_H
 #define JAZZY_TREE_H
 
+// Header file
+#include "alloc.h"
+#include "trace.h"
+
 // Libraries
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -69,6 +74,35 @@ Tree *tree_init(const size_t elem_size, const TreeAllocFn alloc, const TreeFreeF
 ///   - value_size: size of the value that will inserted into the tree
 void tree_insert(Tree *tree, const void *value, const size_t value_size);
 
+/// Insert a value next to a known element
+///
+/// This function works like `tree_insert`, but first tries to attach [value]
+/// right next to [hint]. If [value] belongs directly before or after [hint]
+/// no descent from the root is needed. Otherwise a regular insert is done.
+///
+/// Regardless of the hint, a value larger than every element is attached
+/// below the cached largest node by all insert functions, so inserting
+/// ascending keys never walks down from the root. Both shortcuts need parent
+/// pointers and are skipped for trees with `TREE_NO_PARENT`.
+///
+/// Example:
+///   const void *last = NULL;
+///   for (size_t i = 0; i < count; ++i) {
+///       last = tree_insert_hint(tree, last, &events[i], sizeof(events[i]));
+///   }
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - hint: an element of [tree] as returned by `tree_lookup` or this
+///     function, or NULL. Hints are invalidated by `tree_delete`
+///   - value: pointer to the value that needs to be inserted
+///   - value_size: size of the value that will inserted into the tree
+///
+/// Returns:
+///   a pointer to the element equal to [value] in the tree, or NULL if the
+///   allocation failed
+const void *tree_insert_hint(Tree *tree, const void *hint, const void *value, const size_t value_size);
+
 /// Look up a value in a tree
 ///
 /// This function looksup values in the tree and returns a pointer to the data.
@@ -81,6 +115,119 @@ void tree_insert(Tree *tree, const void *value, const size_t value_size);
 ///   a pointer to the value if it was found and NULL other wise.
 const void *tree_lookup(const Tree *tree, const void *value);
 
+/// Find the first element that is not less than a key
+///
+/// This function and the ones below it find their element in a single
+/// descent from the root, using the comparator of the tree.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - key: pointer to the key to compare against
+///
+/// Returns:
+///   a pointer to the element or NULL if there is none
+const void *tree_lower_bound(const Tree *tree, const void *key);
+
+/// Find the first element that is greater than a key
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - key: pointer to the key to compare against
+///
+/// Returns:
+///   a pointer to the element or NULL if there is none
+const void *tree_upper_bound(const Tree *tree, const void *key);
+
+/// Find the smallest element that is greater than or equal to a key
+///
+/// Same as `tree_lower_bound`.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - key: pointer to the key to compare against
+///
+/// Returns:
+///   a pointer to the element or NULL if there is none
+const void *tree_ceil(const Tree *tree, const void *key);
+
+/// Find the largest element that is less than or equal to a key
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - key: pointer to the key to compare against
+///
+/// Returns:
+///   a pointer to the element or NULL if there is none
+const void *tree_floor(const Tree *tree, const void *key);
+
+/// Find the smallest element that is greater than a key
+///
+/// Same as `tree_upper_bound`. Passing an element of the tree gives the next
+/// one in order.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - key: pointer to the key to compare against
+///
+/// Returns:
+///   a pointer to the element or NULL if there is none
+const void *tree_successor(const Tree *tree, const void *key);
+
+/// Find the largest element that is less than a key
+///
+/// Passing an element of the tree gives the previous one in order.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - key: pointer to the key to compare against
+///
+/// Returns:
+///   a pointer to the element or NULL if there is none
+const void *tree_predecessor(const Tree *tree, const void *key);
+
+/// Get the smallest element
+///
+/// The smallest and largest nodes are cached, so this takes O(1).
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///
+/// Returns:
+///   a pointer to the element or NULL if the tree is empty
+const void *tree_min(const Tree *tree);
+
+/// Get the largest element
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///
+/// Returns:
+///   a pointer to the element or NULL if the tree is empty
+const void *tree_max(const Tree *tree);
+
+/// Remove the smallest element
+///
+/// This function copies the smallest element to [out] and deletes it, which
+/// makes the tree usable as a priority queue.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - out: buffer of the element size, may be NULL
+///
+/// Returns:
+///   1 if an element was removed, 0 if the tree was empty
+int tree_pop_min(Tree *tree, void *out);
+
+/// Remove the largest element
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - out: buffer of the element size, may be NULL
+///
+/// Returns:
+///   1 if an element was removed, 0 if the tree was empty
+int tree_pop_max(Tree *tree, void *out);
+
 /// Delete a value from the tree 
 ///
 /// This function deletes a value from the tree if it is found.
@@ -100,6 +247,381 @@ void tree_delete(Tree *tree, const void *value);
 void tree_free(Tree *tree);
 
 
+/// Get the number of elements in a tree
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///
+/// Returns:
+///   amount of elements in the tree. Size of NULL is 0
+size_t tree_size(const Tree *tree);
+
+
+/// Statistics of a tree
+///
+/// Fields:
+///   - counting: 1 if the library was built with DS_STATS. The counters
+///     alloc, compares and rotations are only kept then and are 0 otherwise
+///   - alloc: allocations of the tree
+///   - compares: comparator calls of insertions
+///   - rotations: single rotations of insertions and deletions, a double
+///     rotation counts as 2
+///   - size: amount of elements
+///   - height: nodes on the longest path from the root, 0 if empty
+///   - ideal_height: height of a perfect tree with [size] elements. An AVL
+///     tree is at most about 1.44 times as high
+///   - node_bytes: bytes of one node
+///   - overhead_bytes: bytes of all nodes that do not hold elements
+typedef struct {
+    int counting;
+    DsAllocStats alloc;
+    uint64_t compares;
+    uint64_t rotations;
+    size_t size;
+    size_t height;
+    size_t ideal_height;
+    size_t node_bytes;
+    size_t overhead_bytes;
+} TreeStats;
+
+/// Get statistics of a tree
+///
+/// The height is measured by visiting every node.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - stats: filled with the statistics, all 0 if [tree] is NULL
+void tree_stats(const Tree *tree, TreeStats *stats);
+
+
+
+/// Record the operations on a tree
+///
+/// Insertions, lookups and deletions are appended to [trace], keyed by
+/// `ds_trace_key` of their key. Recording is only compiled in if the library
+/// was built with DS_TRACE.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - trace: trace that was returned by `ds_trace_open`, NULL to stop
+///
+/// Returns:
+///   1 if the operations will be recorded, 0 if [tree] is NULL or the
+///   library was built without DS_TRACE
+int tree_set_trace(Tree *tree, DsTrace *trace);
+
+
+/// Insert a value and get a buffer to it
+///
+/// This function works like `tree_insert` but only the first key_size bytes
+/// of [value] are copied (all of it for a tree from `tree_init`), the rest is
+/// zeroed. The returned buffer can be used to fill in the rest of the element.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - value: pointer to the value that needs to be inserted
+///   - value_size: size of the value that will inserted into the tree
+///
+/// Returns:
+///   a pointer to the stored element or NULL if the key was already present
+///   or the allocation failed
+void *tree_insert_with_buf(Tree *tree, const void *value, const size_t value_size);
+
+
+/*********************************** Map mode *********************************/
+
+/// Initialize a tree that maps keys to values
+///
+/// This function initializes a tree whose elements are a key of [key_size] bytes
+/// followed by a value of [val_size] bytes. The value is padded like it would be
+/// in a struct { key; value; }, which is what `tree_insert` and `tree_lookup`
+/// work on. Only the key is passed to [comp], so values can be updated in
+/// place without changing the order.
+///
+/// Parameters:
+///   - key_size: size of the keys
+///   - val_size: size of the values
+///   - alloc: memory allocator
+///   - dealloc: memory free function
+///   - comp: function used to compare two keys
+///
+/// Returns:
+///   A pointer to a tree or NULL if the memory allocation fails
+Tree *tree_init_map(const size_t key_size, const size_t val_size, const TreeAllocFn alloc,
+        const TreeFreeFn dealloc, const TreeComparator comp);
+
+/// Options for `tree_init_ex`
+typedef enum {
+    TREE_DEFAULT = 0,
+
+    /// Do not store a parent pointer in every node. This saves a pointer per
+    /// node, iteration keeps a stack of ancestors instead.
+    TREE_NO_PARENT = 1 << 0,
+} TreeFlags;
+
+/// Initialize a tree with options
+///
+/// This function works like `tree_init_map` and takes a combination of
+/// `TreeFlags` that control the node layout.
+///
+/// Parameters:
+///   - key_size: size of the keys
+///   - val_size: size of the values, 0 for a tree that is not a map
+///   - flags: bitwise or of `TreeFlags`
+///   - alloc: memory allocator
+///   - dealloc: memory free function
+///   - comp: function used to compare two keys
+///
+/// Returns:
+///   A pointer to a tree or NULL if the memory allocation fails
+Tree *tree_init_ex(const size_t key_size, const size_t val_size, const int flags, const TreeAllocFn alloc,
+        const TreeFreeFn dealloc, const TreeComparator comp);
+
+/// Initialize a tree with a DsAllocator
+///
+/// This function works like `tree_init_ex`, but all memory comes from
+/// [allocator]. Nodes are freed with their size, so a pool allocator does
+/// not need a header per node.
+///
+/// Parameters:
+///   - key_size: size of the keys
+///   - val_size: size of the values, 0 for a tree that is not a map
+///   - flags: bitwise or of `TreeFlags`
+///   - allocator: the allocator, NULL for malloc and free
+///   - comp: function used to compare two keys
+///
+/// Returns:
+///   A pointer to a tree or NULL if the memory allocation fails
+Tree *tree_init_alloc(const size_t key_size, const size_t val_size, const int flags, const DsAllocator *allocator,
+        const TreeComparator comp);
+
+/// This type represents functions that are called for elements of a tree
+///
+/// Parameters:
+///   - const void *: the element
+///   - void *: context pointer that was passed along
+///
+/// Returns:
+///   non zero to stop, 0 to continue
+typedef int (*TreeVisitFn)(const void *, void *);
+
+/// Insert or overwrite the value for a key
+///
+/// This function looks for [key] and inserts it if it is not present.
+/// Either way [value] is copied into the value slot. Only one descent is done.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init_map`
+///   - key: pointer to the key
+///   - value: pointer to the value
+///
+/// Returns:
+///   a pointer to the value slot or NULL if the allocation failed. The slot is
+///   valid until the next call to `tree_delete` on [tree], which may move
+///   elements between nodes
+void *tree_upsert(Tree *tree, const void *key, const void *value);
+
+/// Get the value for a key
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init_map`
+///   - key: pointer to the key
+///
+/// Returns:
+///   a writable pointer to the value slot or NULL if [key] is not present
+void *tree_get_value(const Tree *tree, const void *key);
+
+/// Get the value for a key and insert it if it is missing
+///
+/// This function looks for [key] and inserts it with a zeroed value if it is
+/// not present. Only one descent is done.
+///
+/// Example:
+///   uint64_t *count = tree_get_or_insert(counters, &id, NULL);
+///   if (count != NULL) {
+///       *count += 1;
+///   }
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init_map`
+///   - key: pointer to the key
+///   - inserted: set to 1 if the key was inserted and 0 otherwise, may be NULL
+///
+/// Returns:
+///   a pointer to the value slot or NULL if the allocation failed
+void *tree_get_or_insert(Tree *tree, const void *key, int *inserted);
+
+
+/******************************** Interval mode *******************************/
+
+/// Initialize an interval tree
+///
+/// This function initializes a tree whose keys are closed intervals. A key is
+/// a start point followed by an end point, both [point_size] bytes, and an
+/// optional value follows like in `tree_init_map`. [comp] compares two points.
+/// Keys are ordered by start, then by end, so intervals with the same start
+/// can be stored. Every node also keeps the largest end point below it, which
+/// lets `tree_overlaps` skip subtrees. The start must not be after the end.
+///
+/// Example:
+///   struct { uint32_t lo, hi; } window = { 10, 20 };
+///   Tree *windows = tree_init_interval(sizeof(uint32_t), 0, malloc, free, compare_u32);
+///   tree_insert(windows, &window, sizeof(window));
+///
+/// Parameters:
+///   - point_size: size of a start or end point
+///   - val_size: size of the values, may be 0
+///   - alloc: memory allocator
+///   - dealloc: memory free function
+///   - comp: function used to compare two points
+///
+/// Returns:
+///   A pointer to a tree or NULL if the memory allocation fails
+Tree *tree_init_interval(const size_t point_size, const size_t val_size, const TreeAllocFn alloc,
+        const TreeFreeFn dealloc, const TreeComparator comp);
+
+/// Find all intervals that overlap a range
+///
+/// This function calls [visit] for every interval that shares at least one
+/// point with [lo, hi], ordered by start. It takes O(log n + k) for k results.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init_interval`
+///   - lo: start of the range
+///   - hi: end of the range
+///   - visit: called with each interval and [ctx], may be NULL to only count
+///   - ctx: passed to [visit]
+///
+/// Returns:
+///   the number of intervals that were visited
+size_t tree_overlaps(const Tree *tree, const void *lo, const void *hi, const TreeVisitFn visit, void *ctx);
+
+/// Find all intervals that contain a point
+///
+/// Same as `tree_overlaps` with [point] as start and end of the range.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init_interval`
+///   - point: the point
+///   - visit: called with each interval and [ctx], may be NULL to only count
+///   - ctx: passed to [visit]
+///
+/// Returns:
+///   the number of intervals that were visited
+size_t tree_stab(const Tree *tree, const void *point, const TreeVisitFn visit, void *ctx);
+
+
+/********************************* Frozen tree ********************************/
+
+/// A handle to a frozen tree
+///
+/// A frozen tree is an immutable copy of a tree that is laid out for fast
+/// lookups. The elements are stored in one array in Eytzinger (BFS) order, so
+/// a lookup walks down the array instead of chasing node pointers.
+typedef struct _FrozenTree FrozenTree;
+
+/// Freeze a tree
+///
+/// This function copies the elements of [tree] into a new frozen tree. [tree]
+/// is not changed and can still be used. Memory is allocated according to
+/// [tree]'s alloc function.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///
+/// Returns:
+///   A pointer to a frozen tree or NULL if the memory allocation fails
+FrozenTree *tree_freeze(const Tree *tree);
+
+/// Look up a value in a frozen tree
+///
+/// This function works like `tree_lookup` and uses the comparator of the tree
+/// that was frozen.
+///
+/// Parameters:
+///   - frozen: handle to a frozen tree that was returned by `tree_freeze`
+///   - key: pointer to the key that needs to be looked up
+///
+/// Returns:
+///   a pointer to the element if it was found and NULL other wise.
+const void *frozen_lookup(const FrozenTree *frozen, const void *key);
+
+/// Look up a 32 bit key in a frozen tree
+///
+/// This function works like `frozen_lookup` but compares the keys as unsigned
+/// integers without calling the comparator. It can only be used if the keys
+/// are 4 bytes and the comparator orders them like unsigned integers.
+///
+/// Parameters:
+///   - frozen: handle to a frozen tree that was returned by `tree_freeze`
+///   - key: the key that needs to be looked up
+///
+/// Returns:
+///   a pointer to the element if it was found and NULL other wise.
+const void *frozen_lookup_u32(const FrozenTree *frozen, const uint32_t key);
+
+/// Look up a 64 bit key in a frozen tree
+///
+/// Same as `frozen_lookup_u32` for keys of 8 bytes.
+///
+/// Parameters:
+///   - frozen: handle to a frozen tree that was returned by `tree_freeze`
+///   - key: the key that needs to be looked up
+///
+/// Returns:
+///   a pointer to the element if it was found and NULL other wise.
+const void *frozen_lookup_u64(const FrozenTree *frozen, const uint64_t key);
+
+/// Get the number of elements in a frozen tree
+///
+/// Parameters:
+///   - frozen: handle to a frozen tree that was returned by `tree_freeze`
+///
+/// Returns:
+///   amount of elements in the frozen tree. Size of NULL is 0
+size_t frozen_size(const FrozenTree *frozen);
+
+/// Free a frozen tree
+///
+/// Parameters:
+///   - frozen: handle to a frozen tree that was returned by `tree_freeze`
+void frozen_free(FrozenTree *frozen);
+
+
+/********************************** Snapshot **********************************/
+
+/// Save a tree to a file
+///
+/// This function writes the elements of [tree] in order to [path], after a
+/// versioned header with the element size, the count and a checksum. An
+/// existing file is overwritten.
+///
+/// Parameters:
+///   - tree: handle to a tree that was returned by `tree_init`
+///   - path: path of the file to write
+///
+/// Returns:
+///   0 on success, -1 if the file could not be written
+int tree_save(const Tree *tree, const char *path);
+
+/// Load a tree from a file
+///
+/// This function reads a snapshot that was written by `tree_save`. Since the
+/// elements are already sorted, the tree is built in O(n) without any
+/// comparisons or rotations. [comp] must order the keys like the comparator
+/// of the saved tree did.
+///
+/// Parameters:
+///   - path: path of the file to read
+///   - alloc: memory allocator
+///   - dealloc: memory free function
+///   - comp: function used to compare two keys
+///
+/// Returns:
+///   A pointer to a tree or NULL if the file is invalid or allocation fails
+Tree *tree_load(const char *path, const TreeAllocFn alloc, const TreeFreeFn dealloc, const TreeComparator comp);
+
+
 /********************* Helper functions for macro wrapper *********************/
 
 /// Initialize a buffer for temporary values
@@ -2,8 +2,13 @@
 #define VECTOR_H
 
 
+// Header file
+#include "alloc.h"
+#include "trace.h"
+
 // Libraries
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,6 +43,28 @@ typedef void (*VecCallocFn)(size_t);
 typedef void (*VecFreeFn)(void *);
 
 
+/// Statistics of a vector
+///
+/// Fields:
+///   - counting: 1 if the library was built with DS_STATS. The counters
+///     alloc, grows and copy_bytes are only kept then and are 0 otherwise
+///   - alloc: allocations of the vector
+///   - grows: times the storage grew
+///   - copy_bytes: bytes that were moved to new storage while growing
+///   - len: amount of elements
+///   - cap: amount of elements the storage has room for
+///   - slack_bytes: bytes of storage that hold no element
+typedef struct {
+    int counting;
+    DsAllocStats alloc;
+    uint64_t grows;
+    uint64_t copy_bytes;
+    size_t len;
+    size_t cap;
+    size_t slack_bytes;
+} VectorStats;
+
+
 /// Handle to a vector
 ///
 /// This struct represents a handle to a vector
@@ -59,6 +86,18 @@ Vector *vector_init(const VecAllocFn alloc, const VecFreeFn dealloc, const size_
 
 
 
+/// Initialize a vector with a DsAllocator
+///
+/// This function works like `vector_init`, but all memory comes from
+/// [allocator]. Growing the storage uses its realloc hook.
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for malloc and free
+///   - elemsize: sizeof the elements that will be stored
+Vector *vector_init_alloc(const DsAllocator *allocator, const size_t elemsize);
+
+
+
 /// Push a value into the vector
 ///
 /// This function appends a value to the end of [vec]
@@ -130,7 +169,8 @@ size_t vector_elem_size(const Vector *vec);
 ///   - vec: handle to a Vector that was returned by `vec_init`
 ///
 /// Returns:
-///   function pointer to the alloc function, NULL if [vec] is NULL
+///   function pointer to the alloc function, NULL if [vec] is NULL or was
+///   initialized with a DsAllocator
 VecAllocFn vector_alloc_fn(const Vector *vec);
 
 
@@ -143,11 +183,234 @@ VecAllocFn vector_alloc_fn(const Vector *vec);
 ///   - vec: handle to a Vector that was returned by `vec_init`
 ///
 /// Returns:
-///   function pointer to the alloc function, NULL if [vec] is NULL
+///   function pointer to the alloc function, NULL if [vec] is NULL or was
+///   initialized with a DsAllocator
 VecFreeFn vector_dealloc_fn(const Vector *vec);
 
 
 
+/// Get statistics of a vector
+///
+/// This function fills [stats] with the counters of [vec] and its current
+/// shape. The counters are only kept if the library was built with DS_STATS.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - stats: filled with the statistics, all 0 if [vec] is NULL
+void vector_stats(const Vector *vec, VectorStats *stats);
+
+
+
+/// Record the operations on a vector
+///
+/// Insertions and `vector_at` are appended to [trace], keyed by their
+/// index. Recording is only compiled in if the library was built with
+/// DS_TRACE.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - trace: trace that was returned by `ds_trace_open`, NULL to stop
+///
+/// Returns:
+///   1 if the operations will be recorded, 0 if [vec] is NULL or the library
+///   was built without DS_TRACE
+int vector_set_trace(Vector *vec, DsTrace *trace);
+
+
+
+
+/********************************** Parallel **********************************/
+/// The vector_par functions split the elements into tasks of [grain]
+/// elements that run on a built-in work-stealing pool. A worker takes the
+/// tasks of its own range front to back and steals half of the remaining
+/// range of another worker once it runs dry. The calling thread works too.
+/// Callbacks run concurrently and must not change the vector. A vector_par
+/// call from inside a callback runs on the calling thread only, and so does
+/// everything if no thread can be started.
+
+
+/// Called for every element by `vector_par_for_each`
+typedef void (*VecVisitFn)(void *elem, void *ctx);
+
+/// Computes [out] from [in] for `vector_par_map`
+typedef void (*VecMapFn)(const void *in, void *out, void *ctx);
+
+/// Folds [value] into [acc], for `vector_par_reduce` and `vector_par_scan`
+typedef void (*VecFoldFn)(void *acc, const void *value, void *ctx);
+
+/// Returns non zero if [elem] belongs in front for `vector_par_partition`
+typedef int (*VecPredFn)(const void *elem, void *ctx);
+
+
+/// Settings of a parallel call
+///
+/// Fields:
+///   - threads: threads that work on the call including the calling one, 0
+///     for one per online CPU. At most VEC_PAR_MAX_THREADS
+///   - grain: elements per task, 0 to pick one. Small vectors run on the
+///     calling thread
+typedef struct {
+    size_t threads;
+    size_t grain;
+} VecParConfig;
+
+#define VEC_PAR_MAX_THREADS 256
+
+
+
+/// Call a function on every element in parallel
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - visit: called with a pointer to every element and [ctx]
+///   - ctx: passed to [visit]
+///   - config: settings, NULL for the defaults
+///
+/// Returns:
+///   1 on success, 0 if [vec] or [visit] is NULL
+int vector_par_for_each(Vector *vec, VecVisitFn visit, void *ctx, const VecParConfig *config);
+
+
+
+/// Compute every element of [out] from [vec] in parallel
+///
+/// [out] gets as many elements as [vec], element i is written by [map] from
+/// element i of [vec]. The elements of [out] may have another size.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - out: vector that receives the results, its elements are replaced
+///   - map: called with an element of [vec], one of [out] and [ctx]
+///   - ctx: passed to [map]
+///   - config: settings, NULL for the defaults
+///
+/// Returns:
+///   1 on success, 0 if an argument is NULL, [out] is [vec] or an
+///   allocation fails
+int vector_par_map(const Vector *vec, Vector *out, VecMapFn map, void *ctx, const VecParConfig *config);
+
+
+
+/// Reduce the elements to a value in parallel
+///
+/// Every task folds its elements into a copy of [acc] with [fold], then the
+/// results of the tasks are combined in order with [combine]. So [acc] has
+/// to be an identity of [combine], and [combine] has to be associative, but
+/// not commutative.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - acc: identity on entry, the result on return
+///   - acc_size: size of [acc]
+///   - fold: folds an element into an accumulator
+///   - combine: folds the accumulator of a later task into one of an earlier
+///   - ctx: passed to [fold] and [combine]
+///   - config: settings, NULL for the defaults
+///
+/// Returns:
+///   1 on success, 0 if an argument is NULL or an allocation fails
+int vector_par_reduce(const Vector *vec, void *acc, size_t acc_size, VecFoldFn fold, VecFoldFn combine, void *ctx,
+        const VecParConfig *config);
+
+
+
+/// Replace every element by the prefix up to it in parallel
+///
+/// This is an inclusive scan, element i becomes element 0 [op] ... [op]
+/// element i, for example a prefix sum. [op] folds its second argument into
+/// the first and has to be associative. It is called about twice per element.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - op: the operation
+///   - ctx: passed to [op]
+///   - config: settings, NULL for the defaults
+///
+/// Returns:
+///   1 on success, 0 if an argument is NULL or an allocation fails
+int vector_par_scan(Vector *vec, VecFoldFn op, void *ctx, const VecParConfig *config);
+
+
+
+/// Move the elements that match a predicate to the front in parallel
+///
+/// The partition is stable, the elements on both sides keep their order. It
+/// needs a buffer as large as the elements.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - pred: returns non zero for elements that go to the front
+///   - ctx: passed to [pred]
+///   - count: receives the amount of matching elements, may be NULL
+///   - config: settings, NULL for the defaults
+///
+/// Returns:
+///   1 on success, 0 if an argument is NULL or an allocation fails
+int vector_par_partition(Vector *vec, VecPredFn pred, void *ctx, size_t *count, const VecParConfig *config);
+
+
+
+/// Stop the threads of the parallel functions
+///
+/// They are started by the first parallel call and run until this is
+/// called. No parallel call may be running. A later call starts them again.
+void vector_par_shutdown(void);
+
+
+
+
+/********************************** Snapshot **********************************/
+
+/// Save a vector to a file
+///
+/// This function writes a snapshot of [vec] to [path]. The snapshot is a
+/// versioned header (element size, count and checksum) followed by the raw
+/// elements. An existing file is overwritten.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - path: path of the file to write
+///
+/// Returns:
+///   0 on success, -1 if the file could not be written
+int vector_save(const Vector *vec, const char *path);
+
+
+
+/// Load a vector from a file
+///
+/// This function reads a snapshot that was written by `vector_save` and copies
+/// its elements into a new vector.
+///
+/// Parameters:
+///   - path: path of the file to read
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///
+/// Returns:
+///   a new vector or NULL if the file is invalid or memory allocation fails
+Vector *vector_load(const char *path, const VecAllocFn alloc, const VecFreeFn dealloc);
+
+
+
+/// Map a vector from a file
+///
+/// This function works like `vector_load` but the elements are not copied.
+/// They are mapped privately from [path], so changes are never written back.
+/// The mapping is replaced by regular storage the first time the vector grows
+/// and released by `vector_free`.
+///
+/// Parameters:
+///   - path: path of the file to map
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///
+/// Returns:
+///   a new vector or NULL if the file is invalid or mapping it fails
+Vector *vector_map(const char *path, const VecAllocFn alloc, const VecFreeFn dealloc);
+
+
+
 
 /******************************* Macro wrapper ********************************/
 /// NOTE: for the following documentation Vec refers to the 'wrapper struct' 
@@ -0,0 +1,479 @@
+// Needed for posix_memalign and pthread_key_t
+#define _POSIX_C_SOURCE 200809L
+
+// Header file
+#include "../../include/alloc.h"
+
+// Libraries
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/********************************** Private ***********************************/
+
+/// Default block size of an arena
+#define DS_ARENA_BLOCK 65536
+
+/// Smallest size class of the pool, classes double up to DS_POOL_MAX_SIZE
+#define DS_POOL_MIN_SIZE 16
+#define DS_POOL_CLASSES 8
+
+/// Bytes the pool keeps per thread and size class, frees beyond this go to
+/// free so a thread that drops a large container does not hoard it
+#define DS_POOL_CACHE_BYTES 262144
+
+
+static void *ds_default_alloc(void *ctx, const size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *ds_default_realloc(void *ctx, void *ptr, const size_t old_size, const size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void ds_default_free(void *ctx, void *ptr, const size_t size) {
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+/// Memory of posix_memalign can be released with free
+static void *ds_default_aligned_alloc(void *ctx, const size_t alignment, const size_t size) {
+    (void)ctx;
+    if (alignment <= DS_ALLOC_MIN_ALIGN) {
+        return malloc(size);
+    }
+    void *ptr;
+    return posix_memalign(&ptr, alignment, size) == 0 ? ptr : NULL;
+}
+
+
+
+/********************************* Bump arena *********************************/
+
+typedef struct _DsArenaBlock DsArenaBlock;
+
+/// Header at the start of every block, the block has [size] bytes in total
+struct _DsArenaBlock {
+    DsArenaBlock *next;
+    size_t size;
+};
+
+
+struct ds_arena {
+    DsAllocator parent;
+    size_t block_size;
+    DsArenaBlock *blocks; /* All blocks */
+    DsArenaBlock *current; /* Block that is bumped, NULL before the first allocation */
+    char *cur; /* Next free byte of current */
+    char *end; /* End of current */
+    size_t used;
+};
+
+
+
+static void *ds_arena_aligned_alloc(void *ctx, const size_t alignment, const size_t size) {
+    DsArena *arena = ctx;
+    const size_t align = alignment < DS_ALLOC_MIN_ALIGN ? DS_ALLOC_MIN_ALIGN : alignment;
+
+    uintptr_t start = ((uintptr_t)arena->cur + align - 1) & ~(uintptr_t)(align - 1);
+    if (arena->current != NULL && start <= (uintptr_t)arena->end && size <= (uintptr_t)arena->end - start) {
+        arena->used += start + size - (uintptr_t)arena->cur;
+        arena->cur = (char *)(start + size);
+        return (void *)start;
+    }
+
+    // Room for the header, the worst case padding and the allocation
+    const size_t overhead = sizeof(DsArenaBlock) + align - 1;
+    if (size > SIZE_MAX - overhead) {
+        return NULL;
+    }
+    const int own_block = size + overhead > arena->block_size;
+    const size_t block_size = own_block ? size + overhead : arena->block_size;
+    DsArenaBlock *block = ds_alloc(&arena->parent, block_size);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->size = block_size;
+    start = ((uintptr_t)(block + 1) + align - 1) & ~(uintptr_t)(align - 1);
+    arena->used += size;
+
+    // A block of its own goes behind the current one, which keeps its rest
+    if (own_block && arena->current != NULL) {
+        block->next = arena->current->next;
+        arena->current->next = block;
+        return (void *)start;
+    }
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->current = block;
+    arena->cur = (char *)(start + size);
+    arena->end = (char *)block + block_size;
+    return (void *)start;
+}
+
+static void *ds_arena_alloc(void *ctx, const size_t size) {
+    return ds_arena_aligned_alloc(ctx, DS_ALLOC_MIN_ALIGN, size);
+}
+
+/// Only the latest allocation can be given back
+static void ds_arena_free_sized(void *ctx, void *ptr, const size_t size) {
+    DsArena *arena = ctx;
+    if ((char *)ptr + size == arena->cur) {
+        arena->cur = ptr;
+        arena->used -= size;
+    }
+}
+
+/// The latest allocation grows in place if the block has room
+static void *ds_arena_realloc(void *ctx, void *ptr, const size_t old_size, const size_t new_size) {
+    DsArena *arena = ctx;
+    if (ptr == NULL) {
+        return ds_arena_alloc(ctx, new_size);
+    }
+    if ((char *)ptr + old_size == arena->cur && new_size <= (size_t)(arena->end - (char *)ptr)) {
+        arena->cur = (char *)ptr + new_size;
+        arena->used = arena->used - old_size + new_size;
+        return ptr;
+    }
+    if (new_size <= old_size) {
+        return ptr;
+    }
+
+    void *new_ptr = ds_arena_alloc(ctx, new_size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+
+
+/****************************** Thread local pool *****************************/
+
+typedef struct _DsPoolBlock DsPoolBlock;
+
+struct _DsPoolBlock {
+    DsPoolBlock *next;
+};
+
+
+typedef struct {
+    DsPoolBlock *head[DS_POOL_CLASSES];
+    size_t count[DS_POOL_CLASSES];
+} DsPoolCache;
+
+
+static pthread_key_t ds_pool_key;
+static pthread_once_t ds_pool_once = PTHREAD_ONCE_INIT;
+static int ds_pool_key_ok = 0;
+
+
+
+static void ds_pool_release(DsPoolCache *cache) {
+    for (size_t c = 0; c < DS_POOL_CLASSES; ++c) {
+        while (cache->head[c] != NULL) {
+            DsPoolBlock *next = cache->head[c]->next;
+            free(cache->head[c]);
+            cache->head[c] = next;
+        }
+        cache->count[c] = 0;
+    }
+}
+
+static void ds_pool_destroy(void *ptr) {
+    ds_pool_release(ptr);
+    free(ptr);
+}
+
+static void ds_pool_make_key(void) {
+    ds_pool_key_ok = pthread_key_create(&ds_pool_key, ds_pool_destroy) == 0;
+}
+
+
+
+/// Cache of the calling thread, NULL if it could not be set up. The pool
+/// then passes everything through to malloc and free.
+static DsPoolCache *ds_pool_cache(const int create) {
+    pthread_once(&ds_pool_once, ds_pool_make_key);
+    if (!ds_pool_key_ok) {
+        return NULL;
+    }
+    DsPoolCache *cache = pthread_getspecific(ds_pool_key);
+    if (cache == NULL && create) {
+        cache = malloc(sizeof(DsPoolCache));
+        if (cache == NULL) {
+            return NULL;
+        }
+        memset(cache, 0, sizeof(DsPoolCache));
+        if (pthread_setspecific(ds_pool_key, cache) != 0) {
+            free(cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+
+
+/// Size class of [size], which is at most DS_POOL_MAX_SIZE
+static size_t ds_pool_class(const size_t size) {
+    size_t c = 0;
+    while ((size_t)DS_POOL_MIN_SIZE << c < size) {
+        c++;
+    }
+    return c;
+}
+
+
+
+static void *ds_pool_alloc(void *ctx, const size_t size) {
+    (void)ctx;
+    if (size > DS_POOL_MAX_SIZE) {
+        return malloc(size);
+    }
+
+    const size_t c = ds_pool_class(size);
+    DsPoolCache *cache = ds_pool_cache(0);
+    if (cache != NULL && cache->head[c] != NULL) {
+        DsPoolBlock *block = cache->head[c];
+        cache->head[c] = block->next;
+        cache->count[c]--;
+        return block;
+    }
+    return malloc((size_t)DS_POOL_MIN_SIZE << c);
+}
+
+static void ds_pool_free_sized(void *ctx, void *ptr, const size_t size) {
+    (void)ctx;
+    if (size > DS_POOL_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+
+    const size_t c = ds_pool_class(size);
+    DsPoolCache *cache = ds_pool_cache(1);
+    if (cache == NULL || cache->count[c] >= DS_POOL_CACHE_BYTES / ((size_t)DS_POOL_MIN_SIZE << c)) {
+        free(ptr);
+        return;
+    }
+    DsPoolBlock *block = ptr;
+    block->next = cache->head[c];
+    cache->head[c] = block;
+    cache->count[c]++;
+}
+
+static void *ds_pool_realloc(void *ctx, void *ptr, const size_t old_size, const size_t new_size) {
+    if (ptr == NULL) {
+        return ds_pool_alloc(ctx, new_size);
+    }
+    if (old_size > DS_POOL_MAX_SIZE && new_size > DS_POOL_MAX_SIZE) {
+        return realloc(ptr, new_size);
+    }
+    if (old_size <= DS_POOL_MAX_SIZE && new_size <= DS_POOL_MAX_SIZE &&
+            ds_pool_class(old_size) == ds_pool_class(new_size)) {
+        return ptr;
+    }
+
+    void *new_ptr = ds_pool_alloc(ctx, new_size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    ds_pool_free_sized(ctx, ptr, old_size);
+    return new_ptr;
+}
+
+/// Cached blocks are not aligned beyond malloc, so aligned blocks are always
+/// fresh. They are sized like their class, so they can be cached when freed.
+static void *ds_pool_aligned_alloc(void *ctx, const size_t alignment, const size_t size) {
+    if (alignment <= DS_ALLOC_MIN_ALIGN) {
+        return ds_pool_alloc(ctx, size);
+    }
+    const size_t block_size = size > DS_POOL_MAX_SIZE ? size : (size_t)DS_POOL_MIN_SIZE << ds_pool_class(size);
+    return ds_default_aligned_alloc(NULL, alignment, block_size);
+}
+
+
+
+/********************************** Public ************************************/
+
+DsAllocator ds_allocator_default(void) {
+    DsAllocator allocator = {
+        .ctx = NULL,
+        .alloc = ds_default_alloc,
+        .realloc = ds_default_realloc,
+        .free_sized = ds_default_free,
+        .aligned_alloc = ds_default_aligned_alloc,
+    };
+    return allocator;
+}
+
+
+
+void *ds_alloc(const DsAllocator *allocator, const size_t size) {
+    if (allocator == NULL) {
+        return malloc(size);
+    }
+    return allocator->alloc(allocator->ctx, size);
+}
+
+
+
+void *ds_realloc(const DsAllocator *allocator, void *ptr, const size_t old_size, const size_t new_size) {
+    if (allocator == NULL) {
+        return realloc(ptr, new_size);
+    }
+    if (allocator->realloc != NULL) {
+        return allocator->realloc(allocator->ctx, ptr, old_size, new_size);
+    }
+
+    void *new_ptr = allocator->alloc(allocator->ctx, new_size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+    if (ptr != NULL) {
+        memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+        allocator->free_sized(allocator->ctx, ptr, old_size);
+    }
+    return new_ptr;
+}
+
+
+
+void *ds_aligned_alloc(const DsAllocator *allocator, const size_t alignment, const size_t size) {
+    // Sanity check
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+
+    if (allocator == NULL) {
+        return ds_default_aligned_alloc(NULL, alignment, size);
+    }
+    if (allocator->aligned_alloc != NULL) {
+        return allocator->aligned_alloc(allocator->ctx, alignment, size);
+    }
+    return alignment <= DS_ALLOC_MIN_ALIGN ? allocator->alloc(allocator->ctx, size) : NULL;
+}
+
+
+
+void ds_free(const DsAllocator *allocator, void *ptr, const size_t size) {
+    // Sanity check
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (allocator == NULL) {
+        free(ptr);
+        return;
+    }
+    allocator->free_sized(allocator->ctx, ptr, size);
+}
+
+
+
+DsArena *ds_arena_init(const DsAllocator *parent, const size_t block_size) {
+    const DsAllocator local_parent = parent == NULL ? ds_allocator_default() : *parent;
+
+    DsArena *arena = ds_alloc(&local_parent, sizeof(DsArena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->parent = local_parent;
+    arena->block_size = block_size == 0 ? DS_ARENA_BLOCK : block_size;
+    arena->blocks = NULL;
+    arena->current = NULL;
+    arena->cur = NULL;
+    arena->end = NULL;
+    arena->used = 0;
+    return arena;
+}
+
+
+
+DsAllocator ds_arena_allocator(DsArena *arena) {
+    DsAllocator allocator = {
+        .ctx = arena,
+        .alloc = ds_arena_alloc,
+        .realloc = ds_arena_realloc,
+        .free_sized = ds_arena_free_sized,
+        .aligned_alloc = ds_arena_aligned_alloc,
+    };
+    return allocator;
+}
+
+
+
+void ds_arena_reset(DsArena *arena) {
+    // Sanity check
+    if (arena == NULL) {
+        return;
+    }
+
+    DsArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        DsArenaBlock *next = block->next;
+        if (block != arena->current) {
+            ds_free(&arena->parent, block, block->size);
+        }
+        block = next;
+    }
+    arena->blocks = arena->current;
+    if (arena->current != NULL) {
+        arena->current->next = NULL;
+        arena->cur = (char *)(arena->current + 1);
+    }
+    arena->used = 0;
+}
+
+
+
+size_t ds_arena_used(const DsArena *arena) {
+    return arena == NULL ? 0 : arena->used;
+}
+
+
+
+void ds_arena_free(DsArena *arena) {
+    // Sanity check
+    if (arena == NULL) {
+        return;
+    }
+
+    const DsAllocator parent = arena->parent;
+    while (arena->blocks != NULL) {
+        DsArenaBlock *next = arena->blocks->next;
+        ds_free(&parent, arena->blocks, arena->blocks->size);
+        arena->blocks = next;
+    }
+    ds_free(&parent, arena, sizeof(DsArena));
+}
+
+
+
+DsAllocator ds_pool_allocator(void) {
+    DsAllocator allocator = {
+        .ctx = NULL,
+        .alloc = ds_pool_alloc,
+        .realloc = ds_pool_realloc,
+        .free_sized = ds_pool_free_sized,
+        .aligned_alloc = ds_pool_aligned_alloc,
+    };
+    return allocator;
+}
+
+
+
+void ds_pool_trim(void) {
+    DsPoolCache *cache = ds_pool_cache(0);
+    if (cache != NULL) {
+        ds_pool_release(cache);
+    }
+}
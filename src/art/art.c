@@ -0,0 +1,1015 @@
+// Header file
+#include "../../include/art.h"
+#include "../common/alloc_internal.h"
+
+// Libraries
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/********************************** Private ***********************************/
+
+/// This follows "The Adaptive Radix Tree" by Leis et al. Every inner node
+/// consumes its compressed prefix and then one key byte to pick a child:
+///
+///   Node4, Node16   sorted key bytes next to their children, Node16 is
+///                   searched with one SSE2 compare
+///   Node48          a 256 byte index into 48 child slots
+///   Node256         one child slot per byte
+///
+/// Children are inner nodes or leaves, both start with their type byte. A
+/// leaf holds the whole key, so a chain of nodes with a single child is
+/// never built: a leaf hangs right below the last branch on its path.
+///
+/// The prefix of an inner node is the run of bytes that all keys below it
+/// share since the byte that led to it. Only the first ART_MAX_PREFIX bytes
+/// are stored. Lookups skip the rest and compare the whole key at the leaf,
+/// inserts and scans read the missing bytes from any leaf below the node.
+///
+/// Keys may be prefixes of each other, the key that ends at an inner node,
+/// right after its prefix, is kept in the end slot of that node. It is
+/// ordered before all children.
+
+
+/// Prefix bytes that are stored in a node
+#define ART_MAX_PREFIX 8
+
+/// A node shrinks to the next smaller size when it has this few children left
+#define ART_SHRINK_16 3
+#define ART_SHRINK_48 12
+#define ART_SHRINK_256 37
+
+
+enum {
+    ART_LEAF,
+    ART_NODE4,
+    ART_NODE16,
+    ART_NODE48,
+    ART_NODE256,
+};
+
+
+typedef struct {
+    uint8_t type;
+    size_t key_len;
+    /* val_size value bytes, then key_len key bytes */
+} ArtLeaf;
+
+
+/// Header of every inner node
+typedef struct {
+    uint8_t type;
+    uint16_t count; /* Children, the end leaf is not counted */
+    uint32_t prefix_len;
+    unsigned char partial[ART_MAX_PREFIX]; /* First bytes of the prefix */
+    ArtLeaf *end; /* Key that ends after the prefix or NULL */
+} ArtNode;
+
+typedef struct {
+    ArtNode node;
+    unsigned char keys[4];
+    void *children[4];
+} ArtNode4;
+
+typedef struct {
+    ArtNode node;
+    unsigned char keys[16];
+    void *children[16];
+} ArtNode16;
+
+typedef struct {
+    ArtNode node;
+    unsigned char index[256]; /* Slot + 1 of a byte, 0 if it has no child */
+    void *children[48];
+} ArtNode48;
+
+typedef struct {
+    ArtNode node;
+    void *children[256];
+} ArtNode256;
+
+
+/// Stands in for a NULL key of length 0
+static const unsigned char art_empty_key[1];
+
+
+struct art_tree {
+    DsAllocState heap;
+    size_t val_size;
+    size_t size;
+    void *root; /* NULL, a leaf or an inner node */
+};
+
+
+/// Bounds and callback of a scan
+typedef struct {
+    const unsigned char *lo;
+    size_t lo_len;
+    const unsigned char *hi;
+    size_t hi_len;
+    ArtVisitFn visit;
+    void *ctx;
+    size_t count;
+} ArtScan;
+
+
+
+static int art_is_leaf(const void *node) {
+    return *(const uint8_t *)node == ART_LEAF;
+}
+
+static void *art_leaf_value(const ArtLeaf *leaf) {
+    return (unsigned char *)(leaf + 1);
+}
+
+static const unsigned char *art_leaf_key(const ArtTree *tree, const ArtLeaf *leaf) {
+    return (const unsigned char *)(leaf + 1) + tree->val_size;
+}
+
+static int art_leaf_matches(const ArtTree *tree, const ArtLeaf *leaf, const unsigned char *key, const size_t len) {
+    return leaf->key_len == len && memcmp(art_leaf_key(tree, leaf), key, len) == 0;
+}
+
+static size_t art_min(const size_t a, const size_t b) {
+    return a < b ? a : b;
+}
+
+
+
+static size_t art_node_size(const uint8_t type) {
+    switch (type) {
+    case ART_NODE4:
+        return sizeof(ArtNode4);
+    case ART_NODE16:
+        return sizeof(ArtNode16);
+    case ART_NODE48:
+        return sizeof(ArtNode48);
+    default:
+        return sizeof(ArtNode256);
+    }
+}
+
+static ArtNode *art_alloc_node(const ArtTree *tree, const uint8_t type) {
+    const size_t size = art_node_size(type);
+    ArtNode *node = ds_state_alloc(&tree->heap, size);
+    if (node != NULL) {
+        memset(node, 0, size);
+        node->type = type;
+    }
+    return node;
+}
+
+static void art_free_node(const ArtTree *tree, ArtNode *node) {
+    ds_state_free(&tree->heap, node, art_node_size(node->type));
+}
+
+/// Allocate a node of [type] with the header of [node]
+static ArtNode *art_copy_node(const ArtTree *tree, const ArtNode *node, const uint8_t type) {
+    ArtNode *copy = art_alloc_node(tree, type);
+    if (copy != NULL) {
+        copy->count = node->count;
+        copy->prefix_len = node->prefix_len;
+        memcpy(copy->partial, node->partial, ART_MAX_PREFIX);
+        copy->end = node->end;
+    }
+    return copy;
+}
+
+
+
+static ArtLeaf *art_make_leaf(const ArtTree *tree, const unsigned char *key, const size_t len, const void *value) {
+    ArtLeaf *leaf = ds_state_alloc(&tree->heap, sizeof(ArtLeaf) + tree->val_size + len);
+    if (leaf == NULL) {
+        return NULL;
+    }
+    leaf->type = ART_LEAF;
+    leaf->key_len = len;
+    if (value != NULL) {
+        memcpy(art_leaf_value(leaf), value, tree->val_size);
+    } else {
+        memset(art_leaf_value(leaf), 0, tree->val_size);
+    }
+    memcpy((unsigned char *)art_leaf_key(tree, leaf), key, len);
+    return leaf;
+}
+
+static void art_free_leaf(const ArtTree *tree, ArtLeaf *leaf) {
+    ds_state_free(&tree->heap, leaf, sizeof(ArtLeaf) + tree->val_size + leaf->key_len);
+}
+
+
+
+/// Index of the lowest set bit of a non zero mask
+static unsigned art_lowest_bit(const unsigned mask) {
+    assert(mask != 0);
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(mask);
+#else
+    unsigned index = 0;
+    while (!(mask & (1u << index))) {
+        index++;
+    }
+    return index;
+#endif
+}
+
+
+
+/// Get the slot of the child for [byte]
+///
+/// Returns:
+///   a pointer to the slot or NULL if [node] has no child for [byte]
+static void **art_find_child(const ArtNode *node, const unsigned char byte) {
+    switch (node->type) {
+    case ART_NODE4: {
+        ArtNode4 *n = (ArtNode4 *)node;
+        for (unsigned i = 0; i < node->count; ++i) {
+            if (n->keys[i] == byte) {
+                return n->children + i;
+            }
+        }
+        return NULL;
+    }
+    case ART_NODE16: {
+        ArtNode16 *n = (ArtNode16 *)node;
+#if defined(__SSE2__)
+        const __m128i keys = _mm_loadu_si128((const __m128i *)n->keys);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(keys, _mm_set1_epi8((char)byte)));
+        mask &= (1u << node->count) - 1;
+        return mask == 0 ? NULL : n->children + art_lowest_bit(mask);
+#else
+        for (unsigned i = 0; i < node->count; ++i) {
+            if (n->keys[i] == byte) {
+                return n->children + i;
+            }
+        }
+        return NULL;
+#endif
+    }
+    case ART_NODE48: {
+        ArtNode48 *n = (ArtNode48 *)node;
+        return n->index[byte] == 0 ? NULL : n->children + n->index[byte] - 1;
+    }
+    default: {
+        ArtNode256 *n = (ArtNode256 *)node;
+        return n->children[byte] == NULL ? NULL : n->children + byte;
+    }
+    }
+}
+
+
+
+/// Get the first child whose byte is at least [from]
+///
+/// Returns:
+///   the child, its byte is stored in [byte], or NULL if there is none
+static void *art_next_child(const ArtNode *node, const unsigned from, unsigned *byte) {
+    switch (node->type) {
+    case ART_NODE4:
+    case ART_NODE16: {
+        const unsigned char *keys = node->type == ART_NODE4 ? ((const ArtNode4 *)node)->keys :
+                ((const ArtNode16 *)node)->keys;
+        void *const *children = node->type == ART_NODE4 ? ((const ArtNode4 *)node)->children :
+                ((const ArtNode16 *)node)->children;
+        for (unsigned i = 0; i < node->count; ++i) {
+            if (keys[i] >= from) {
+                *byte = keys[i];
+                return children[i];
+            }
+        }
+        return NULL;
+    }
+    case ART_NODE48: {
+        const ArtNode48 *n = (const ArtNode48 *)node;
+        for (unsigned b = from; b < 256; ++b) {
+            if (n->index[b] != 0) {
+                *byte = b;
+                return n->children[n->index[b] - 1];
+            }
+        }
+        return NULL;
+    }
+    default: {
+        const ArtNode256 *n = (const ArtNode256 *)node;
+        for (unsigned b = from; b < 256; ++b) {
+            if (n->children[b] != NULL) {
+                *byte = b;
+                return n->children[b];
+            }
+        }
+        return NULL;
+    }
+    }
+}
+
+
+
+/// Get the smallest leaf below [node]
+static const ArtLeaf *art_minimum(const void *node) {
+    while (!art_is_leaf(node)) {
+        const ArtNode *n = node;
+        if (n->end != NULL) {
+            return n->end;
+        }
+        unsigned byte;
+        node = art_next_child(n, 0, &byte);
+    }
+    return node;
+}
+
+/// Get the whole prefix of [node], which starts at key byte [depth]
+static const unsigned char *art_prefix(const ArtTree *tree, const ArtNode *node, const size_t depth) {
+    if (node->prefix_len <= ART_MAX_PREFIX) {
+        return node->partial;
+    }
+    return art_leaf_key(tree, art_minimum(node)) + depth;
+}
+
+/// Get the amount of bytes that [key] shares with the prefix of [node]
+static size_t art_prefix_mismatch(const ArtTree *tree, const ArtNode *node, const unsigned char *key,
+        const size_t len, const size_t depth) {
+    const size_t max = art_min(node->prefix_len, len - depth);
+    const unsigned char *prefix = art_prefix(tree, node, depth);
+    size_t i = 0;
+    while (i < max && prefix[i] == key[depth + i]) {
+        i++;
+    }
+    return i;
+}
+
+
+
+/// Add [child] for [byte] to the node in [ref], which may be replaced by a
+/// larger one
+///
+/// Returns:
+///   1 on success, 0 if the allocation failed
+static int art_add_child(const ArtTree *tree, void **ref, const unsigned char byte, void *child) {
+    ArtNode *node = *ref;
+    switch (node->type) {
+    case ART_NODE4:
+    case ART_NODE16: {
+        const unsigned capacity = node->type == ART_NODE4 ? 4 : 16;
+        unsigned char *keys = node->type == ART_NODE4 ? ((ArtNode4 *)node)->keys : ((ArtNode16 *)node)->keys;
+        void **children = node->type == ART_NODE4 ? ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        if (node->count < capacity) {
+            // Keep the bytes sorted for scans
+            unsigned pos = 0;
+#if defined(__SSE2__)
+            if (node->type == ART_NODE16) {
+                // Flip the sign bits to compare unsigned bytes
+                const __m128i flip = _mm_set1_epi8((char)0x80);
+                const __m128i greater = _mm_cmplt_epi8(_mm_xor_si128(_mm_set1_epi8((char)byte), flip),
+                        _mm_xor_si128(_mm_loadu_si128((const __m128i *)keys), flip));
+                const unsigned mask = (unsigned)_mm_movemask_epi8(greater) & ((1u << node->count) - 1);
+                pos = mask == 0 ? node->count : art_lowest_bit(mask);
+            } else
+#endif
+            {
+                while (pos < node->count && keys[pos] < byte) {
+                    pos++;
+                }
+            }
+            memmove(keys + pos + 1, keys + pos, node->count - pos);
+            memmove(children + pos + 1, children + pos, (node->count - pos) * sizeof(void *));
+            keys[pos] = byte;
+            children[pos] = child;
+            node->count++;
+            return 1;
+        }
+
+        // Full, grow to the next size
+        ArtNode *grown = art_copy_node(tree, node, node->type == ART_NODE4 ? ART_NODE16 : ART_NODE48);
+        if (grown == NULL) {
+            return 0;
+        }
+        if (grown->type == ART_NODE16) {
+            memcpy(((ArtNode16 *)grown)->keys, keys, 4);
+            memcpy(((ArtNode16 *)grown)->children, children, 4 * sizeof(void *));
+        } else {
+            ArtNode48 *n = (ArtNode48 *)grown;
+            for (unsigned i = 0; i < 16; ++i) {
+                n->index[keys[i]] = (unsigned char)(i + 1);
+                n->children[i] = children[i];
+            }
+        }
+        art_free_node(tree, node);
+        *ref = grown;
+        return art_add_child(tree, ref, byte, child);
+    }
+    case ART_NODE48: {
+        ArtNode48 *n = (ArtNode48 *)node;
+        if (node->count < 48) {
+            // Deletions leave holes, so look for a free slot
+            unsigned slot = 0;
+            while (n->children[slot] != NULL) {
+                slot++;
+            }
+            n->index[byte] = (unsigned char)(slot + 1);
+            n->children[slot] = child;
+            node->count++;
+            return 1;
+        }
+
+        ArtNode256 *grown = (ArtNode256 *)art_copy_node(tree, node, ART_NODE256);
+        if (grown == NULL) {
+            return 0;
+        }
+        for (unsigned b = 0; b < 256; ++b) {
+            if (n->index[b] != 0) {
+                grown->children[b] = n->children[n->index[b] - 1];
+            }
+        }
+        art_free_node(tree, node);
+        *ref = grown;
+        return art_add_child(tree, ref, byte, child);
+    }
+    default: {
+        ArtNode256 *n = (ArtNode256 *)node;
+        n->children[byte] = child;
+        node->count++;
+        return 1;
+    }
+    }
+}
+
+
+
+/// Replace the node in [ref] by a smaller one if it has few children left.
+/// If that allocation fails the node is kept as it is.
+static void art_shrink(const ArtTree *tree, void **ref) {
+    ArtNode *node = *ref;
+    if (node->type == ART_NODE16 && node->count <= ART_SHRINK_16) {
+        ArtNode4 *small = (ArtNode4 *)art_copy_node(tree, node, ART_NODE4);
+        if (small == NULL) {
+            return;
+        }
+        memcpy(small->keys, ((ArtNode16 *)node)->keys, node->count);
+        memcpy(small->children, ((ArtNode16 *)node)->children, node->count * sizeof(void *));
+        art_free_node(tree, node);
+        *ref = small;
+    } else if (node->type == ART_NODE48 && node->count <= ART_SHRINK_48) {
+        ArtNode16 *small = (ArtNode16 *)art_copy_node(tree, node, ART_NODE16);
+        if (small == NULL) {
+            return;
+        }
+        const ArtNode48 *n = (const ArtNode48 *)node;
+        unsigned pos = 0;
+        for (unsigned b = 0; b < 256; ++b) {
+            if (n->index[b] != 0) {
+                small->keys[pos] = (unsigned char)b;
+                small->children[pos++] = n->children[n->index[b] - 1];
+            }
+        }
+        art_free_node(tree, node);
+        *ref = small;
+    } else if (node->type == ART_NODE256 && node->count <= ART_SHRINK_256) {
+        ArtNode48 *small = (ArtNode48 *)art_copy_node(tree, node, ART_NODE48);
+        if (small == NULL) {
+            return;
+        }
+        const ArtNode256 *n = (const ArtNode256 *)node;
+        unsigned slot = 0;
+        for (unsigned b = 0; b < 256; ++b) {
+            if (n->children[b] != NULL) {
+                small->index[b] = (unsigned char)(slot + 1);
+                small->children[slot++] = n->children[b];
+            }
+        }
+        art_free_node(tree, node);
+        *ref = small;
+    }
+}
+
+
+
+/// Replace the node in [ref] by the only child or end leaf it has left
+static void art_collapse(const ArtTree *tree, void **ref) {
+    ArtNode *node = *ref;
+    if (node->count + (node->end != NULL) != 1) {
+        return;
+    }
+    if (node->count == 0) {
+        *ref = node->end;
+        art_free_node(tree, node);
+        return;
+    }
+
+    unsigned byte;
+    void *child = art_next_child(node, 0, &byte);
+    if (!art_is_leaf(child)) {
+        // The child's prefix becomes this prefix, the byte and its own prefix
+        ArtNode *inner = child;
+        unsigned char partial[ART_MAX_PREFIX];
+        size_t len = art_min(node->prefix_len, ART_MAX_PREFIX);
+        memcpy(partial, node->partial, len);
+        if (len < ART_MAX_PREFIX) {
+            partial[len++] = (unsigned char)byte;
+        }
+        for (size_t i = 0; len < ART_MAX_PREFIX && i < art_min(inner->prefix_len, ART_MAX_PREFIX); ++i) {
+            partial[len++] = inner->partial[i];
+        }
+        memcpy(inner->partial, partial, len);
+        inner->prefix_len += node->prefix_len + 1;
+    }
+    *ref = child;
+    art_free_node(tree, node);
+}
+
+
+
+/// Remove the child in [slot] of the node in [ref]
+static void art_remove_child(const ArtTree *tree, void **ref, const unsigned char byte, void **slot) {
+    ArtNode *node = *ref;
+    switch (node->type) {
+    case ART_NODE4:
+    case ART_NODE16: {
+        unsigned char *keys = node->type == ART_NODE4 ? ((ArtNode4 *)node)->keys : ((ArtNode16 *)node)->keys;
+        void **children = node->type == ART_NODE4 ? ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        const size_t pos = (size_t)(slot - children);
+        memmove(keys + pos, keys + pos + 1, node->count - pos - 1);
+        memmove(children + pos, children + pos + 1, (node->count - pos - 1) * sizeof(void *));
+        break;
+    }
+    case ART_NODE48: {
+        ArtNode48 *n = (ArtNode48 *)node;
+        n->children[n->index[byte] - 1] = NULL;
+        n->index[byte] = 0;
+        break;
+    }
+    default:
+        ((ArtNode256 *)node)->children[byte] = NULL;
+        break;
+    }
+    node->count--;
+    art_shrink(tree, ref);
+    art_collapse(tree, ref);
+}
+
+
+
+/// Insert below the node in [ref], which is reached after [depth] key bytes
+static void *art_insert_at(ArtTree *tree, void **ref, const unsigned char *key, const size_t len, size_t depth,
+        const void *value) {
+    if (*ref == NULL) {
+        ArtLeaf *leaf = art_make_leaf(tree, key, len, value);
+        if (leaf == NULL) {
+            return NULL;
+        }
+        *ref = leaf;
+        tree->size++;
+        return art_leaf_value(leaf);
+    }
+
+    if (art_is_leaf(*ref)) {
+        ArtLeaf *old = *ref;
+        if (art_leaf_matches(tree, old, key, len)) {
+            if (value != NULL) {
+                memcpy(art_leaf_value(old), value, tree->val_size);
+            }
+            return art_leaf_value(old);
+        }
+
+        // Split the leaf into a node for the bytes both keys share
+        const unsigned char *old_key = art_leaf_key(tree, old);
+        const size_t max = art_min(len, old->key_len);
+        size_t shared = depth;
+        while (shared < max && key[shared] == old_key[shared]) {
+            shared++;
+        }
+        ArtNode *node = art_alloc_node(tree, ART_NODE4);
+        ArtLeaf *leaf = art_make_leaf(tree, key, len, value);
+        if (node == NULL || leaf == NULL) {
+            ds_state_free(&tree->heap, node, sizeof(ArtNode4));
+            ds_state_free(&tree->heap, leaf, sizeof(ArtLeaf) + tree->val_size + len);
+            return NULL;
+        }
+        node->prefix_len = (uint32_t)(shared - depth);
+        memcpy(node->partial, key + depth, art_min(node->prefix_len, ART_MAX_PREFIX));
+
+        // A Node4 with room does not grow
+        void *ref_node = node;
+        if (old->key_len == shared) {
+            node->end = old;
+        } else {
+            art_add_child(tree, &ref_node, old_key[shared], old);
+        }
+        if (len == shared) {
+            node->end = leaf;
+        } else {
+            art_add_child(tree, &ref_node, key[shared], leaf);
+        }
+        *ref = node;
+        tree->size++;
+        return art_leaf_value(leaf);
+    }
+
+    ArtNode *node = *ref;
+    if (node->prefix_len != 0) {
+        const size_t shared = art_prefix_mismatch(tree, node, key, len, depth);
+        if (shared < node->prefix_len) {
+            // The key leaves the prefix, split it at the first other byte
+            ArtNode *split = art_alloc_node(tree, ART_NODE4);
+            ArtLeaf *leaf = art_make_leaf(tree, key, len, value);
+            if (split == NULL || leaf == NULL) {
+                ds_state_free(&tree->heap, split, sizeof(ArtNode4));
+                ds_state_free(&tree->heap, leaf, sizeof(ArtLeaf) + tree->val_size + len);
+                return NULL;
+            }
+            const unsigned char *prefix = art_prefix(tree, node, depth);
+            const unsigned char byte = prefix[shared];
+            split->prefix_len = (uint32_t)shared;
+            memcpy(split->partial, prefix, art_min(shared, ART_MAX_PREFIX));
+            node->prefix_len -= (uint32_t)(shared + 1);
+            memmove(node->partial, prefix + shared + 1, art_min(node->prefix_len, ART_MAX_PREFIX));
+
+            void *ref_split = split;
+            art_add_child(tree, &ref_split, byte, node);
+            if (len == depth + shared) {
+                split->end = leaf;
+            } else {
+                art_add_child(tree, &ref_split, key[depth + shared], leaf);
+            }
+            *ref = split;
+            tree->size++;
+            return art_leaf_value(leaf);
+        }
+        depth += node->prefix_len;
+    }
+
+    // The key ends at this node
+    if (depth == len) {
+        if (node->end != NULL) {
+            if (value != NULL) {
+                memcpy(art_leaf_value(node->end), value, tree->val_size);
+            }
+            return art_leaf_value(node->end);
+        }
+        node->end = art_make_leaf(tree, key, len, value);
+        if (node->end == NULL) {
+            return NULL;
+        }
+        tree->size++;
+        return art_leaf_value(node->end);
+    }
+
+    void **slot = art_find_child(node, key[depth]);
+    if (slot != NULL) {
+        return art_insert_at(tree, slot, key, len, depth + 1, value);
+    }
+    ArtLeaf *leaf = art_make_leaf(tree, key, len, value);
+    if (leaf == NULL) {
+        return NULL;
+    }
+    if (!art_add_child(tree, ref, key[depth], leaf)) {
+        art_free_leaf(tree, leaf);
+        return NULL;
+    }
+    tree->size++;
+    return art_leaf_value(leaf);
+}
+
+
+
+/// Check the stored bytes of the prefix of [node], the rest is checked at
+/// the leaf
+static int art_check_prefix(const ArtNode *node, const unsigned char *key, const size_t len, const size_t depth) {
+    return len - depth >= node->prefix_len &&
+            memcmp(node->partial, key + depth, art_min(node->prefix_len, ART_MAX_PREFIX)) == 0;
+}
+
+
+
+/// Delete below the node in [ref], which is reached after [depth] key bytes
+static int art_delete_at(ArtTree *tree, void **ref, const unsigned char *key, const size_t len, size_t depth) {
+    ArtNode *node = *ref;
+    if (!art_check_prefix(node, key, len, depth)) {
+        return 0;
+    }
+    depth += node->prefix_len;
+
+    if (depth == len) {
+        ArtLeaf *leaf = node->end;
+        if (leaf == NULL || !art_leaf_matches(tree, leaf, key, len)) {
+            return 0;
+        }
+        node->end = NULL;
+        art_free_leaf(tree, leaf);
+        art_collapse(tree, ref);
+        return 1;
+    }
+
+    void **slot = art_find_child(node, key[depth]);
+    if (slot == NULL) {
+        return 0;
+    }
+    if (!art_is_leaf(*slot)) {
+        return art_delete_at(tree, slot, key, len, depth + 1);
+    }
+    ArtLeaf *leaf = *slot;
+    if (!art_leaf_matches(tree, leaf, key, len)) {
+        return 0;
+    }
+    art_remove_child(tree, ref, key[depth], slot);
+    art_free_leaf(tree, leaf);
+    return 1;
+}
+
+
+
+/// Visit [leaf] if it lies inside the bounds that are not NULL
+///
+/// Returns:
+///   1 to stop the scan, 0 to continue
+static int art_scan_leaf(const ArtTree *tree, ArtScan *scan, const ArtLeaf *leaf, const unsigned char *lo,
+        const unsigned char *hi) {
+    const unsigned char *key = art_leaf_key(tree, leaf);
+    if (lo != NULL) {
+        const int cmp = memcmp(key, lo, art_min(leaf->key_len, scan->lo_len));
+        if (cmp < 0 || (cmp == 0 && leaf->key_len < scan->lo_len)) {
+            return 0;
+        }
+    }
+    if (hi != NULL) {
+        const int cmp = memcmp(key, hi, art_min(leaf->key_len, scan->hi_len));
+        if (cmp > 0 || (cmp == 0 && leaf->key_len >= scan->hi_len)) {
+            return 1;
+        }
+    }
+    scan->count++;
+    return scan->visit != NULL && scan->visit(key, leaf->key_len, art_leaf_value(leaf), scan->ctx);
+}
+
+
+
+/// Walk [node] in order and visit the keys that lie inside the bounds of
+/// [scan]. The path to [node] is [depth] bytes long, a bound that is NULL
+/// no longer limits the keys below it.
+///
+/// Returns:
+///   1 to stop the scan, 0 to continue
+static int art_walk(const ArtTree *tree, ArtScan *scan, const void *node, size_t depth, const unsigned char *lo,
+        const unsigned char *hi) {
+    if (art_is_leaf(node)) {
+        return art_scan_leaf(tree, scan, node, lo, hi);
+    }
+    const ArtNode *n = node;
+
+    // Compare the prefix with the bounds that are still on
+    if (n->prefix_len != 0 && (lo != NULL || hi != NULL)) {
+        const unsigned char *prefix = art_prefix(tree, n, depth);
+        for (size_t i = 0; i < n->prefix_len && (lo != NULL || hi != NULL); ++i) {
+            const size_t pos = depth + i;
+            if (lo != NULL) {
+                if (pos >= scan->lo_len || prefix[i] > lo[pos]) {
+                    // Every key below is greater than lo
+                    lo = NULL;
+                } else if (prefix[i] < lo[pos]) {
+                    return 0;
+                }
+            }
+            if (hi != NULL) {
+                if (pos >= scan->hi_len || prefix[i] > hi[pos]) {
+                    // Every key below is at least hi
+                    return 1;
+                }
+                if (prefix[i] < hi[pos]) {
+                    hi = NULL;
+                }
+            }
+        }
+    }
+    depth += n->prefix_len;
+
+    if (n->end != NULL && art_scan_leaf(tree, scan, n->end, lo, hi)) {
+        return 1;
+    }
+    if (lo != NULL && depth >= scan->lo_len) {
+        lo = NULL;
+    }
+    if (hi != NULL && depth >= scan->hi_len) {
+        return 1;
+    }
+
+    // Start at the byte of lo, stop after the byte of hi
+    unsigned byte;
+    const void *child = art_next_child(n, lo != NULL ? lo[depth] : 0, &byte);
+    while (child != NULL) {
+        if (hi != NULL && byte > hi[depth]) {
+            return 1;
+        }
+        const unsigned char *child_lo = lo != NULL && byte == lo[depth] ? lo : NULL;
+        const unsigned char *child_hi = hi != NULL && byte == hi[depth] ? hi : NULL;
+        if (art_walk(tree, scan, child, depth + 1, child_lo, child_hi)) {
+            return 1;
+        }
+        if (byte == 255) {
+            break;
+        }
+        child = art_next_child(n, byte + 1, &byte);
+    }
+    return 0;
+}
+
+
+
+/// Free [node] and everything below it
+static void art_free_all(const ArtTree *tree, void *node) {
+    if (art_is_leaf(node)) {
+        art_free_leaf(tree, node);
+        return;
+    }
+    ArtNode *n = node;
+    if (n->end != NULL) {
+        art_free_leaf(tree, n->end);
+    }
+    unsigned byte;
+    void *child = art_next_child(n, 0, &byte);
+    while (child != NULL) {
+        art_free_all(tree, child);
+        if (byte == 255) {
+            break;
+        }
+        child = art_next_child(n, byte + 1, &byte);
+    }
+    art_free_node(tree, n);
+}
+
+
+
+/// Shared by both initializers
+static ArtTree *art_create(const DsAllocState *heap, const size_t val_size) {
+    ArtTree *tree = ds_state_alloc(heap, sizeof(ArtTree));
+    if (tree == NULL) {
+        return NULL;
+    }
+    tree->heap = *heap;
+    tree->val_size = val_size;
+    tree->size = 0;
+    tree->root = NULL;
+    return tree;
+}
+
+
+
+/********************************** Public ************************************/
+
+ArtTree *art_init(const ArtAllocFn alloc, const ArtFreeFn dealloc, const size_t val_size) {
+    DsAllocState heap;
+    ds_alloc_state_fns(&heap, alloc, dealloc);
+    return art_create(&heap, val_size);
+}
+
+
+
+ArtTree *art_init_alloc(const DsAllocator *allocator, const size_t val_size) {
+    DsAllocState heap;
+    ds_alloc_state_init(&heap, allocator);
+    return art_create(&heap, val_size);
+}
+
+
+
+void *art_insert(ArtTree *tree, const void *key, const size_t key_len, const void *value) {
+    // Sanity check
+    if (tree == NULL || (key == NULL && key_len != 0) || key_len >= UINT32_MAX) {
+        return NULL;
+    }
+    return art_insert_at(tree, &tree->root, key == NULL ? art_empty_key : key, key_len, 0, value);
+}
+
+
+
+void *art_lookup(const ArtTree *tree, const void *key, const size_t key_len) {
+    // Sanity check
+    if (tree == NULL || (key == NULL && key_len != 0)) {
+        return NULL;
+    }
+
+    const unsigned char *bytes = key == NULL ? art_empty_key : key;
+    const void *node = tree->root;
+    size_t depth = 0;
+    while (node != NULL) {
+        if (art_is_leaf(node)) {
+            return art_leaf_matches(tree, node, bytes, key_len) ? art_leaf_value(node) : NULL;
+        }
+        const ArtNode *n = node;
+        if (n->prefix_len != 0) {
+            if (!art_check_prefix(n, bytes, key_len, depth)) {
+                return NULL;
+            }
+            depth += n->prefix_len;
+        }
+        if (depth == key_len) {
+            return n->end != NULL && art_leaf_matches(tree, n->end, bytes, key_len) ? art_leaf_value(n->end) : NULL;
+        }
+        void **slot = art_find_child(n, bytes[depth++]);
+        node = slot == NULL ? NULL : *slot;
+    }
+    return NULL;
+}
+
+
+
+int art_delete(ArtTree *tree, const void *key, const size_t key_len) {
+    // Sanity check
+    if (tree == NULL || tree->root == NULL || (key == NULL && key_len != 0)) {
+        return 0;
+    }
+
+    const unsigned char *bytes = key == NULL ? art_empty_key : key;
+    int deleted;
+    if (art_is_leaf(tree->root)) {
+        ArtLeaf *leaf = tree->root;
+        deleted = art_leaf_matches(tree, leaf, bytes, key_len);
+        if (deleted) {
+            art_free_leaf(tree, leaf);
+            tree->root = NULL;
+        }
+    } else {
+        deleted = art_delete_at(tree, &tree->root, bytes, key_len, 0);
+    }
+    tree->size -= (size_t)deleted;
+    return deleted;
+}
+
+
+
+size_t art_prefix_scan(const ArtTree *tree, const void *prefix, const size_t prefix_len, const ArtVisitFn visit,
+        void *ctx) {
+    // Sanity check
+    if (tree == NULL || (prefix == NULL && prefix_len != 0)) {
+        return 0;
+    }
+
+    // Find the subtree of the prefix
+    const unsigned char *bytes = prefix == NULL ? art_empty_key : prefix;
+    const void *node = tree->root;
+    size_t depth = 0;
+    while (node != NULL && !art_is_leaf(node) && depth < prefix_len) {
+        const ArtNode *n = node;
+        const size_t max = art_min(n->prefix_len, prefix_len - depth);
+        if (max != 0 && memcmp(art_prefix(tree, n, depth), bytes + depth, max) != 0) {
+            return 0;
+        }
+        depth += n->prefix_len;
+        if (depth >= prefix_len) {
+            break;
+        }
+        void **slot = art_find_child(n, bytes[depth++]);
+        node = slot == NULL ? NULL : *slot;
+    }
+    if (node == NULL) {
+        return 0;
+    }
+
+    // Every key below an inner node starts with the prefix, a leaf has to be checked
+    if (art_is_leaf(node)) {
+        const ArtLeaf *leaf = node;
+        if (leaf->key_len < prefix_len || memcmp(art_leaf_key(tree, leaf), bytes, prefix_len) != 0) {
+            return 0;
+        }
+    }
+    ArtScan scan = {NULL, 0, NULL, 0, visit, ctx, 0};
+    art_walk(tree, &scan, node, depth, NULL, NULL);
+    return scan.count;
+}
+
+
+
+size_t art_range_scan(const ArtTree *tree, const void *lo, const size_t lo_len, const void *hi, const size_t hi_len,
+        const ArtVisitFn visit, void *ctx) {
+    // Sanity check
+    if (tree == NULL || tree->root == NULL) {
+        return 0;
+    }
+    ArtScan scan = {lo, lo_len, hi, hi_len, visit, ctx, 0};
+    art_walk(tree, &scan, tree->root, 0, scan.lo, scan.hi);
+    return scan.count;
+}
+
+
+
+size_t art_size(const ArtTree *tree) {
+    return tree == NULL ? 0 : tree->size;
+}
+
+
+
+void art_free(ArtTree *tree) {
+    // Sanity check
+    if (tree == NULL) {
+        return;
+    }
+    if (tree->root != NULL) {
+        art_free_all(tree, tree->root);
+    }
+    const DsAllocState heap = tree->heap;
+    ds_state_free(&heap, tree, sizeof(ArtTree));
+}
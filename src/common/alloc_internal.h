@@ -0,0 +1,118 @@
+#ifndef JAZZY_ALLOC_INTERNAL_H
+#define JAZZY_ALLOC_INTERNAL_H
+
+// Header file
+#include "../../include/alloc.h"
+#include "stats_internal.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Allocator of a container. Containers are either initialized with a pair
+/// of plain alloc and free functions or with a DsAllocator. The plain pair is
+/// called directly, so the containers that use it do not pay for the context
+/// and the size that the functions do not take.
+typedef struct {
+    void *(*alloc)(size_t); /* NULL if allocator is used */
+    void (*dealloc)(void *);
+    DsAllocator allocator;
+#if defined(DS_STATS)
+    uint64_t stat_allocs;
+    uint64_t stat_alloc_bytes;
+    uint64_t stat_frees;
+    uint64_t stat_free_bytes;
+#endif
+} DsAllocState;
+
+
+
+/// Use plain functions, malloc and free if one of them is NULL
+static inline void ds_alloc_state_fns(DsAllocState *state, void *(*alloc)(size_t), void (*dealloc)(void *)) {
+    if (alloc == NULL || dealloc == NULL) {
+        alloc = malloc;
+        dealloc = free;
+    }
+    memset(state, 0, sizeof(*state));
+    state->alloc = alloc;
+    state->dealloc = dealloc;
+}
+
+/// Use [allocator], malloc and free if it is NULL
+static inline void ds_alloc_state_init(DsAllocState *state, const DsAllocator *allocator) {
+    if (allocator == NULL) {
+        ds_alloc_state_fns(state, malloc, free);
+        return;
+    }
+    memset(state, 0, sizeof(*state));
+    state->allocator = *allocator;
+}
+
+/// Fill [stats] with the counters of [state]
+static inline void ds_alloc_state_stats(const DsAllocState *state, DsAllocStats *stats) {
+#if defined(DS_STATS)
+    stats->allocs = state->stat_allocs;
+    stats->alloc_bytes = state->stat_alloc_bytes;
+    stats->frees = state->stat_frees;
+    stats->live_bytes = state->stat_alloc_bytes - state->stat_free_bytes;
+#else
+    (void)state;
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+
+
+static inline void *ds_state_alloc(const DsAllocState *state, const size_t size) {
+    void *ptr = state->alloc != NULL ? state->alloc(size) : state->allocator.alloc(state->allocator.ctx, size);
+    if (ptr != NULL) {
+        DS_STAT_ADD(state->stat_allocs, 1);
+        DS_STAT_ADD(state->stat_alloc_bytes, size);
+    }
+    return ptr;
+}
+
+static inline void ds_state_free(const DsAllocState *state, void *ptr, const size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    DS_STAT_ADD(state->stat_frees, 1);
+    DS_STAT_ADD(state->stat_free_bytes, size);
+    if (state->alloc != NULL) {
+        state->dealloc(ptr);
+        return;
+    }
+    state->allocator.free_sized(state->allocator.ctx, ptr, size);
+}
+
+/// Resize a block. On failure NULL is returned and [ptr] is still valid.
+static inline void *ds_state_realloc(const DsAllocState *state, void *ptr, const size_t old_size,
+        const size_t new_size) {
+    void *new_ptr;
+    if (state->alloc == NULL) {
+        new_ptr = ds_realloc(&state->allocator, ptr, old_size, new_size);
+    } else if (state->alloc == malloc && state->dealloc == free) {
+        new_ptr = realloc(ptr, new_size);
+    } else {
+        new_ptr = state->alloc(new_size);
+        if (new_ptr != NULL && ptr != NULL) {
+            memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+            state->dealloc(ptr);
+        }
+    }
+
+    // Counted as a new block and the release of the old one
+    if (new_ptr != NULL) {
+        DS_STAT_ADD(state->stat_allocs, 1);
+        DS_STAT_ADD(state->stat_alloc_bytes, new_size);
+        if (ptr != NULL) {
+            DS_STAT_ADD(state->stat_frees, 1);
+            DS_STAT_ADD(state->stat_free_bytes, old_size);
+        }
+    }
+    return new_ptr;
+}
+
+#endif // JAZZY_ALLOC_INTERNAL_H
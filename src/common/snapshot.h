@@ -0,0 +1,131 @@
+#ifndef JAZZY_SNAPSHOT_H
+#define JAZZY_SNAPSHOT_H
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/// On-disk format shared by the snapshot functions of all containers.
+///
+/// A snapshot is a DsSnapshotHeader followed by [count] elements of
+/// [elem_size] bytes. Everything is written in native byte order. The header
+/// is 64 bytes, so the elements of an mmapped file start on a cache line.
+
+
+#define DS_SNAPSHOT_VERSION 1
+
+#define DS_SNAPSHOT_MAGIC_VECTOR "JZVECTOR"
+#define DS_SNAPSHOT_MAGIC_TREE "JZTREE\0\0"
+#define DS_SNAPSHOT_MAGIC_STATIC_MAP "JZSTATIC"
+
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t elem_size;
+    uint64_t key_size; /* Only used by trees and maps */
+    uint64_t val_size; /* Only used by trees and maps */
+    uint64_t count;
+    uint64_t checksum; /* Over the element bytes */
+    uint64_t point_size; /* Only used by interval trees */
+} DsSnapshotHeader;
+
+
+
+/// Incremental checksum over a stream of bytes
+///
+/// The bytes are consumed 8 at a time, so the result does not depend on how
+/// the stream is split into calls of `ds_checksum_update`.
+typedef struct {
+    uint64_t state;
+    uint64_t pending;
+    size_t pending_len;
+    uint64_t total_len;
+} DsChecksum;
+
+
+#define DS_CHECKSUM_SEED 0x9E3779B97F4A7C15ull
+#define DS_CHECKSUM_MUL 0xFF51AFD7ED558CCDull
+
+
+static inline uint64_t ds_checksum_mix(uint64_t state, const uint64_t word) {
+    state ^= word;
+    state *= DS_CHECKSUM_MUL;
+    return state ^ (state >> 29);
+}
+
+static inline void ds_checksum_init(DsChecksum *sum) {
+    sum->state = DS_CHECKSUM_SEED;
+    sum->pending = 0;
+    sum->pending_len = 0;
+    sum->total_len = 0;
+}
+
+static inline void ds_checksum_update(DsChecksum *sum, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    sum->total_len += len;
+
+    // Top up a partial word first
+    while (sum->pending_len != 0 && len != 0) {
+        sum->pending |= (uint64_t)*bytes << (8 * sum->pending_len);
+        bytes++;
+        len--;
+        if (++sum->pending_len == sizeof(uint64_t)) {
+            sum->state = ds_checksum_mix(sum->state, sum->pending);
+            sum->pending = 0;
+            sum->pending_len = 0;
+        }
+    }
+
+    // Whole words
+    uint64_t word;
+    while (len >= sizeof(word)) {
+        memcpy(&word, bytes, sizeof(word));
+        sum->state = ds_checksum_mix(sum->state, word);
+        bytes += sizeof(word);
+        len -= sizeof(word);
+    }
+
+    // Keep the rest for later
+    while (len != 0) {
+        sum->pending |= (uint64_t)*bytes << (8 * sum->pending_len);
+        sum->pending_len++;
+        bytes++;
+        len--;
+    }
+}
+
+static inline uint64_t ds_checksum_final(const DsChecksum *sum) {
+    uint64_t state = sum->state;
+    if (sum->pending_len != 0) {
+        state = ds_checksum_mix(state, sum->pending);
+    }
+    return ds_checksum_mix(state, sum->total_len);
+}
+
+
+
+/// Fill in a header for [count] elements
+static inline void ds_snapshot_header_init(DsSnapshotHeader *header, const char *magic,
+        const uint64_t elem_size, const uint64_t key_size, const uint64_t val_size, const uint64_t count) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, magic, sizeof(header->magic));
+    header->version = DS_SNAPSHOT_VERSION;
+    header->header_size = sizeof(DsSnapshotHeader);
+    header->elem_size = elem_size;
+    header->key_size = key_size;
+    header->val_size = val_size;
+    header->count = count;
+}
+
+/// Check that [header] is a header this version can read
+static inline int ds_snapshot_header_ok(const DsSnapshotHeader *header, const char *magic) {
+    return memcmp(header->magic, magic, sizeof(header->magic)) == 0 &&
+        header->version == DS_SNAPSHOT_VERSION &&
+        header->header_size == sizeof(DsSnapshotHeader);
+}
+
+#endif
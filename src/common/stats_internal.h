@@ -0,0 +1,61 @@
+#ifndef JAZZY_STATS_INTERNAL_H
+#define JAZZY_STATS_INTERNAL_H
+
+// Libraries
+#include <stdint.h>
+
+
+/// Counters of the DS_STATS build mode.
+///
+/// Counter fields of the containers only exist if DS_STATS is defined, and
+/// without it these macros expand to nothing, so their arguments are not even
+/// evaluated. Counters are plain uint64_t fields. They are also bumped by
+/// functions that take a const container, which is why the macros cast the
+/// qualifier away. Counters that are bumped on a read path, which several
+/// threads may run at once under a shared lock, use the _SHARED variants.
+/// They are relaxed atomics, so the totals are exact but not ordered with
+/// anything else.
+
+
+#if defined(DS_STATS)
+
+static inline void ds_stat_max(uint64_t *counter, const uint64_t value) {
+    if (*counter < value) {
+        *counter = value;
+    }
+}
+
+static inline void ds_stat_add_shared(uint64_t *counter, const uint64_t n) {
+#if defined(__GNUC__)
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+#else
+    *counter += n;
+#endif
+}
+
+static inline void ds_stat_max_shared(uint64_t *counter, const uint64_t value) {
+#if defined(__GNUC__)
+    uint64_t current = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    while (current < value &&
+            !__atomic_compare_exchange_n(counter, &current, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+#else
+    ds_stat_max(counter, value);
+#endif
+}
+
+#define DS_STAT_ADD(counter, n) ((void)(*(uint64_t *)&(counter) += (uint64_t)(n)))
+#define DS_STAT_MAX(counter, value) ds_stat_max((uint64_t *)&(counter), (uint64_t)(value))
+#define DS_STAT_ADD_SHARED(counter, n) ds_stat_add_shared((uint64_t *)&(counter), (uint64_t)(n))
+#define DS_STAT_MAX_SHARED(counter, value) ds_stat_max_shared((uint64_t *)&(counter), (uint64_t)(value))
+
+#else
+
+#define DS_STAT_ADD(counter, n) ((void)0)
+#define DS_STAT_MAX(counter, value) ((void)0)
+#define DS_STAT_ADD_SHARED(counter, n) ((void)0)
+#define DS_STAT_MAX_SHARED(counter, value) ((void)0)
+
+#endif
+
+#endif // JAZZY_STATS_INTERNAL_H
@@ -0,0 +1,31 @@
+#ifndef JAZZY_TRACE_INTERNAL_H
+#define JAZZY_TRACE_INTERNAL_H
+
+// Libraries
+#include "../../include/trace.h"
+
+
+/// Recording of the DS_TRACE build mode.
+///
+/// The trace field of the containers only exists if DS_TRACE is defined, and
+/// without it this macro expands to nothing, so the key is not even reduced.
+/// With it, a container without an attached trace pays one branch per
+/// operation.
+
+
+#if defined(DS_TRACE)
+
+#define DS_TRACE_RECORD(trace, source, op, key, size) \
+    do { \
+        if ((trace) != NULL) { \
+            ds_trace_record((trace), (source), (op), (key), (size)); \
+        } \
+    } while (0)
+
+#else
+
+#define DS_TRACE_RECORD(trace, source, op, key, size) ((void)0)
+
+#endif
+
+#endif // JAZZY_TRACE_INTERNAL_H
@@ -0,0 +1,519 @@
+// Header file
+#include "../../include/filter.h"
+#include "../../include/hash.h"
+
+// Libraries
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/********************************** Private ***********************************/
+
+/// Both filters hash every key once with their own seed. The Bloom filter
+/// picks the block with the high half of the hash and the bits inside the
+/// block with the low half. The cuckoo filter picks the first bucket with
+/// the low bits and takes the fingerprint from the top 16 bits.
+
+
+/// Filter memory is aligned to this so a block or bucket pair never
+/// straddles two cache lines more than it has to
+#define FILTER_LINE_SIZE 64
+
+/// Keys of a batch that are hashed and prefetched before they are tested
+#define FILTER_BATCH 16
+
+/// 64 bit words of a Bloom block, one cache line
+#define BLOOM_BLOCK_WORDS 8
+
+/// Fingerprints per cuckoo bucket, each bucket is one uint64_t
+#define CUCKOO_BUCKET_SLOTS 4
+
+/// Evictions before an insertion gives up and parks the fingerprint
+#define CUCKOO_MAX_KICKS 500
+
+/// Every 16 bit lane of a cuckoo bucket
+#define CUCKOO_LANES_LOW 0x0001000100010001ULL
+#define CUCKOO_LANES_HIGH 0x8000800080008000ULL
+
+
+/// Odd multipliers that spread the low half of the hash to one bit per word
+static const uint32_t bloom_salt[BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+
+struct bloom_filter {
+    FilterFreeFn dealloc; /* Nonnull */
+    uint64_t seed;
+    size_t blocks; /* At least 1 */
+    void *raw; /* Allocation that bits points into */
+    uint64_t *bits; /* blocks * BLOOM_BLOCK_WORDS words, aligned to FILTER_LINE_SIZE */
+};
+
+
+struct cuckoo_filter {
+    FilterFreeFn dealloc; /* Nonnull */
+    uint64_t seed;
+    size_t mask; /* Bucket count - 1, the count is a power of 2 */
+    size_t size;
+    uint64_t rng; /* State of the xorshift generator that picks victims */
+    uint16_t victim; /* Fingerprint that did not fit, 0 if there is none */
+    size_t victim_bucket;
+    void *raw; /* Allocation that buckets points into */
+    uint64_t *buckets; /* Aligned to FILTER_LINE_SIZE */
+};
+
+
+
+/// Allocate [bytes] aligned to FILTER_LINE_SIZE and zeroed
+///
+/// Returns:
+///   The aligned pointer, [raw] receives the pointer to free
+static uint64_t *filter_alloc_lines(const FilterAllocFn alloc, const size_t bytes, void **raw) {
+    // Slack for alignment
+    *raw = alloc(bytes + FILTER_LINE_SIZE - 1);
+    if (*raw == NULL) {
+        return NULL;
+    }
+    const uintptr_t aligned = ((uintptr_t)*raw + FILTER_LINE_SIZE - 1) & ~(uintptr_t)(FILTER_LINE_SIZE - 1);
+    memset((void *)aligned, 0, bytes);
+    return (uint64_t *)aligned;
+}
+
+
+
+static void filter_prefetch(const void *address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+
+
+/// Block of the Bloom filter a hash belongs to
+static uint64_t *bloom_block(const BloomFilter *filter, const uint64_t hash) {
+    // Multiply and shift instead of a modulo, blocks is far below 2^32
+    const size_t index = (size_t)(((hash >> 32) * (uint64_t)filter->blocks) >> 32);
+    return filter->bits + index * BLOOM_BLOCK_WORDS;
+}
+
+
+
+/// Set one bit per word of [mask] picked by the low half of [hash]
+static void bloom_mask(const uint64_t hash, uint64_t mask[BLOOM_BLOCK_WORDS]) {
+    const uint32_t low = (uint32_t)hash;
+    for (size_t i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+        mask[i] = (uint64_t)1 << ((uint32_t)(low * bloom_salt[i]) >> 26);
+    }
+}
+
+
+
+static int bloom_contains_hashed(const BloomFilter *filter, const uint64_t hash) {
+    const uint64_t *block = bloom_block(filter, hash);
+#if defined(__SSE2__)
+    uint64_t mask[BLOOM_BLOCK_WORDS];
+    bloom_mask(hash, mask);
+
+    // Collect the mask bits that are missing in the block
+    __m128i missing = _mm_setzero_si128();
+    for (size_t i = 0; i < BLOOM_BLOCK_WORDS; i += 2) {
+        const __m128i bits = _mm_load_si128((const __m128i *)(block + i));
+        missing = _mm_or_si128(missing, _mm_andnot_si128(bits, _mm_loadu_si128((const __m128i *)(mask + i))));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xFFFF;
+#else
+    uint64_t mask[BLOOM_BLOCK_WORDS];
+    bloom_mask(hash, mask);
+
+    uint64_t missing = 0;
+    for (size_t i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+        missing |= mask[i] & ~block[i];
+    }
+    return missing == 0;
+#endif
+}
+
+
+
+/// Fingerprint of a hash, never 0 since 0 marks an empty lane
+static uint16_t cuckoo_fingerprint(const uint64_t hash) {
+    const uint16_t fp = (uint16_t)(hash >> 48);
+    return fp == 0 ? 1 : fp;
+}
+
+
+
+/// The other bucket of [fp]. Applying it twice gives back [bucket].
+static size_t cuckoo_alt(const CuckooFilter *filter, const size_t bucket, const uint16_t fp) {
+    return (bucket ^ (size_t)hash_u32(fp, filter->seed)) & filter->mask;
+}
+
+
+
+/// Bit 15 of every lane of [bucket] that holds [fp] is set
+static uint64_t cuckoo_match(const uint64_t bucket, const uint16_t fp) {
+    const uint64_t x = bucket ^ (CUCKOO_LANES_LOW * fp);
+    return (x - CUCKOO_LANES_LOW) & ~x & CUCKOO_LANES_HIGH;
+}
+
+
+
+static uint16_t cuckoo_lane(const uint64_t bucket, const size_t lane) {
+    return (uint16_t)(bucket >> (lane * 16));
+}
+
+
+
+static void cuckoo_set_lane(uint64_t *bucket, const size_t lane, const uint16_t fp) {
+    *bucket = (*bucket & ~((uint64_t)0xFFFF << (lane * 16))) | ((uint64_t)fp << (lane * 16));
+}
+
+
+
+/// Put [fp] into a free lane of [bucket]
+///
+/// Returns:
+///   1 on success, 0 if the bucket is full
+static int cuckoo_insert_bucket(CuckooFilter *filter, const size_t bucket, const uint16_t fp) {
+    uint64_t *word = filter->buckets + bucket;
+    for (size_t lane = 0; lane < CUCKOO_BUCKET_SLOTS; ++lane) {
+        if (cuckoo_lane(*word, lane) == 0) {
+            cuckoo_set_lane(word, lane, fp);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+static uint64_t cuckoo_random(CuckooFilter *filter) {
+    uint64_t x = filter->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    filter->rng = x;
+    return x;
+}
+
+
+
+/// Store [fp] in [bucket] or its alternative, evicting other fingerprints
+///
+/// Returns:
+///   1 if every fingerprint found a lane, 0 if one is left over in the victim
+static int cuckoo_place(CuckooFilter *filter, size_t bucket, uint16_t fp) {
+    const size_t alt = cuckoo_alt(filter, bucket, fp);
+    if (cuckoo_insert_bucket(filter, bucket, fp) || cuckoo_insert_bucket(filter, alt, fp)) {
+        return 1;
+    }
+
+    // Both buckets are full, kick random fingerprints to their other bucket
+    if (cuckoo_random(filter) & 1) {
+        bucket = alt;
+    }
+    for (size_t kick = 0; kick < CUCKOO_MAX_KICKS; ++kick) {
+        const size_t lane = (size_t)(cuckoo_random(filter) >> 32) % CUCKOO_BUCKET_SLOTS;
+        const uint16_t evicted = cuckoo_lane(filter->buckets[bucket], lane);
+        cuckoo_set_lane(filter->buckets + bucket, lane, fp);
+        fp = evicted;
+        bucket = cuckoo_alt(filter, bucket, fp);
+        if (cuckoo_insert_bucket(filter, bucket, fp)) {
+            return 1;
+        }
+    }
+    filter->victim = fp;
+    filter->victim_bucket = bucket;
+    return 0;
+}
+
+
+
+static int cuckoo_contains_hashed(const CuckooFilter *filter, const uint64_t hash) {
+    const uint16_t fp = cuckoo_fingerprint(hash);
+    const size_t first = (size_t)hash & filter->mask;
+    const size_t second = cuckoo_alt(filter, first, fp);
+    if (cuckoo_match(filter->buckets[first], fp) || cuckoo_match(filter->buckets[second], fp)) {
+        return 1;
+    }
+    return filter->victim == fp && (filter->victim_bucket == first || filter->victim_bucket == second);
+}
+
+
+
+/********************************** Public ************************************/
+
+BloomFilter *bloom_init(const FilterAllocFn alloc, const FilterFreeFn dealloc, const size_t capacity,
+        const size_t bits_per_key) {
+    // Check if alloc and free could be NULL
+    FilterAllocFn local_alloc = alloc;
+    FilterFreeFn local_free = dealloc;
+    if (alloc == NULL || dealloc == NULL) {
+        local_alloc = malloc;
+        local_free = free;
+    }
+
+    // Round up to whole blocks and keep the block index below 2^32
+    const size_t block_bits = BLOOM_BLOCK_WORDS * 64;
+    if (bits_per_key != 0 && capacity > SIZE_MAX / bits_per_key) {
+        return NULL;
+    }
+    size_t blocks = (capacity * bits_per_key + block_bits - 1) / block_bits;
+    if (blocks == 0) {
+        blocks = 1;
+    }
+    if (blocks > UINT32_MAX || blocks > (SIZE_MAX - FILTER_LINE_SIZE) / (block_bits / 8)) {
+        return NULL;
+    }
+
+    BloomFilter *filter = local_alloc(sizeof(BloomFilter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->bits = filter_alloc_lines(local_alloc, blocks * (block_bits / 8), &filter->raw);
+    if (filter->bits == NULL) {
+        local_free(filter);
+        return NULL;
+    }
+    filter->dealloc = local_free;
+    filter->seed = hash_random_seed();
+    filter->blocks = blocks;
+    return filter;
+}
+
+
+
+void bloom_add(BloomFilter *filter, const void *key, const size_t len) {
+    // Sanity check
+    if (filter == NULL || (key == NULL && len != 0)) {
+        return;
+    }
+
+    const uint64_t hash = hash_bytes(key, len, filter->seed);
+    uint64_t *block = bloom_block(filter, hash);
+    uint64_t mask[BLOOM_BLOCK_WORDS];
+    bloom_mask(hash, mask);
+    for (size_t i = 0; i < BLOOM_BLOCK_WORDS; ++i) {
+        block[i] |= mask[i];
+    }
+}
+
+
+
+int bloom_contains(const BloomFilter *filter, const void *key, const size_t len) {
+    // Sanity check
+    if (filter == NULL || (key == NULL && len != 0)) {
+        return 0;
+    }
+
+    return bloom_contains_hashed(filter, hash_bytes(key, len, filter->seed));
+}
+
+
+
+size_t bloom_contains_batch(const BloomFilter *filter, const void *keys, const size_t len, const size_t n,
+        unsigned char *out) {
+    // Sanity check
+    if (filter == NULL || (keys == NULL && n != 0 && len != 0) || out == NULL) {
+        return 0;
+    }
+
+    const char *key_bytes = keys;
+    size_t found = 0;
+    uint64_t hashes[FILTER_BATCH];
+    for (size_t start = 0; start < n; start += FILTER_BATCH) {
+        const size_t count = n - start < FILTER_BATCH ? n - start : FILTER_BATCH;
+
+        // Hash and prefetch all keys of the batch, so their misses overlap
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hash_bytes(key_bytes + (start + i) * len, len, filter->seed);
+            filter_prefetch(bloom_block(filter, hashes[i]));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            out[start + i] = (unsigned char)bloom_contains_hashed(filter, hashes[i]);
+            found += out[start + i];
+        }
+    }
+    return found;
+}
+
+
+
+void bloom_free(BloomFilter *filter) {
+    // Sanity check
+    if (filter == NULL) {
+        return;
+    }
+
+    filter->dealloc(filter->raw);
+    filter->dealloc(filter);
+}
+
+
+
+CuckooFilter *cuckoo_init(const FilterAllocFn alloc, const FilterFreeFn dealloc, const size_t capacity) {
+    // Check if alloc and free could be NULL
+    FilterAllocFn local_alloc = alloc;
+    FilterFreeFn local_free = dealloc;
+    if (alloc == NULL || dealloc == NULL) {
+        local_alloc = malloc;
+        local_free = free;
+    }
+
+    // Insertions start failing at about 95% load with buckets of four
+    const size_t needed = capacity / 19 * 5 + (capacity % 19 * 5 + 18) / 19;
+    size_t bucket_count = 1;
+    while (bucket_count < needed) {
+        if (bucket_count > (SIZE_MAX - FILTER_LINE_SIZE) / sizeof(uint64_t) / 2) {
+            return NULL;
+        }
+        bucket_count <<= 1;
+    }
+
+    CuckooFilter *filter = local_alloc(sizeof(CuckooFilter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->buckets = filter_alloc_lines(local_alloc, bucket_count * sizeof(uint64_t), &filter->raw);
+    if (filter->buckets == NULL) {
+        local_free(filter);
+        return NULL;
+    }
+    filter->dealloc = local_free;
+    filter->seed = hash_random_seed();
+    filter->mask = bucket_count - 1;
+    filter->size = 0;
+    filter->rng = filter->seed | 1;
+    filter->victim = 0;
+    filter->victim_bucket = 0;
+    return filter;
+}
+
+
+
+int cuckoo_add(CuckooFilter *filter, const void *key, const size_t len) {
+    // Sanity check
+    if (filter == NULL || (key == NULL && len != 0)) {
+        return 0;
+    }
+
+    // A parked victim means the last insertion already failed to find a lane
+    if (filter->victim != 0) {
+        return 0;
+    }
+
+    const uint64_t hash = hash_bytes(key, len, filter->seed);
+    cuckoo_place(filter, (size_t)hash & filter->mask, cuckoo_fingerprint(hash));
+    filter->size++;
+    return 1;
+}
+
+
+
+int cuckoo_contains(const CuckooFilter *filter, const void *key, const size_t len) {
+    // Sanity check
+    if (filter == NULL || (key == NULL && len != 0)) {
+        return 0;
+    }
+
+    return cuckoo_contains_hashed(filter, hash_bytes(key, len, filter->seed));
+}
+
+
+
+size_t cuckoo_contains_batch(const CuckooFilter *filter, const void *keys, const size_t len, const size_t n,
+        unsigned char *out) {
+    // Sanity check
+    if (filter == NULL || (keys == NULL && n != 0 && len != 0) || out == NULL) {
+        return 0;
+    }
+
+    const char *key_bytes = keys;
+    size_t found = 0;
+    uint64_t hashes[FILTER_BATCH];
+    for (size_t start = 0; start < n; start += FILTER_BATCH) {
+        const size_t count = n - start < FILTER_BATCH ? n - start : FILTER_BATCH;
+
+        // Only the first bucket is prefetched, the second needs another hash
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = hash_bytes(key_bytes + (start + i) * len, len, filter->seed);
+            filter_prefetch(filter->buckets + ((size_t)hashes[i] & filter->mask));
+        }
+        for (size_t i = 0; i < count; ++i) {
+            out[start + i] = (unsigned char)cuckoo_contains_hashed(filter, hashes[i]);
+            found += out[start + i];
+        }
+    }
+    return found;
+}
+
+
+
+int cuckoo_remove(CuckooFilter *filter, const void *key, const size_t len) {
+    // Sanity check
+    if (filter == NULL || (key == NULL && len != 0)) {
+        return 0;
+    }
+
+    const uint64_t hash = hash_bytes(key, len, filter->seed);
+    const uint16_t fp = cuckoo_fingerprint(hash);
+    const size_t first = (size_t)hash & filter->mask;
+    const size_t second = cuckoo_alt(filter, first, fp);
+
+    if (filter->victim == fp && (filter->victim_bucket == first || filter->victim_bucket == second)) {
+        filter->victim = 0;
+        filter->size--;
+        return 1;
+    }
+
+    const size_t candidates[2] = {first, second};
+    for (size_t c = 0; c < 2; ++c) {
+        uint64_t *word = filter->buckets + candidates[c];
+        const uint64_t match = cuckoo_match(*word, fp);
+        if (match == 0) {
+            continue;
+        }
+
+        // Lowest matching lane, bit 15 of lane i is bit 16 * i + 15
+        size_t lane = 0;
+        while (!(match & ((uint64_t)0x8000 << (lane * 16)))) {
+            lane++;
+        }
+        cuckoo_set_lane(word, lane, 0);
+        filter->size--;
+
+        // The freed lane may be what the victim was missing
+        if (filter->victim != 0) {
+            const uint16_t victim = filter->victim;
+            filter->victim = 0;
+            cuckoo_place(filter, filter->victim_bucket, victim);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+
+
+size_t cuckoo_size(const CuckooFilter *filter) {
+    return filter == NULL ? 0 : filter->size;
+}
+
+
+
+void cuckoo_free(CuckooFilter *filter) {
+    // Sanity check
+    if (filter == NULL) {
+        return;
+    }
+
+    filter->dealloc(filter->raw);
+    filter->dealloc(filter);
+}
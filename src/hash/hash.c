@@ -0,0 +1,215 @@
+// Header file
+#include "../../include/hash.h"
+
+// Libraries
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+/********************************** Private ***********************************/
+
+/// Constants of wyhash, odd with balanced bits
+#define HASH_P0 0xA0761D6478BD642Full
+#define HASH_P1 0xE7037ED1A0B428DBull
+#define HASH_P2 0x8EBC6AF09C88C6E3ull
+#define HASH_P3 0x589965CC75374CC3ull
+
+
+
+/// Multiply [a] and [b] to 128 bits and return low and high half in them
+static void hash_mum(uint64_t *a, uint64_t *b) {
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 hash_u128;
+    const hash_u128 product = (hash_u128)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
+#else
+    const uint64_t ha = *a >> 32, la = (uint32_t)*a;
+    const uint64_t hb = *b >> 32, lb = (uint32_t)*b;
+    const uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    const uint64_t mid = (ll >> 32) + (uint32_t)hl + (uint32_t)lh;
+    *a = (mid << 32) | (uint32_t)ll;
+    *b = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+#endif
+}
+
+/// Fold the 128 bit product of [a] and [b] into 64 bits
+static uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+
+
+static uint64_t hash_read8(const unsigned char *bytes) {
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+static uint64_t hash_read4(const unsigned char *bytes) {
+    uint32_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+/// Read 1 to 3 bytes
+static uint64_t hash_read3(const unsigned char *bytes, const size_t len) {
+    return ((uint64_t)bytes[0] << 16) | ((uint64_t)bytes[len >> 1] << 8) | bytes[len - 1];
+}
+
+
+
+/// Final step that is shared by all lengths
+static uint64_t hash_finish(uint64_t a, uint64_t b, const size_t len, const uint64_t seed) {
+    a ^= HASH_P1;
+    b ^= seed;
+    hash_mum(&a, &b);
+    return hash_mix(a ^ HASH_P0 ^ len, b ^ HASH_P1);
+}
+
+static uint64_t hash_seed_mix(const uint64_t seed) {
+    return seed ^ hash_mix(seed ^ HASH_P0, HASH_P1);
+}
+
+
+/// Process wide secret that seeds are derived from, 0 until it is set
+static uint64_t hash_secret;
+
+/// Amount of seeds handed out
+static uint64_t hash_counter;
+
+
+/// Without atomics racing first calls may each set a secret, which is
+/// harmless since any of them is random. The counter may repeat then.
+#if defined(__GNUC__)
+static uint64_t hash_load(const uint64_t *value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static void hash_store(uint64_t *value, const uint64_t new_value) {
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+static uint64_t hash_next(uint64_t *value) {
+    return __atomic_fetch_add(value, 1, __ATOMIC_RELAXED);
+}
+#else
+static uint64_t hash_load(const uint64_t *value) {
+    return *value;
+}
+
+static void hash_store(uint64_t *value, const uint64_t new_value) {
+    *value = new_value;
+}
+
+static uint64_t hash_next(uint64_t *value) {
+    return (*value)++;
+}
+#endif
+
+
+
+/// Read a secret from the system or derive one if that fails
+static uint64_t hash_new_secret(void) {
+    uint64_t secret = 0;
+    FILE *random = fopen("/dev/urandom", "rb");
+    if (random != NULL) {
+        if (fread(&secret, sizeof(secret), 1, random) != 1) {
+            secret = 0;
+        }
+        fclose(random);
+    }
+
+    if (secret == 0) {
+        // Clock and the address of a local differ between runs
+        const uintptr_t stack = (uintptr_t)&secret;
+        secret = hash_mix((uint64_t)time(NULL) ^ HASH_P1, (uint64_t)clock() ^ HASH_P2);
+        secret = hash_mix(secret ^ (uint64_t)stack, HASH_P3);
+    }
+    return secret == 0 ? HASH_P0 : secret;
+}
+
+
+/*********************************** Public ***********************************/
+
+
+uint64_t hash_bytes(const void *key, const size_t len, uint64_t seed) {
+    const unsigned char *bytes = key;
+    uint64_t a;
+    uint64_t b;
+    seed = hash_seed_mix(seed);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            // Two overlapping reads of 4 bytes from each end
+            const size_t inner = (len >> 3) << 2;
+            a = (hash_read4(bytes) << 32) | hash_read4(bytes + inner);
+            b = (hash_read4(bytes + len - 4) << 32) | hash_read4(bytes + len - 4 - inner);
+        } else if (len > 0) {
+            a = hash_read3(bytes, len);
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t left = len;
+        if (left > 48) {
+            // Three independent lanes
+            uint64_t lane1 = seed;
+            uint64_t lane2 = seed;
+            do {
+                seed = hash_mix(hash_read8(bytes) ^ HASH_P1, hash_read8(bytes + 8) ^ seed);
+                lane1 = hash_mix(hash_read8(bytes + 16) ^ HASH_P2, hash_read8(bytes + 24) ^ lane1);
+                lane2 = hash_mix(hash_read8(bytes + 32) ^ HASH_P3, hash_read8(bytes + 40) ^ lane2);
+                bytes += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (left > 16) {
+            seed = hash_mix(hash_read8(bytes) ^ HASH_P1, hash_read8(bytes + 8) ^ seed);
+            bytes += 16;
+            left -= 16;
+        }
+        a = hash_read8(bytes + left - 16);
+        b = hash_read8(bytes + left - 8);
+    }
+
+    return hash_finish(a, b, len, seed);
+}
+
+
+
+uint64_t hash_u32(const uint32_t key, const uint64_t seed) {
+    const uint64_t word = ((uint64_t)key << 32) | key;
+    return hash_finish(word, word, sizeof(key), hash_seed_mix(seed));
+}
+
+
+
+uint64_t hash_u64(const uint64_t key, const uint64_t seed) {
+    // Same words as hash_bytes reads from the bytes of [key]
+    unsigned char bytes[sizeof(key)];
+    memcpy(bytes, &key, sizeof(key));
+    const uint64_t first = hash_read4(bytes);
+    const uint64_t second = hash_read4(bytes + 4);
+    return hash_finish((first << 32) | second, (second << 32) | first, sizeof(key), hash_seed_mix(seed));
+}
+
+
+
+uint64_t hash_random_seed(void) {
+    uint64_t secret = hash_load(&hash_secret);
+    if (secret == 0) {
+        secret = hash_new_secret();
+        hash_store(&hash_secret, secret);
+    }
+
+    // Distinct for every call, the secret keeps it unpredictable
+    const uint64_t count = hash_next(&hash_counter);
+    return hash_mix(secret ^ HASH_P2, count * HASH_P3 ^ HASH_P0);
+}
@@ -0,0 +1,455 @@
+// Header file
+#include "../../include/heap.h"
+#include "../common/alloc_internal.h"
+#include "../vector/vector_internal.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/********************************** Private ***********************************/
+
+/// Position i of the heap is slot pad + i of the vector, pad = arity - 1.
+/// Its children are the positions arity * i + 1 to arity * i + arity, which
+/// are the slots arity * (i + 1) to arity * (i + 1) + arity - 1. Every
+/// sibling group therefore starts at a multiple of arity slots. The pad
+/// slots stay 0.
+///
+/// Elements are sifted with a hole: the moving element waits in tmp, the
+/// elements it passes move one level and it is written once at the end.
+///
+/// An indexed heap keeps two size_t vectors in sync with the elements: ids
+/// maps a position to its handle and pos maps a handle to its position.
+/// Handles that are not in use are kept in free_ids.
+
+
+/// pos of a handle that is not in use
+#define HEAP_NO_POS SIZE_MAX
+
+
+struct heap {
+    Vector *vec; /* pad + size slots */
+    size_t pad;
+    size_t arity;
+    HeapComparator comp; /* Nonnull */
+    void *tmp; /* elem_size bytes behind the struct */
+    Vector *ids; /* NULL if not indexed */
+    Vector *pos;
+    Vector *free_ids;
+};
+
+
+
+static int heap_memcmp(const void *a, const void *b, const size_t size) {
+    return memcmp(a, b, size);
+}
+
+static size_t heap_count(const Heap *heap) {
+    return heap->vec->len - heap->pad;
+}
+
+static void *heap_slot(const Heap *heap, const size_t i) {
+    return (char *)heap->vec->stroage + (heap->pad + i) * heap->vec->elem_size;
+}
+
+static int heap_less(const Heap *heap, const void *a, const void *b) {
+    return heap->comp(a, b, heap->vec->elem_size) < 0;
+}
+
+static size_t *heap_index(const Vector *vec) {
+    return (size_t *)vec->stroage;
+}
+
+
+
+/// Copy [elem] with handle [id] into position [i]
+static void heap_place(Heap *heap, const size_t i, const void *elem, const size_t id) {
+    memcpy(heap_slot(heap, i), elem, heap->vec->elem_size);
+    if (heap->ids != NULL) {
+        heap_index(heap->ids)[i] = id;
+        heap_index(heap->pos)[id] = i;
+    }
+}
+
+/// Move the element at position [from] to position [to]
+static void heap_move(Heap *heap, const size_t from, const size_t to) {
+    heap_place(heap, to, heap_slot(heap, from), heap->ids == NULL ? 0 : heap_index(heap->ids)[from]);
+}
+
+
+
+/// Move the element at position [i] up while it is smaller than its parent
+///
+/// Returns:
+///   the new position of the element
+static size_t heap_sift_up(Heap *heap, size_t i) {
+    const size_t id = heap->ids == NULL ? 0 : heap_index(heap->ids)[i];
+    memcpy(heap->tmp, heap_slot(heap, i), heap->vec->elem_size);
+    while (i > 0) {
+        const size_t parent = (i - 1) / heap->arity;
+        if (!heap_less(heap, heap->tmp, heap_slot(heap, parent))) {
+            break;
+        }
+        heap_move(heap, parent, i);
+        i = parent;
+    }
+    heap_place(heap, i, heap->tmp, id);
+    return i;
+}
+
+
+
+/// Move the element at position [i] down while a child is smaller
+static void heap_sift_down(Heap *heap, size_t i) {
+    const size_t count = heap_count(heap);
+    const size_t id = heap->ids == NULL ? 0 : heap_index(heap->ids)[i];
+    memcpy(heap->tmp, heap_slot(heap, i), heap->vec->elem_size);
+    for (;;) {
+        // The children are contiguous, so scanning them stays in few lines
+        const size_t first = heap->arity * i + 1;
+        if (first >= count) {
+            break;
+        }
+        const size_t end = count - first < heap->arity ? count : first + heap->arity;
+        size_t min = first;
+        for (size_t child = first + 1; child < end; ++child) {
+            if (heap_less(heap, heap_slot(heap, child), heap_slot(heap, min))) {
+                min = child;
+            }
+        }
+        if (!heap_less(heap, heap_slot(heap, min), heap->tmp)) {
+            break;
+        }
+        heap_move(heap, min, i);
+        i = min;
+    }
+    heap_place(heap, i, heap->tmp, id);
+}
+
+
+
+/// Remove the element at position [i], its handle is released
+static void heap_remove_at(Heap *heap, const size_t i) {
+    const size_t last = heap_count(heap) - 1;
+    if (heap->ids != NULL) {
+        const size_t id = heap_index(heap->ids)[i];
+        heap_index(heap->pos)[id] = HEAP_NO_POS;
+        // Room for every handle was reserved when it was handed out
+        heap_index(heap->free_ids)[heap->free_ids->len++] = id;
+    }
+    if (i != last) {
+        heap_move(heap, last, i);
+    }
+
+    // Keep everything behind the elements 0
+    memset(heap_slot(heap, last), 0, heap->vec->elem_size);
+    heap->vec->len--;
+
+    if (i != last && heap_sift_up(heap, i) == i) {
+        heap_sift_down(heap, i);
+    }
+}
+
+
+
+/// Make room for one more element, and for its handle if [heap] is indexed
+static int heap_reserve(Heap *heap) {
+    Vector *vec = heap->vec;
+    if (vec->len >= vec->cap - 1 && !vector_grow(vec, vec->cap * 2)) {
+        return 0;
+    }
+    if (heap->ids == NULL) {
+        return 1;
+    }
+    const size_t count = heap_count(heap) + 1;
+    if (count >= heap->ids->cap && !vector_grow(heap->ids, heap->ids->cap * 2)) {
+        return 0;
+    }
+    if (heap->free_ids->len == 0) {
+        if (heap->pos->len >= heap->pos->cap - 1 && !vector_grow(heap->pos, heap->pos->cap * 2)) {
+            return 0;
+        }
+        if (heap->pos->len >= heap->free_ids->cap && !vector_grow(heap->free_ids, heap->free_ids->cap * 2)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+
+/// Wrap [vec], which holds pad 0 slots and nothing else, into a heap
+static Heap *heap_create(Vector *vec, const size_t arity, const HeapComparator comp, const int indexed) {
+    Heap *heap = ds_state_alloc(&vec->heap, sizeof(Heap) + vec->elem_size);
+    if (heap == NULL) {
+        return NULL;
+    }
+    heap->vec = vec;
+    heap->pad = arity - 1;
+    heap->arity = arity;
+    heap->comp = comp == NULL ? heap_memcmp : comp;
+    heap->tmp = heap + 1;
+    heap->ids = NULL;
+    heap->pos = NULL;
+    heap->free_ids = NULL;
+    if (indexed) {
+        heap->ids = vector_create(&vec->heap, sizeof(size_t));
+        heap->pos = vector_create(&vec->heap, sizeof(size_t));
+        heap->free_ids = vector_create(&vec->heap, sizeof(size_t));
+        if (heap->ids == NULL || heap->pos == NULL || heap->free_ids == NULL) {
+            vector_free(heap->ids);
+            vector_free(heap->pos);
+            vector_free(heap->free_ids);
+            ds_state_free(&vec->heap, heap, sizeof(Heap) + vec->elem_size);
+            return NULL;
+        }
+    }
+    return heap;
+}
+
+static Heap *heap_create_empty(const DsAllocState *state, const size_t elem_size, size_t arity,
+        const HeapComparator comp, const int indexed) {
+    // Sanity check
+    if (elem_size == 0 || arity == 1 || arity > HEAP_MAX_ARITY) {
+        return NULL;
+    }
+    if (arity == 0) {
+        arity = HEAP_DEFAULT_ARITY;
+    }
+
+    Vector *vec = vector_create(state, elem_size);
+    if (vec == NULL) {
+        return NULL;
+    }
+    if (!vector_grow(vec, arity)) {
+        vector_free(vec);
+        return NULL;
+    }
+    vec->len = arity - 1;
+
+    Heap *heap = heap_create(vec, arity, comp, indexed);
+    if (heap == NULL) {
+        vector_free(vec);
+    }
+    return heap;
+}
+
+
+
+/********************************** Public ************************************/
+
+Heap *heap_init(const HeapAllocFn alloc, const HeapFreeFn dealloc, const size_t elem_size, const size_t arity,
+        const HeapComparator comp) {
+    DsAllocState state;
+    ds_alloc_state_fns(&state, alloc, dealloc);
+    return heap_create_empty(&state, elem_size, arity, comp, 0);
+}
+
+
+
+Heap *heap_init_alloc(const DsAllocator *allocator, const size_t elem_size, const size_t arity,
+        const HeapComparator comp) {
+    DsAllocState state;
+    ds_alloc_state_init(&state, allocator);
+    return heap_create_empty(&state, elem_size, arity, comp, 0);
+}
+
+
+
+Heap *heap_init_indexed(const HeapAllocFn alloc, const HeapFreeFn dealloc, const size_t elem_size,
+        const size_t arity, const HeapComparator comp) {
+    DsAllocState state;
+    ds_alloc_state_fns(&state, alloc, dealloc);
+    return heap_create_empty(&state, elem_size, arity, comp, 1);
+}
+
+
+
+Heap *heap_from_vector(Vector *vec, size_t arity, const HeapComparator comp) {
+    // Sanity check
+    if (vec == NULL || arity == 1 || arity > HEAP_MAX_ARITY) {
+        return NULL;
+    }
+    if (arity == 0) {
+        arity = HEAP_DEFAULT_ARITY;
+    }
+
+    // A mapped snapshot is read only, growing copies it into owned storage
+    const size_t count = vec->len;
+    size_t cap = count + arity;
+    if (vec->map_base != NULL && cap <= vec->cap) {
+        cap = vec->cap + 1;
+    }
+    if (!vector_grow(vec, cap)) {
+        return NULL;
+    }
+    Heap *heap = heap_create(vec, arity, comp, 0);
+    if (heap == NULL) {
+        return NULL;
+    }
+
+    // Shift the elements behind the pad slots
+    memmove((char *)vec->stroage + (arity - 1) * vec->elem_size, vec->stroage, count * vec->elem_size);
+    memset(vec->stroage, 0, (arity - 1) * vec->elem_size);
+    vec->len = count + arity - 1;
+
+    // Floyd: sift down every parent, the last one first
+    if (count > 1) {
+        for (size_t i = (count - 2) / arity + 1; i-- > 0;) {
+            heap_sift_down(heap, i);
+        }
+    }
+    return heap;
+}
+
+
+
+int heap_push(Heap *heap, const void *elem) {
+    // Sanity check
+    if (heap == NULL || elem == NULL) {
+        return 0;
+    }
+    if (heap->ids != NULL) {
+        size_t handle;
+        return heap_push_handle(heap, elem, &handle);
+    }
+    if (!heap_reserve(heap)) {
+        return 0;
+    }
+    const size_t i = heap_count(heap);
+    heap->vec->len++;
+    heap_place(heap, i, elem, 0);
+    heap_sift_up(heap, i);
+    return 1;
+}
+
+
+
+const void *heap_peek(const Heap *heap) {
+    // Sanity check
+    if (heap == NULL || heap_count(heap) == 0) {
+        return NULL;
+    }
+    return heap_slot(heap, 0);
+}
+
+
+
+int heap_pop(Heap *heap, void *out) {
+    return heap_pop_handle(heap, out, NULL);
+}
+
+
+
+size_t heap_size(const Heap *heap) {
+    return heap == NULL ? 0 : heap_count(heap);
+}
+
+
+
+void heap_free(Heap *heap) {
+    // Sanity check
+    if (heap == NULL) {
+        return;
+    }
+    vector_free(heap->ids);
+    vector_free(heap->pos);
+    vector_free(heap->free_ids);
+    const DsAllocState state = heap->vec->heap;
+    const size_t size = sizeof(Heap) + heap->vec->elem_size;
+    vector_free(heap->vec);
+    ds_state_free(&state, heap, size);
+}
+
+
+
+
+/********************************** Indexed ***********************************/
+
+int heap_push_handle(Heap *heap, const void *elem, size_t *handle) {
+    // Sanity check
+    if (heap == NULL || elem == NULL || handle == NULL || heap->ids == NULL) {
+        return 0;
+    }
+    if (!heap_reserve(heap)) {
+        return 0;
+    }
+
+    // Reuse the last released handle, so handles stay small
+    size_t id;
+    if (heap->free_ids->len != 0) {
+        id = heap_index(heap->free_ids)[--heap->free_ids->len];
+    } else {
+        id = heap->pos->len++;
+    }
+
+    const size_t i = heap_count(heap);
+    heap->vec->len++;
+    heap->ids->len++;
+    heap_place(heap, i, elem, id);
+    heap_sift_up(heap, i);
+    *handle = id;
+    return 1;
+}
+
+
+
+int heap_pop_handle(Heap *heap, void *out, size_t *handle) {
+    // Sanity check
+    if (heap == NULL || heap_count(heap) == 0 || (handle != NULL && heap->ids == NULL)) {
+        return 0;
+    }
+    if (out != NULL) {
+        memcpy(out, heap_slot(heap, 0), heap->vec->elem_size);
+    }
+    if (handle != NULL) {
+        *handle = heap_index(heap->ids)[0];
+    }
+    if (heap->ids != NULL) {
+        heap->ids->len--;
+    }
+    heap_remove_at(heap, 0);
+    return 1;
+}
+
+
+
+const void *heap_get(const Heap *heap, const size_t handle) {
+    // Sanity check
+    if (heap == NULL || heap->ids == NULL || handle >= heap->pos->len) {
+        return NULL;
+    }
+    const size_t i = heap_index(heap->pos)[handle];
+    return i == HEAP_NO_POS ? NULL : heap_slot(heap, i);
+}
+
+
+
+int heap_update(Heap *heap, const size_t handle, const void *elem) {
+    void *slot = (void *)heap_get(heap, handle);
+    if (slot == NULL || elem == NULL) {
+        return 0;
+    }
+    const size_t i = heap_index(heap->pos)[handle];
+    const int smaller = heap_less(heap, elem, slot);
+    memcpy(slot, elem, heap->vec->elem_size);
+    if (smaller) {
+        heap_sift_up(heap, i);
+    } else {
+        heap_sift_down(heap, i);
+    }
+    return 1;
+}
+
+
+
+int heap_remove(Heap *heap, const size_t handle) {
+    if (heap_get(heap, handle) == NULL) {
+        return 0;
+    }
+    heap->ids->len--;
+    heap_remove_at(heap, heap_index(heap->pos)[handle]);
+    return 1;
+}
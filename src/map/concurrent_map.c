@@ -0,0 +1,219 @@
+// Needed for pthread_rwlock_t
+#define _POSIX_C_SOURCE 200809L
+
+// Header file
+#include "../../include/concurrent_map.h"
+#include "../../include/hash.h"
+#include "map_internal.h"
+
+// Libraries
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/********************************** Private ***********************************/
+
+/// Shards are picked by the bits right below the top 7 bits of the hash.
+/// The maps themselves use the low bits and the top 7 bits, so the shard
+/// bits do not correlate with where a key lands inside its shard. All shards
+/// share one seed, which lets the hash be computed once per operation.
+
+
+/// Shard count when none is given
+#define CMAP_DEFAULT_SHARDS 16
+
+/// Upper bound for the shard count
+#define CMAP_MAX_SHARDS 4096
+
+/// Shards are padded to this so two locks never share a cache line
+#define CMAP_LINE_SIZE 64
+
+
+typedef struct {
+    pthread_rwlock_t lock;
+    Map *map;
+} CMapShard;
+
+
+struct concurrent_map {
+    MapFreeFn dealloc; /* Nonnull */
+    size_t val_len;
+    size_t shard_count; /* Power of two */
+    unsigned shard_shift; /* 57 - log2(shard_count) */
+    size_t shard_stride; /* sizeof(CMapShard) rounded up to CMAP_LINE_SIZE */
+    void *raw; /* Allocation that shards points into */
+    char *shards; /* Aligned to CMAP_LINE_SIZE */
+};
+
+
+
+static CMapShard *cmap_shard_at(const ConcurrentMap *map, const size_t index) {
+    return (CMapShard *)(map->shards + index * map->shard_stride);
+}
+
+static CMapShard *cmap_shard(const ConcurrentMap *map, const uint64_t hash) {
+    return cmap_shard_at(map, (size_t)(hash >> map->shard_shift) & (map->shard_count - 1));
+}
+
+/// Hash [key], every shard hashes the same way
+static uint64_t cmap_hash(const ConcurrentMap *map, const void *key) {
+    return map_hash(cmap_shard_at(map, 0)->map, key);
+}
+
+
+
+/// Destroy the first [count] shards and free the map
+static void cmap_destroy(ConcurrentMap *map, const size_t count) {
+    MapFreeFn dealloc = map->dealloc;
+    for (size_t i = 0; i < count; ++i) {
+        CMapShard *shard = cmap_shard_at(map, i);
+        pthread_rwlock_destroy(&shard->lock);
+        map_free(shard->map);
+    }
+    dealloc(map->raw);
+    dealloc(map);
+}
+
+
+/*********************************** Public ***********************************/
+
+
+ConcurrentMap *concurrent_map_init(const MapAllocFn alloc, const MapFreeFn dealloc, const MapHashFn hash,
+        const size_t key_len, const size_t val_len, size_t shards) {
+    // Check if alloc and free could be NULL
+    MapAllocFn local_alloc = alloc;
+    MapFreeFn local_free = dealloc;
+    if (alloc == NULL || dealloc == NULL) {
+        local_alloc = malloc;
+        local_free = free;
+    }
+
+    if (shards == 0) {
+        shards = CMAP_DEFAULT_SHARDS;
+    }
+    if (shards > CMAP_MAX_SHARDS) {
+        shards = CMAP_MAX_SHARDS;
+    }
+    size_t shard_count = 1;
+    unsigned shard_bits = 0;
+    while (shard_count < shards) {
+        shard_count <<= 1;
+        shard_bits++;
+    }
+
+    ConcurrentMap *map = local_alloc(sizeof(ConcurrentMap));
+    if (map == NULL) {
+        return NULL;
+    }
+    map->dealloc = local_free;
+    map->val_len = val_len;
+    map->shard_count = shard_count;
+    map->shard_shift = 57 - shard_bits;
+    map->shard_stride = (sizeof(CMapShard) + CMAP_LINE_SIZE - 1) & ~(size_t)(CMAP_LINE_SIZE - 1);
+
+    // Slack for alignment
+    map->raw = local_alloc(shard_count * map->shard_stride + CMAP_LINE_SIZE - 1);
+    if (map->raw == NULL) {
+        local_free(map);
+        return NULL;
+    }
+    const uintptr_t aligned = ((uintptr_t)map->raw + CMAP_LINE_SIZE - 1) & ~(uintptr_t)(CMAP_LINE_SIZE - 1);
+    map->shards = (char *)aligned;
+
+    const uint64_t seed = hash_random_seed();
+    for (size_t i = 0; i < shard_count; ++i) {
+        CMapShard *shard = cmap_shard_at(map, i);
+        shard->map = map_init(local_alloc, local_free, hash, key_len, val_len);
+        if (shard->map == NULL) {
+            cmap_destroy(map, i);
+            return NULL;
+        }
+        map_set_seed(shard->map, seed);
+        if (pthread_rwlock_init(&shard->lock, NULL) != 0) {
+            map_free(shard->map);
+            cmap_destroy(map, i);
+            return NULL;
+        }
+    }
+
+    return map;
+}
+
+
+
+int concurrent_map_put(ConcurrentMap *map, const void *key, const void *value) {
+    // Sanity check
+    if (map == NULL || key == NULL) {
+        return 0;
+    }
+
+    const uint64_t hash = cmap_hash(map, key);
+    CMapShard *shard = cmap_shard(map, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+    const void *slot = map_put_hashed(shard->map, key, hash, value);
+    pthread_rwlock_unlock(&shard->lock);
+    return slot != NULL;
+}
+
+
+
+int concurrent_map_get(ConcurrentMap *map, const void *key, void *out) {
+    // Sanity check
+    if (map == NULL || key == NULL) {
+        return 0;
+    }
+
+    const uint64_t hash = cmap_hash(map, key);
+    CMapShard *shard = cmap_shard(map, hash);
+    pthread_rwlock_rdlock(&shard->lock);
+    const void *value = map_get_hashed(shard->map, key, hash);
+    if (value != NULL && out != NULL) {
+        memcpy(out, value, map->val_len);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+    return value != NULL;
+}
+
+
+
+int concurrent_map_remove(ConcurrentMap *map, const void *key) {
+    // Sanity check
+    if (map == NULL || key == NULL) {
+        return 0;
+    }
+
+    const uint64_t hash = cmap_hash(map, key);
+    CMapShard *shard = cmap_shard(map, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+    const int removed = map_remove_hashed(shard->map, key, hash);
+    pthread_rwlock_unlock(&shard->lock);
+    return removed;
+}
+
+
+
+size_t concurrent_map_size(ConcurrentMap *map) {
+    if (map == NULL) {
+        return 0;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < map->shard_count; ++i) {
+        CMapShard *shard = cmap_shard_at(map, i);
+        pthread_rwlock_rdlock(&shard->lock);
+        size += map_size(shard->map);
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return size;
+}
+
+
+
+void concurrent_map_free(ConcurrentMap *map) {
+    // Sanity check
+    if (map == NULL) {
+        return;
+    }
+    cmap_destroy(map, map->shard_count);
+}
@@ -1,175 +1,1053 @@
+// Header file
+#include "../../include/map.h"
+#include "../../include/hash.h"
+#include "../common/alloc_internal.h"
+#include "../common/stats_internal.h"
+#include "../common/trace_internal.h"
+#include "map_internal.h"
+
 // Libraries
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-/*********************************** Public ***********************************/
 
+/********************************** Private ***********************************/
 
-/// Handle to a map
+/// The table is an open addressing table with linear probing. Next to the
+/// slots, which hold key and value inline, there is one control byte per slot:
+/// MAP_EMPTY or the top 7 bits of the hash of the key in that slot. Probing
+/// looks at MAP_GROUP_WIDTH control bytes at once and only compares keys
+/// whose tag matches.
+///
+/// Deletion shifts later entries of the same run back instead of leaving a
+/// tombstone, so a probe can always stop at the first empty slot.
+///
+/// In string mode the key part of a slot is a MapStrKey. Keys of up to
+/// MAP_STR_INLINE bytes are kept in it directly, longer ones are copied into
+/// a bump arena owned by the map. The key caches its hash, so growing and
+/// deletion never look at the key bytes and lookups compare the hash before
+/// the bytes.
+///
+/// In cache mode the table has a fixed size and a reference byte per slot
+/// next to the control bytes. Hits set it, and when the map is full a clock
+/// hand sweeps the slots, clearing set bytes and evicting the first entry
+/// whose byte is already clear.
 ///
-/// This struct represents a handle to a map
-/// A pointer to this is used to pass into functions and
-/// perform operations on it.
-typedef struct map Map;
+/// Growing is incremental. A new table of twice the size becomes the live
+/// table and the old one is kept until it is drained. Every insertion or
+/// removal moves up to MAP_MIGRATE_SLOTS slots of the old table over, and
+/// lookups check both tables in the meantime. Slots that were moved out of
+/// the old table are marked MAP_MOVED, which probes skip over like full
+/// slots, so the runs in the old table stay intact.
 
 
-/// This type represents functions that are used to allocate memory
-/// the function 'malloc' is of this type
-///
-/// Parameters:
-/// - size_t: amount of bytes needed
-typedef void *(*MapAllocFn)(size_t);
+/// Amount of control bytes that are looked at in one step
+#define MAP_GROUP_WIDTH 16
+
+/// Smallest capacity, must be at least MAP_GROUP_WIDTH
+#define MAP_INIT_CAP 16
+
+/// Control byte of an empty slot
+#define MAP_EMPTY ((uint8_t)0x80)
+
+/// Control byte of a slot in the old table whose entry was moved
+#define MAP_MOVED ((uint8_t)0xFE)
 
-/// This type represents functions that are used to reallocate memory
-/// the function 'realloc' is of this type
+/// Old slots that are migrated per insertion or removal during a rehash
+#define MAP_MIGRATE_SLOTS 64
+
+/// Keys of a batch that are hashed and prefetched before they are probed.
+/// Enough to keep the memory system busy, few enough that the prefetched
+/// lines are still cached when the probes reach them.
+#define MAP_BATCH 16
+
+/// Maximum load factor as a fraction. Linear probing keeps runs short up to
+/// about 3/4.
+#define MAP_LOAD_NUM 3
+#define MAP_LOAD_DEN 4
+
+
+/// Longest string key that is stored inline
+#define MAP_STR_INLINE 15
+
+/// Length byte of a string key that lives in the arena
+#define MAP_STR_EXTERNAL ((unsigned char)0xFF)
+
+/// Smallest block of the string arena
+#define MAP_ARENA_BLOCK 65536
+
+
+/// Key of a map in string mode
 ///
-/// Parameters:
-/// - void *: old pointer
-/// - size_t: amount of bytes needed
-typedef void *(*MapReAllocFn)(void *, size_t);
+/// Inline keys are bytes[0..len), zero padded, with the length in bytes[15].
+/// Other keys have a pointer to their bytes in bytes[0..8), their length as
+/// uint32_t in bytes[8..12) and MAP_STR_EXTERNAL in bytes[15].
+typedef struct {
+    unsigned char bytes[MAP_STR_INLINE + 1];
+    uint64_t hash;
+} MapStrKey;
+
+
+typedef struct _MapArenaBlock MapArenaBlock;
+
+struct _MapArenaBlock {
+    MapArenaBlock *next;
+    size_t used;
+    size_t cap;
+};
+
+
+typedef struct {
+    size_t cap; /* Power of two */
+    uint8_t *ctrl; /* cap + MAP_GROUP_WIDTH bytes, the tail mirrors the head */
+    uint8_t *ref; /* cap reference bytes in cache mode, NULL otherwise */
+    char *slots; /* cap * slot_size bytes, NULL if the table is not in use */
+} MapTable;
+
+
+/// State of cache mode
+typedef struct {
+    size_t max_entries;
+    size_t hand; /* Next slot the clock looks at */
+    MapEvictFn evict; /* NULL if there is no callback */
+    void *ctx;
+    MapCacheStats stats;
+} MapCache;
+
+
+struct map {
+    DsAllocState heap;
+    MapHashFn hash; /* NULL for the built-in hash */
+    uint64_t seed;
+    size_t key_len;
+    size_t val_len;
+    size_t val_offset; /* Offset of the value inside a slot */
+    size_t slot_size;
+    size_t size; /* Entries in both tables */
+    MapTable table; /* Live table */
+    MapTable old; /* Table that is being drained */
+    size_t old_size; /* Entries left in old */
+    size_t migrate_pos; /* Next slot of old to migrate */
+    int str_keys; /* Keys are MapStrKey */
+    MapArenaBlock *arena; /* Bytes of long string keys, newest block first */
+    MapCache *cache; /* NULL if this is not a cache */
+#if defined(DS_STATS)
+    uint64_t stat_probes;
+    uint64_t stat_probe_slots; /* Slots from the home slot to where probes ended */
+    uint64_t stat_probe_max;
+#endif
+#if defined(DS_TRACE)
+    DsTrace *trace; /* NULL if not recording */
+#endif
+};
+
+
+
+uint64_t map_hash(const Map *map, const void *key) {
+    if (map->str_keys) {
+        return ((const MapStrKey *)key)->hash;
+    }
+    if (map->hash != NULL) {
+        return map->hash(key, map->key_len, map->seed);
+    }
+
+    // Fast paths for integer sized keys, they hash the same as hash_bytes
+    if (map->key_len == sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, key, sizeof(word));
+        return hash_u64(word, map->seed);
+    }
+    if (map->key_len == sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, key, sizeof(word));
+        return hash_u32(word, map->seed);
+    }
+    return hash_bytes(key, map->key_len, map->seed);
+}
+
+/// Bytes and length of a string key
+static const unsigned char *map_str_bytes(const MapStrKey *key, size_t *len) {
+    if (key->bytes[MAP_STR_INLINE] != MAP_STR_EXTERNAL) {
+        *len = key->bytes[MAP_STR_INLINE];
+        return key->bytes;
+    }
+    const unsigned char *bytes;
+    uint32_t ext_len;
+    memcpy(&bytes, key->bytes, sizeof(bytes));
+    memcpy(&ext_len, key->bytes + sizeof(bytes), sizeof(ext_len));
+    *len = ext_len;
+    return bytes;
+}
+
+/// Make a string key that refers to [len] bytes at [bytes]
+static void map_str_key(const Map *map, MapStrKey *key, const void *bytes, const size_t len) {
+    memset(key->bytes, 0, sizeof(key->bytes));
+    if (len <= MAP_STR_INLINE) {
+        memcpy(key->bytes, bytes, len);
+        key->bytes[MAP_STR_INLINE] = (unsigned char)len;
+    } else {
+        const uint32_t ext_len = (uint32_t)len;
+        memcpy(key->bytes, &bytes, sizeof(bytes));
+        memcpy(key->bytes + sizeof(bytes), &ext_len, sizeof(ext_len));
+        key->bytes[MAP_STR_INLINE] = MAP_STR_EXTERNAL;
+    }
+    key->hash = map->hash != NULL ? map->hash(bytes, len, map->seed) : hash_bytes(bytes, len, map->seed);
+}
+
+static int map_str_equal(const MapStrKey *a, const MapStrKey *b) {
+    if (a->hash != b->hash) {
+        return 0;
+    }
+    // Inline keys are zero padded and carry their length
+    if (memcmp(a->bytes, b->bytes, sizeof(a->bytes)) == 0) {
+        return 1;
+    }
+    if (a->bytes[MAP_STR_INLINE] != MAP_STR_EXTERNAL || b->bytes[MAP_STR_INLINE] != MAP_STR_EXTERNAL) {
+        return 0;
+    }
+    size_t a_len;
+    size_t b_len;
+    const unsigned char *a_bytes = map_str_bytes(a, &a_len);
+    const unsigned char *b_bytes = map_str_bytes(b, &b_len);
+    return a_len == b_len && memcmp(a_bytes, b_bytes, a_len) == 0;
+}
+
+static int map_key_equal(const Map *map, const void *slot_key, const void *key) {
+    if (map->str_keys) {
+        return map_str_equal(slot_key, key);
+    }
+    return memcmp(slot_key, key, map->key_len) == 0;
+}
+
+
+
+/// Copy the bytes of an external string key into the arena and point [key]
+/// at the copy
+static int map_arena_store(Map *map, MapStrKey *key) {
+    size_t len;
+    const unsigned char *bytes = map_str_bytes(key, &len);
+
+    MapArenaBlock *block = map->arena;
+    if (block == NULL || block->cap - block->used < len) {
+        const size_t cap = len > MAP_ARENA_BLOCK ? len : MAP_ARENA_BLOCK;
+        block = ds_state_alloc(&map->heap, sizeof(MapArenaBlock) + cap);
+        if (block == NULL) {
+            return 0;
+        }
+        block->next = map->arena;
+        block->used = 0;
+        block->cap = cap;
+        map->arena = block;
+    }
+
+    unsigned char *copy = (unsigned char *)(block + 1) + block->used;
+    memcpy(copy, bytes, len);
+    block->used += len;
+    memcpy(key->bytes, &copy, sizeof(copy));
+    return 1;
+}
+
+static void map_arena_free(Map *map) {
+    while (map->arena != NULL) {
+        MapArenaBlock *next = map->arena->next;
+        ds_state_free(&map->heap, map->arena, sizeof(MapArenaBlock) + map->arena->cap);
+        map->arena = next;
+    }
+}
+
+
+
+/// Home slot of a hash, taken from the low bits
+static size_t map_home(const MapTable *table, const uint64_t hash) {
+    return (size_t)hash & (table->cap - 1);
+}
+
+/// Control byte of a hash, taken from the top 7 bits
+static uint8_t map_tag(const uint64_t hash) {
+    return (uint8_t)(hash >> 57);
+}
+
+static char *map_slot(const Map *map, const MapTable *table, const size_t index) {
+    return table->slots + index * map->slot_size;
+}
 
-/// This type represents functions that are used to allocate initialized memory
-/// the function 'calloc' is of this type
+static void map_set_ctrl(MapTable *table, const size_t index, const uint8_t ctrl) {
+    table->ctrl[index] = ctrl;
+    if (index < MAP_GROUP_WIDTH) {
+        table->ctrl[table->cap + index] = ctrl;
+    }
+}
+
+
+
+/// Prefetch the first control group and slot a probe for [hash] looks at
+static void map_prefetch(const Map *map, const MapTable *table, const uint64_t hash) {
+#if defined(__GNUC__)
+    const size_t home = map_home(table, hash);
+    __builtin_prefetch(table->ctrl + home);
+    __builtin_prefetch(map_slot(map, table, home));
+#else
+    (void)map;
+    (void)table;
+    (void)hash;
+#endif
+}
+
+
+
+/// Index of the lowest set bit of a non zero mask
+static unsigned map_lowest_bit(const unsigned mask) {
+    assert(mask != 0);
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctz(mask);
+#else
+    unsigned index = 0;
+    while (!(mask & (1u << index))) {
+        index++;
+    }
+    return index;
+#endif
+}
+
+/// Bit i is set if byte i of the group at [ctrl] equals [byte]
+static unsigned map_group_match(const uint8_t *ctrl, const uint8_t byte) {
+#if defined(__SSE2__)
+    const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+#else
+    unsigned mask = 0;
+    for (unsigned i = 0; i < MAP_GROUP_WIDTH; ++i) {
+        mask |= (unsigned)(ctrl[i] == byte) << i;
+    }
+    return mask;
+#endif
+}
+
+
+
+#if defined(DS_STATS)
+/// Count a probe for [hash] that ended at [index]. ConcurrentMap probes
+/// under a shared read lock, so the counters are shared.
+static void map_count_probe(const Map *map, const MapTable *table, const uint64_t hash, const size_t index) {
+    const uint64_t length = ((index - map_home(table, hash)) & (table->cap - 1)) + 1;
+    DS_STAT_ADD_SHARED(map->stat_probes, 1);
+    DS_STAT_ADD_SHARED(map->stat_probe_slots, length);
+    DS_STAT_MAX_SHARED(map->stat_probe_max, length);
+}
+#define MAP_COUNT_PROBE(map, table, hash, index) map_count_probe(map, table, hash, index)
+#else
+#define MAP_COUNT_PROBE(map, table, hash, index) ((void)0)
+#endif
+
+/// Look for [key] with the given [hash] in [table]
 ///
-/// Parameters:
-/// - void *: old pointer
-/// - size_t: amount of bytes needed
-typedef void (*MapCallocFn)(size_t);
+/// Returns:
+///   the index of the slot holding [key] if it was found. Otherwise [found]
+///   is 0 and the first empty slot of the run is returned.
+static size_t map_find(const Map *map, const MapTable *table, const void *key, const uint64_t hash, int *found) {
+    const size_t mask = table->cap - 1;
+    const uint8_t tag = map_tag(hash);
+    size_t pos = map_home(table, hash);
+
+    while (1) {
+        const uint8_t *group = table->ctrl + pos;
+        unsigned matches = map_group_match(group, tag);
+        const unsigned empties = map_group_match(group, MAP_EMPTY);
+
+        // Keys can only be found before the first empty slot
+        if (empties != 0) {
+            matches &= (empties & (~empties + 1)) - 1;
+        }
+
+        while (matches != 0) {
+            const size_t index = (pos + map_lowest_bit(matches)) & mask;
+            if (map_key_equal(map, map_slot(map, table, index), key)) {
+                MAP_COUNT_PROBE(map, table, hash, index);
+                *found = 1;
+                return index;
+            }
+            matches &= matches - 1;
+        }
+
+        if (empties != 0) {
+            const size_t index = (pos + map_lowest_bit(empties)) & mask;
+            MAP_COUNT_PROBE(map, table, hash, index);
+            *found = 0;
+            return index;
+        }
+        pos = (pos + MAP_GROUP_WIDTH) & mask;
+    }
+}
+
+
+
+/// Bytes of a table of [cap] slots
+static size_t map_table_bytes(const Map *map, const size_t cap, const int cache) {
+    return cap * map->slot_size + cap + MAP_GROUP_WIDTH + (cache ? cap : 0);
+}
+
+/// Allocate an empty table of [cap] slots
+static int map_alloc_table(const Map *map, MapTable *table, const size_t cap) {
+    table->slots = ds_state_alloc(&map->heap, map_table_bytes(map, cap, map->cache != NULL));
+    if (table->slots == NULL) {
+        return 0;
+    }
+    table->cap = cap;
+    table->ctrl = (uint8_t *)table->slots + cap * map->slot_size;
+    memset(table->ctrl, MAP_EMPTY, cap + MAP_GROUP_WIDTH);
+    table->ref = NULL;
+    if (map->cache != NULL) {
+        table->ref = table->ctrl + cap + MAP_GROUP_WIDTH;
+        memset(table->ref, 0, cap);
+    }
+    return 1;
+}
+
+static void map_free_table(const Map *map, MapTable *table) {
+    if (table->slots != NULL) {
+        ds_state_free(&map->heap, table->slots, map_table_bytes(map, table->cap, table->ref != NULL));
+    }
+    table->slots = NULL;
+    table->ctrl = NULL;
+    table->cap = 0;
+}
+
+
+
+/// Copy [slot] into an empty slot of the live table
+static char *map_place(Map *map, const char *slot, const uint64_t hash) {
+    int found;
+    const size_t index = map_find(map, &map->table, slot, hash, &found);
+    assert(!found);
+    char *new_slot = map_slot(map, &map->table, index);
+    memcpy(new_slot, slot, map->slot_size);
+    map_set_ctrl(&map->table, index, map_tag(hash));
+    return new_slot;
+}
+
+
+
+/// Move the entry at [index] of the old table into the live table
+static char *map_migrate_slot(Map *map, const size_t index, const uint64_t hash) {
+    char *new_slot = map_place(map, map_slot(map, &map->old, index), hash);
+    map_set_ctrl(&map->old, index, MAP_MOVED);
+    map->old_size--;
+    return new_slot;
+}
 
-/// This type represents functions that are used to free memory
-/// the function 'free' is of this type
+
+
+/// Migrate up to [slots] slots of the old table
 ///
-/// Parameters:
-/// - void *: pointer to memory  to free
-typedef void (*MapFreeFn)(void *);
+/// Returns:
+///   1 if there are still entries left in the old table, 0 otherwise
+static int map_migrate(Map *map, size_t slots) {
+    while (map->old.slots != NULL && slots != 0) {
+        if (map->old_size == 0) {
+            map_free_table(map, &map->old);
+            return 0;
+        }
+        const size_t index = map->migrate_pos++;
+        const uint8_t ctrl = map->old.ctrl[index];
+        if (ctrl != MAP_EMPTY && ctrl != MAP_MOVED) {
+            map_migrate_slot(map, index, map_hash(map, map_slot(map, &map->old, index)));
+        }
+        slots--;
+    }
+    if (map->old.slots != NULL && map->old_size == 0) {
+        map_free_table(map, &map->old);
+    }
+    return map->old.slots != NULL;
+}
 
 
 
-/// This type represents functions that are used for hashing
+/// Make room for one more entry
 ///
-/// Parameters:
-///   - void *: pointer to the beginning of the key
-typedef unsigned int (*MapHashFn)(void *);
+/// If the live table would exceed the load factor, it becomes the old table
+/// and a table of twice the size takes its place. A rehash that is still
+/// running is finished first.
+static int map_reserve_one(Map *map) {
+    if ((map->size + 1) * MAP_LOAD_DEN <= map->table.cap * MAP_LOAD_NUM) {
+        return 1;
+    }
+    map_migrate(map, SIZE_MAX);
+
+    MapTable new_table;
+    if (!map_alloc_table(map, &new_table, map->table.cap * 2)) {
+        return 0;
+    }
+    map->old = map->table;
+    map->old_size = map->size;
+    map->migrate_pos = 0;
+    map->table = new_table;
+    return 1;
+}
+
+
+
+/// Empty the slot at [index] of the live table and shift later entries of
+/// its run back
+static void map_erase_at(Map *map, size_t index) {
+    MapTable *table = &map->table;
+    const size_t mask = table->cap - 1;
+    size_t next = index;
+    while (1) {
+        next = (next + 1) & mask;
+        if (table->ctrl[next] == MAP_EMPTY) {
+            break;
+        }
+
+        // An entry can move back if its home is not between the hole and itself
+        const size_t home = map_home(table, map_hash(map, map_slot(map, table, next)));
+        if (((next - home) & mask) >= ((next - index) & mask)) {
+            memcpy(map_slot(map, table, index), map_slot(map, table, next), map->slot_size);
+            map_set_ctrl(table, index, table->ctrl[next]);
+            if (table->ref != NULL) {
+                table->ref[index] = table->ref[next];
+            }
+            index = next;
+        }
+    }
+    map_set_ctrl(table, index, MAP_EMPTY);
+}
+
+
+/// Evict one entry of a cache
+static void map_cache_evict(Map *map) {
+    MapTable *table = &map->table;
+    MapCache *cache = map->cache;
+    while (1) {
+        const size_t hand = cache->hand;
+        if (table->ctrl[hand] != MAP_EMPTY) {
+            if (table->ref[hand] == 0) {
+                char *slot = map_slot(map, table, hand);
+                if (cache->evict != NULL) {
+                    cache->evict(slot, slot + map->val_offset, cache->ctx);
+                }
+
+                // The hand stays, the next entry of the run may move here
+                map_erase_at(map, hand);
+                map->size--;
+                cache->stats.evictions++;
+                return;
+            }
+            table->ref[hand] = 0;
+        }
+        cache->hand = (hand + 1) & (table->cap - 1);
+    }
+}
+
+
+
+/// Shared by all initializers, the table is left to `map_with_table`
+static Map *map_create(const DsAllocState *heap, const MapHashFn hash, const size_t key_len, const size_t val_len,
+        const int str_keys) {
+    size_t val_offset;
+    size_t slot_size;
+    map_slot_layout(key_len, val_len, &val_offset, &slot_size);
+
+    Map *map = ds_state_alloc(heap, sizeof(Map));
+    if (map == NULL) {
+        return NULL;
+    }
+    map->heap = *heap;
+    map->hash = hash;
+    map->seed = hash_random_seed();
+    map->key_len = key_len;
+    map->val_len = val_len;
+    map->val_offset = val_offset;
+    map->slot_size = slot_size;
+    map->size = 0;
+    map->old.slots = NULL;
+    map->old.ctrl = NULL;
+    map->old.cap = 0;
+    map->old_size = 0;
+    map->migrate_pos = 0;
+    map->str_keys = str_keys;
+    map->arena = NULL;
+    map->cache = NULL;
+    map->table.slots = NULL;
+#if defined(DS_STATS)
+    map->stat_probes = 0;
+    map->stat_probe_slots = 0;
+    map->stat_probe_max = 0;
+#endif
+#if defined(DS_TRACE)
+    map->trace = NULL;
+#endif
+    return map;
+}
+
+/// Give [map] a table of [cap] slots or free it
+static Map *map_with_table(Map *map, const size_t cap) {
+    if (map == NULL) {
+        return NULL;
+    }
+    if (!map_alloc_table(map, &map->table, cap)) {
+        ds_state_free(&map->heap, map->cache, sizeof(MapCache));
+        ds_state_free(&map->heap, map, sizeof(Map));
+        return NULL;
+    }
+    return map;
+}
+
+
+/*********************************** Public ***********************************/
 
 
 Map *map_init(const MapAllocFn alloc, const MapFreeFn dealloc, const MapHashFn hash,
         const size_t key_len, const size_t val_len) {
+    DsAllocState heap;
+    ds_alloc_state_fns(&heap, alloc, dealloc);
+    return map_with_table(map_create(&heap, hash, key_len, val_len, 0), MAP_INIT_CAP);
 }
 
 
 
-/***************************** Pair declarations ******************************/
-/// Pair type
-///
-/// Stores key, value and metadata in one block of memory
-typedef struct pair Pair;
+Map *map_init_alloc(const DsAllocator *allocator, const MapHashFn hash, const size_t key_len, const size_t val_len) {
+    DsAllocState heap;
+    ds_alloc_state_init(&heap, allocator);
+    return map_with_table(map_create(&heap, hash, key_len, val_len, 0), MAP_INIT_CAP);
+}
 
 
-/// Initialize a pair
-///
-/// This function initializes a Pair by allocating memory for it 
-/// according to [map]'s alloc function
-///
-/// Parameters:
-///   - map: pointer to a map that was retunred by map_init();
-///   - k_ptr: pointer to a key
-///   - v_ptr: pointer to the value
-///
-/// Returns:
-///   A pointer to a pair that needs to be freed by `pair_free`
-static Pair *pair_init(const Map *map, const void *k_ptr, const void *v_ptr);
 
-/// Free a pair
-///
-/// This function frees a Pair by freeing the memory allocated to it
-/// according to [map]'s dealloc function
-///
-/// Parameters:
-///   - map: pointer to a map that was retunred by map_init();
-///   - pair: Pointer to a pair returned by `pair_init()`
-static void pair_free(const Map *map, Pair *pair);
-/***************************** Map implementation *****************************/
-struct map {
-    const MapAllocFn alloc; /* Nonnull */
-    const MapFreeFn dealloc; /* Nonnull */
-    const MapHashFn hash; /* Nonnull */
-    const size_t key_len;
-    const size_t val_len;
-    Pair **table; /* Nonnull */
-};
+Map *map_init_str(const MapAllocFn alloc, const MapFreeFn dealloc, const MapHashFn hash, const size_t val_len) {
+    DsAllocState heap;
+    ds_alloc_state_fns(&heap, alloc, dealloc);
+    return map_with_table(map_create(&heap, hash, sizeof(MapStrKey), val_len, 1), MAP_INIT_CAP);
+}
 
 
-/**************************** Pair implementation *****************************/
 
-struct pair {
-    void *key;
-    void *value;
-    size_t key_len;
-    size_t val_len;
-};
+Map *map_init_str_alloc(const DsAllocator *allocator, const MapHashFn hash, const size_t val_len) {
+    DsAllocState heap;
+    ds_alloc_state_init(&heap, allocator);
+    return map_with_table(map_create(&heap, hash, sizeof(MapStrKey), val_len, 1), MAP_INIT_CAP);
+}
 
 
 
-static Pair *pair_init(const Map *map, const void *k_ptr, const void *v_ptr) {
-    // If Map was NULL something went wrong
+Map *map_init_cache(const MapAllocFn alloc, const MapFreeFn dealloc, const MapHashFn hash,
+        const size_t key_len, const size_t val_len, const size_t max_entries, const size_t max_bytes,
+        const MapEvictFn evict, void *ctx) {
+    // Sanity check
+    if (max_entries == 0 && max_bytes == 0) {
+        return NULL;
+    }
+
+    DsAllocState heap;
+    ds_alloc_state_fns(&heap, alloc, dealloc);
+    Map *map = map_create(&heap, hash, key_len, val_len, 0);
     if (map == NULL) {
-        fprintf(stderr,"map was NULL in %s:%d", __FILE__, __LINE__);
         return NULL;
     }
+    map->cache = ds_state_alloc(&map->heap, sizeof(MapCache));
+    if (map->cache == NULL) {
+        ds_state_free(&map->heap, map, sizeof(Map));
+        return NULL;
+    }
+
+    // Smallest table that holds max_entries, largest one that fits max_bytes
+    const size_t max_cap = SIZE_MAX / 4 / map->slot_size;
+    size_t cap = MAP_INIT_CAP;
+    if (max_entries != 0) {
+        while (cap / MAP_LOAD_DEN * MAP_LOAD_NUM < max_entries && cap < max_cap) {
+            cap *= 2;
+        }
+    } else {
+        while (map_table_bytes(map, cap * 2, 1) <= max_bytes && cap < max_cap) {
+            cap *= 2;
+        }
+    }
+    while (max_bytes != 0 && cap > MAP_INIT_CAP && map_table_bytes(map, cap, 1) > max_bytes) {
+        cap /= 2;
+    }
+
+    const size_t limit = cap / MAP_LOAD_DEN * MAP_LOAD_NUM;
+    map->cache->max_entries = max_entries != 0 && max_entries < limit ? max_entries : limit;
+    map->cache->hand = 0;
+    map->cache->evict = evict;
+    map->cache->ctx = ctx;
+    memset(&map->cache->stats, 0, sizeof(map->cache->stats));
+    return map_with_table(map, cap);
+}
+
+
+
+void *map_put_hashed(Map *map, const void *key, const uint64_t hash, const void *value) {
+    map_migrate(map, MAP_MIGRATE_SLOTS);
+
+    int found;
+    size_t index = map_find(map, &map->table, key, hash, &found);
+    char *slot = map_slot(map, &map->table, index);
+
+    if (!found && map->old.slots != NULL) {
+        // Still in the old table, move it over right away
+        const size_t old_index = map_find(map, &map->old, key, hash, &found);
+        if (found) {
+            slot = map_migrate_slot(map, old_index, hash);
+        }
+    }
+
+    if (found && map->cache != NULL) {
+        map->table.ref[index] = 1;
+    }
+
+    if (!found) {
+        MapStrKey stored;
+        if (map->str_keys && ((const MapStrKey *)key)->bytes[MAP_STR_INLINE] == MAP_STR_EXTERNAL) {
+            // The key refers to the bytes of the caller, keep a copy
+            stored = *(const MapStrKey *)key;
+            if (!map_arena_store(map, &stored)) {
+                return NULL;
+            }
+            key = &stored;
+        }
+        if (map->cache != NULL) {
+            // Fixed table, make room by eviction
+            if (map->size >= map->cache->max_entries) {
+                map_cache_evict(map);
+            }
+        } else if (!map_reserve_one(map)) {
+            return NULL;
+        }
+        index = map_find(map, &map->table, key, hash, &found);
+        slot = map_slot(map, &map->table, index);
+        memcpy(slot, key, map->key_len);
+        memset(slot + map->key_len, 0, map->slot_size - map->key_len);
+        map_set_ctrl(&map->table, index, map_tag(hash));
+        if (map->cache != NULL) {
+            map->table.ref[index] = 0;
+        }
+        map->size++;
+    }
+
+    char *val_ptr = slot + map->val_offset;
+    if (value != NULL) {
+        memcpy(val_ptr, value, map->val_len);
+    }
+    return val_ptr;
+}
 
-    // Determine size of memory to be allocated
-    const size_t alloc_sz = map->key_len + map->val_len + sizeof(Pair);
 
-    Pair *new_pair = map->alloc(alloc_sz);
-    if (map->alloc == NULL) {
-        fprintf(stderr,"Memory allocation failed in %s:%d", __FILE__, __LINE__);
+
+void *map_get_hashed(const Map *map, const void *key, const uint64_t hash) {
+    int found;
+    size_t index = map_find(map, &map->table, key, hash, &found);
+    if (map->cache != NULL) {
+        // Caches never have an old table
+        if (found) {
+            map->table.ref[index] = 1;
+            map->cache->stats.hits++;
+            return map_slot(map, &map->table, index) + map->val_offset;
+        }
+        map->cache->stats.misses++;
         return NULL;
     }
+    if (found) {
+        return map_slot(map, &map->table, index) + map->val_offset;
+    }
+
+    if (map->old.slots != NULL) {
+        index = map_find(map, &map->old, key, hash, &found);
+        if (found) {
+            return map_slot(map, &map->old, index) + map->val_offset;
+        }
+    }
+    return NULL;
+}
+
 
-    // Get pointer to key
-    void *key_ptr = new_pair + 1;
 
-    // Get pointer to value
-    void *val_ptr = (char *)key_ptr + map->key_len;
+int map_remove_hashed(Map *map, const void *key, const uint64_t hash) {
+    map_migrate(map, MAP_MIGRATE_SLOTS);
 
-    // Copy key
-    memcpy(key_ptr, k_ptr, map->key_len);
+    int found;
+    size_t index = map_find(map, &map->table, key, hash, &found);
+    if (found) {
+        map_erase_at(map, index);
+        map->size--;
+        return 1;
+    }
 
-    // Copy value
-    memcpy(val_ptr, v_ptr, map->val_len);
+    if (map->old.slots != NULL) {
+        index = map_find(map, &map->old, key, hash, &found);
+        if (found) {
+            map_set_ctrl(&map->old, index, MAP_MOVED);
+            map->old_size--;
+            map->size--;
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    // Assign values
-    new_pair->val_len = map->val_len;
-    new_pair->key_len = map->key_len;
-    new_pair->key = key_ptr;
-    new_pair->value = val_ptr;
 
 
-    return new_pair;
+void *map_put(Map *map, const void *key, const void *value) {
+    // Sanity check
+    if (map == NULL || key == NULL || map->str_keys) {
+        return NULL;
+    }
+    DS_TRACE_RECORD(map->trace, DS_TRACE_MAP, DS_TRACE_INSERT, ds_trace_key(key, map->key_len), map->val_len);
+    return map_put_hashed(map, key, map_hash(map, key), value);
 }
 
 
 
-static void pair_free(const Map *map, Pair *pair) {
-    // If Map was NULL something went wrong
-    if (map == NULL) {
-        fprintf(stderr,"map was NULL in %s:%d", __FILE__, __LINE__);
+void *map_get(const Map *map, const void *key) {
+    // Sanity check
+    if (map == NULL || key == NULL || map->str_keys) {
+        return NULL;
+    }
+    DS_TRACE_RECORD(map->trace, DS_TRACE_MAP, DS_TRACE_FIND, ds_trace_key(key, map->key_len), 0);
+    return map_get_hashed(map, key, map_hash(map, key));
+}
+
+
+
+int map_remove(Map *map, const void *key) {
+    // Sanity check
+    if (map == NULL || key == NULL || map->str_keys) {
+        return 0;
+    }
+    DS_TRACE_RECORD(map->trace, DS_TRACE_MAP, DS_TRACE_REMOVE, ds_trace_key(key, map->key_len), 0);
+    return map_remove_hashed(map, key, map_hash(map, key));
+}
+
+
+
+size_t map_get_batch(const Map *map, const void *keys, const size_t n, void **out) {
+    // Sanity check
+    if (map == NULL || (keys == NULL && n != 0) || out == NULL || map->str_keys) {
+        return 0;
+    }
+
+    const char *key_bytes = keys;
+    size_t found = 0;
+    uint64_t hashes[MAP_BATCH];
+    for (size_t start = 0; start < n; start += MAP_BATCH) {
+        const size_t count = n - start < MAP_BATCH ? n - start : MAP_BATCH;
+
+        // Hash and prefetch all keys of the batch, so their misses overlap
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = map_hash(map, key_bytes + (start + i) * map->key_len);
+            map_prefetch(map, &map->table, hashes[i]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            DS_TRACE_RECORD(map->trace, DS_TRACE_MAP, DS_TRACE_FIND,
+                    ds_trace_key(key_bytes + (start + i) * map->key_len, map->key_len), 0);
+            out[start + i] = map_get_hashed(map, key_bytes + (start + i) * map->key_len, hashes[i]);
+            found += out[start + i] != NULL;
+        }
+    }
+    return found;
+}
+
+
+
+size_t map_put_batch(Map *map, const void *keys, const void *values, const size_t n) {
+    // Sanity check
+    if (map == NULL || (keys == NULL && n != 0) || map->str_keys) {
+        return 0;
+    }
+
+    const char *key_bytes = keys;
+    const char *val_bytes = values;
+    size_t stored = 0;
+    uint64_t hashes[MAP_BATCH];
+    for (size_t start = 0; start < n; start += MAP_BATCH) {
+        const size_t count = n - start < MAP_BATCH ? n - start : MAP_BATCH;
+
+        // A resize in the middle only makes some prefetches useless
+        for (size_t i = 0; i < count; ++i) {
+            hashes[i] = map_hash(map, key_bytes + (start + i) * map->key_len);
+            map_prefetch(map, &map->table, hashes[i]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const void *value = val_bytes == NULL ? NULL : val_bytes + (start + i) * map->val_len;
+            DS_TRACE_RECORD(map->trace, DS_TRACE_MAP, DS_TRACE_INSERT,
+                    ds_trace_key(key_bytes + (start + i) * map->key_len, map->key_len), map->val_len);
+            stored += map_put_hashed(map, key_bytes + (start + i) * map->key_len, hashes[i], value) != NULL;
+        }
+    }
+    return stored;
+}
+
+
+
+void map_set_seed(Map *map, const uint64_t seed) {
+    assert(map->size == 0);
+    map->seed = seed;
+}
+
+
+
+void *map_put_str(Map *map, const void *key, const size_t len, const void *value) {
+    // Sanity check
+    if (map == NULL || !map->str_keys || (key == NULL && len != 0) || len > UINT32_MAX) {
+        return NULL;
+    }
+    MapStrKey str_key;
+    DS_TRACE_RECORD(map->trace, DS_TRACE_MAP, DS_TRACE_INSERT, ds_trace_key(key, len), map->val_len);
+    map_str_key(map, &str_key, key, len);
+    return map_put_hashed(map, &str_key, str_key.hash, value);
+}
+
+
+
+void *map_get_str(const Map *map, const void *key, const size_t len) {
+    // Sanity check
+    if (map == NULL || !map->str_keys || (key == NULL && len != 0) || len > UINT32_MAX) {
+        return NULL;
+    }
+    MapStrKey str_key;
+    DS_TRACE_RECORD(map->trace, DS_TRACE_MAP, DS_TRACE_FIND, ds_trace_key(key, len), 0);
+    map_str_key(map, &str_key, key, len);
+    return map_get_hashed(map, &str_key, str_key.hash);
+}
+
+
+
+int map_remove_str(Map *map, const void *key, const size_t len) {
+    // Sanity check
+    if (map == NULL || !map->str_keys || (key == NULL && len != 0) || len > UINT32_MAX) {
+        return 0;
+    }
+    MapStrKey str_key;
+    DS_TRACE_RECORD(map->trace, DS_TRACE_MAP, DS_TRACE_REMOVE, ds_trace_key(key, len), 0);
+    map_str_key(map, &str_key, key, len);
+    return map_remove_hashed(map, &str_key, str_key.hash);
+}
+
+
+
+void map_cache_stats(const Map *map, MapCacheStats *stats) {
+    // Sanity check
+    if (stats == NULL) {
         return;
     }
-    // Free the pair
-    map->dealloc(pair);
+    if (map == NULL || map->cache == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    *stats = map->cache->stats;
 }
 
 
 
+int map_rehash_step(Map *map, const size_t slots) {
+    // Sanity check
+    if (map == NULL) {
+        return 0;
+    }
+    return map_migrate(map, slots);
+}
 
 
 
+size_t map_size(const Map *map) {
+    if (map == NULL) {
+        return 0;
+    }
+    return map->size;
+}
 
 
 
+void map_stats(const Map *map, MapStats *stats) {
+    // Sanity check
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (map == NULL) {
+        return;
+    }
 
+#if defined(DS_STATS)
+    stats->counting = 1;
+    stats->probes = map->stat_probes;
+    stats->probe_slots = map->stat_probe_slots;
+    stats->max_probe = map->stat_probe_max;
+#endif
+    ds_alloc_state_stats(&map->heap, &stats->alloc);
+    stats->size = map->size;
+    stats->capacity = map->table.cap;
+    stats->table_bytes = map_table_bytes(map, map->table.cap, map->table.ref != NULL);
+    if (map->old.slots != NULL) {
+        stats->table_bytes += map_table_bytes(map, map->old.cap, map->old.ref != NULL);
+    }
 
+    // Distance of every entry of the live table from its home slot
+    const MapTable *table = &map->table;
+    uint64_t total = 0;
+    size_t entries = 0;
+    for (size_t i = 0; i < table->cap; ++i) {
+        if (table->ctrl[i] == MAP_EMPTY) {
+            continue;
+        }
+        const size_t home = map_home(table, map_hash(map, map_slot(map, table, i)));
+        const size_t displacement = (i - home) & (table->cap - 1);
+        if (displacement > stats->max_displacement) {
+            stats->max_displacement = displacement;
+        }
+        total += displacement;
+        entries++;
+    }
+    stats->avg_displacement = entries == 0 ? 0 : (double)total / (double)entries;
+}
+
+
+
+int map_set_trace(Map *map, DsTrace *trace) {
+    // Sanity check
+    if (map == NULL) {
+        return 0;
+    }
+
+#if defined(DS_TRACE)
+    map->trace = trace;
+    return 1;
+#else
+    (void)trace;
+    return 0;
+#endif
+}
+
+
+
+void map_free(Map *map) {
+    // Sanity check
+    if (map == NULL) {
+        return;
+    }
+
+    // Remaining entries of a cache are handed to the callback as well
+    if (map->cache != NULL) {
+        if (map->cache->evict != NULL) {
+            for (size_t i = 0; i < map->table.cap; ++i) {
+                if (map->table.ctrl[i] != MAP_EMPTY) {
+                    char *slot = map_slot(map, &map->table, i);
+                    map->cache->evict(slot, slot + map->val_offset, map->cache->ctx);
+                }
+            }
+        }
+        ds_state_free(&map->heap, map->cache, sizeof(MapCache));
+    }
+
+    const DsAllocState heap = map->heap;
+    map_arena_free(map);
+    map_free_table(map, &map->old);
+    map_free_table(map, &map->table);
+    ds_state_free(&heap, map, sizeof(Map));
+}
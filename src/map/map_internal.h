@@ -0,0 +1,53 @@
+#ifndef JAZZY_MAP_INTERNAL_H
+#define JAZZY_MAP_INTERNAL_H
+
+// Header file
+#include "../../include/map.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// Slot layout and map operations on an already computed hash. This is
+/// shared between the source files in src/map and is not part of the public
+/// interface.
+
+
+/// Alignment of a member of [size] bytes, capped at 8
+static inline size_t map_align_of(const size_t size) {
+    size_t align = size == 0 ? 1 : size & (~size + 1);
+    return align > sizeof(uint64_t) ? sizeof(uint64_t) : align;
+}
+
+/// Slot layout is key, padding, value, padding like a struct
+static inline void map_slot_layout(const size_t key_len, const size_t val_len, size_t *val_offset,
+        size_t *slot_size) {
+    const size_t val_align = map_align_of(val_len);
+    const size_t key_align = map_align_of(key_len);
+    const size_t slot_align = val_align > key_align ? val_align : key_align;
+    *val_offset = (key_len + val_align - 1) & ~(val_align - 1);
+    *slot_size = (*val_offset + val_len + slot_align - 1) & ~(slot_align - 1);
+    if (*slot_size == 0) {
+        *slot_size = 1;
+    }
+}
+
+
+
+/// Hash [key] the way [map] does
+uint64_t map_hash(const Map *map, const void *key);
+
+/// Replace the seed of an empty [map]
+void map_set_seed(Map *map, uint64_t seed);
+
+/// `map_put` with the hash of [key] computed by `map_hash`
+void *map_put_hashed(Map *map, const void *key, uint64_t hash, const void *value);
+
+/// `map_get` with the hash of [key] computed by `map_hash`
+void *map_get_hashed(const Map *map, const void *key, uint64_t hash);
+
+/// `map_remove` with the hash of [key] computed by `map_hash`
+int map_remove_hashed(Map *map, const void *key, uint64_t hash);
+
+#endif
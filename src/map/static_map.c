@@ -0,0 +1,661 @@
+// Needed for mmap
+#define _POSIX_C_SOURCE 200809L
+
+// Header file
+#include "../../include/map.h"
+#include "../../include/hash.h"
+#include "../common/snapshot.h"
+#include "map_internal.h"
+
+// Libraries
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/********************************** Private ***********************************/
+
+/// The index is a minimal perfect hash in the style of PTHash. Keys are
+/// split into buckets of about STATIC_MAP_BUCKET_KEYS keys by their hash,
+/// 60% of the keys go to the first 30% of the buckets. Every bucket gets a
+/// 16 bit pilot, which moves all keys of the bucket to free positions:
+///
+///   position = reduce((hash ^ hash_u64(pilot, seed)) * odd, table_size)
+///
+/// where reduce maps a 64 bit value to [0, table_size) by its top bits,
+/// with a multiply instead of a division. The top bits of the hash also pick
+/// the bucket, the multiplication by an odd constant mixes all bits of the
+/// hash into them.
+///
+/// Buckets are placed from the largest to the smallest while the table is
+/// still empty enough for them. The table has about 1% more positions than
+/// keys. The keys that land past the end are redirected to the free
+/// positions below it, so the slots are exactly as many as the keys.
+///
+/// The file and the memory of a static map have the same layout, so a file
+/// can be used in place after mmap:
+///
+///   DsSnapshotHeader | StaticMapParams | pilots | remap | slots
+///
+/// Each part is padded to 8 bytes. The checksum covers everything after the
+/// header.
+
+
+/// Average amount of keys per bucket
+#define STATIC_MAP_BUCKET_KEYS 5
+
+/// Hashes with the low 32 bits below this go to the dense buckets, 60%
+#define STATIC_MAP_DENSE_THRESHOLD 2576980378u
+
+/// Seeds tried before the construction gives up
+#define STATIC_MAP_ATTEMPTS 16
+
+/// Odd constant of the position
+#define STATIC_MAP_MIX 0x9E3779B97F4A7C15ull
+
+/// Pilots tried per bucket before a new seed is picked
+#define STATIC_MAP_MAX_PILOT 65535
+
+
+typedef struct {
+    uint64_t seed;
+    uint64_t buckets;
+    uint64_t dense_buckets; /* The first 30% of the buckets, 0 for few keys */
+    uint64_t table_size; /* Positions, at least the amount of keys */
+    uint64_t remap_count; /* table_size - count */
+    uint64_t val_offset;
+    uint64_t slot_size;
+    uint64_t reserved;
+} StaticMapParams;
+
+
+struct static_map {
+    MapFreeFn dealloc; /* Nonnull */
+    size_t key_len;
+    size_t val_len;
+    size_t size;
+    StaticMapParams params;
+    const uint16_t *pilots;
+    const uint32_t *remap;
+    const char *slots;
+    void *body; /* Allocation or mapping the pointers above point into */
+    size_t body_len;
+    void *map_base; /* Start of the mapping, NULL if the body was allocated */
+    size_t map_len;
+};
+
+
+
+static size_t static_map_pad(const size_t len) {
+    return (len + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+/// Bytes after the snapshot header
+static size_t static_map_body_len(const StaticMapParams *params, const size_t count) {
+    return sizeof(StaticMapParams) + static_map_pad(params->buckets * sizeof(uint16_t)) +
+        static_map_pad(params->remap_count * sizeof(uint32_t)) + static_map_pad(count * params->slot_size);
+}
+
+
+
+static uint64_t static_map_hash(const void *key, const size_t key_len, const uint64_t seed) {
+    if (key_len == sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, key, sizeof(word));
+        return hash_u64(word, seed);
+    }
+    if (key_len == sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, key, sizeof(word));
+        return hash_u32(word, seed);
+    }
+    return hash_bytes(key, key_len, seed);
+}
+
+static size_t static_map_bucket(const StaticMapParams *params, const uint64_t hash) {
+    const uint64_t high = hash >> 32;
+    if (params->dense_buckets == 0) {
+        return high % params->buckets;
+    }
+    if ((uint32_t)hash < STATIC_MAP_DENSE_THRESHOLD) {
+        return high % params->dense_buckets;
+    }
+    return params->dense_buckets + high % (params->buckets - params->dense_buckets);
+}
+
+/// High 64 bits of [value] * [range], which is in [0, range)
+static size_t static_map_reduce(const uint64_t value, const uint64_t range) {
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 static_map_u128;
+    return (size_t)(((static_map_u128)value * range) >> 64);
+#else
+    const uint64_t hv = value >> 32, lv = (uint32_t)value;
+    const uint64_t hr = range >> 32, lr = (uint32_t)range;
+    const uint64_t mid = ((lv * lr) >> 32) + (uint32_t)(hv * lr) + (uint32_t)(lv * hr);
+    return (size_t)(hv * hr + ((hv * lr) >> 32) + ((lv * hr) >> 32) + (mid >> 32));
+#endif
+}
+
+/// [pilot_hash] is hash_u64(pilot, seed)
+static size_t static_map_position(const StaticMapParams *params, const uint64_t hash, const uint64_t pilot_hash) {
+    return static_map_reduce((hash ^ pilot_hash) * STATIC_MAP_MIX, params->table_size);
+}
+
+
+
+/// Point [map] into [body] after checking that its layout adds up
+static int static_map_attach(StaticMap *map, void *body, const size_t body_len) {
+    if (body_len < sizeof(StaticMapParams)) {
+        return 0;
+    }
+    memcpy(&map->params, body, sizeof(StaticMapParams));
+    const StaticMapParams *params = &map->params;
+
+    size_t val_offset;
+    size_t slot_size;
+    map_slot_layout(map->key_len, map->val_len, &val_offset, &slot_size);
+    if (params->val_offset != val_offset || params->slot_size != slot_size || params->buckets == 0 ||
+            params->dense_buckets >= params->buckets || params->table_size < map->size ||
+            params->remap_count != params->table_size - map->size ||
+            params->buckets > SIZE_MAX / sizeof(uint16_t) || map->size > SIZE_MAX / slot_size ||
+            static_map_body_len(params, map->size) != body_len) {
+        return 0;
+    }
+
+    char *bytes = (char *)body + sizeof(StaticMapParams);
+    map->pilots = (const uint16_t *)bytes;
+    bytes += static_map_pad(params->buckets * sizeof(uint16_t));
+    map->remap = (const uint32_t *)bytes;
+    bytes += static_map_pad(params->remap_count * sizeof(uint32_t));
+    map->slots = bytes;
+    map->body = body;
+    map->body_len = body_len;
+    return 1;
+}
+
+
+
+/// Scratch memory of the construction
+typedef struct {
+    MapAllocFn alloc;
+    MapFreeFn dealloc;
+    uint64_t *hashes; /* Per key */
+    uint32_t *bucket_keys; /* Keys ordered by bucket */
+    size_t *bucket_start; /* buckets + 1 offsets into bucket_keys */
+    uint32_t *bucket_order; /* Buckets from largest to smallest */
+    uint32_t *positions; /* Per key */
+    uint16_t *pilots; /* Per bucket */
+    uint64_t *taken; /* Bitmap of table_size bits */
+    uint64_t *pilot_hashes; /* hash_u64 of every pilot */
+} StaticMapBuild;
+
+
+/// Outcome of one attempt
+typedef enum {
+    STATIC_MAP_OK,
+    STATIC_MAP_RETRY, /* Try another seed */
+    STATIC_MAP_DUPLICATE, /* Two keys are equal */
+    STATIC_MAP_NO_MEMORY,
+} StaticMapResult;
+
+
+/// Find pilots for all buckets with the seed in [params]
+static StaticMapResult static_map_place(const StaticMapParams *params, StaticMapBuild *build, const char *keys,
+        const size_t n, const size_t key_len) {
+    for (size_t i = 0; i < n; ++i) {
+        build->hashes[i] = static_map_hash(keys + i * key_len, key_len, params->seed);
+    }
+    for (size_t pilot = 0; pilot <= STATIC_MAP_MAX_PILOT; ++pilot) {
+        build->pilot_hashes[pilot] = hash_u64(pilot, params->seed);
+    }
+
+    // Counting sort of the keys by bucket
+    memset(build->bucket_start, 0, (params->buckets + 1) * sizeof(size_t));
+    size_t max_size = 0;
+    for (size_t i = 0; i < n; ++i) {
+        build->bucket_start[static_map_bucket(params, build->hashes[i]) + 1]++;
+    }
+    for (size_t b = 0; b < params->buckets; ++b) {
+        if (build->bucket_start[b + 1] > max_size) {
+            max_size = build->bucket_start[b + 1];
+        }
+        build->bucket_start[b + 1] += build->bucket_start[b];
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const size_t b = static_map_bucket(params, build->hashes[i]);
+        build->bucket_keys[build->bucket_start[b]++] = (uint32_t)i;
+    }
+    for (size_t b = params->buckets; b > 0; --b) {
+        build->bucket_start[b] = build->bucket_start[b - 1];
+    }
+    build->bucket_start[0] = 0;
+
+    // Counting sort of the buckets by size, largest first
+    size_t *size_start = build->alloc((max_size + 2) * sizeof(size_t));
+    if (size_start == NULL) {
+        return STATIC_MAP_NO_MEMORY;
+    }
+    memset(size_start, 0, (max_size + 2) * sizeof(size_t));
+    for (size_t b = 0; b < params->buckets; ++b) {
+        size_start[max_size - (build->bucket_start[b + 1] - build->bucket_start[b]) + 1]++;
+    }
+    for (size_t s = 0; s <= max_size; ++s) {
+        size_start[s + 1] += size_start[s];
+    }
+    for (size_t b = 0; b < params->buckets; ++b) {
+        build->bucket_order[size_start[max_size - (build->bucket_start[b + 1] - build->bucket_start[b])]++] = (uint32_t)b;
+    }
+    build->dealloc(size_start);
+
+    memset(build->taken, 0, ((params->table_size + 63) / 64) * sizeof(uint64_t));
+    for (size_t o = 0; o < params->buckets; ++o) {
+        const size_t b = build->bucket_order[o];
+        const uint32_t *members = build->bucket_keys + build->bucket_start[b];
+        const size_t count = build->bucket_start[b + 1] - build->bucket_start[b];
+        build->pilots[b] = 0;
+        if (count == 0) {
+            continue;
+        }
+
+        // Keys with the same hash can never be separated
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = i + 1; j < count; ++j) {
+                if (build->hashes[members[i]] == build->hashes[members[j]]) {
+                    if (memcmp(keys + members[i] * key_len, keys + members[j] * key_len, key_len) == 0) {
+                        return STATIC_MAP_DUPLICATE;
+                    }
+                    return STATIC_MAP_RETRY;
+                }
+            }
+        }
+
+        size_t pilot = 0;
+        for (; pilot <= STATIC_MAP_MAX_PILOT; ++pilot) {
+            size_t placed = 0;
+            for (; placed < count; ++placed) {
+                const size_t pos = static_map_position(params, build->hashes[members[placed]],
+                        build->pilot_hashes[pilot]);
+                if (build->taken[pos / 64] & ((uint64_t)1 << (pos % 64))) {
+                    break;
+                }
+                build->taken[pos / 64] |= (uint64_t)1 << (pos % 64);
+                build->positions[members[placed]] = (uint32_t)pos;
+            }
+            if (placed == count) {
+                break;
+            }
+
+            // Undo the keys of this bucket that were placed
+            while (placed > 0) {
+                const size_t pos = build->positions[members[--placed]];
+                build->taken[pos / 64] &= ~((uint64_t)1 << (pos % 64));
+            }
+        }
+        if (pilot > STATIC_MAP_MAX_PILOT) {
+            return STATIC_MAP_RETRY;
+        }
+        build->pilots[b] = (uint16_t)pilot;
+    }
+    return STATIC_MAP_OK;
+}
+
+
+/*********************************** Public ***********************************/
+
+
+StaticMap *map_build_static(const MapAllocFn alloc, const MapFreeFn dealloc, const void *keys, const void *values,
+        const size_t n, const size_t key_len, const size_t val_len) {
+    // Sanity check
+    if ((keys == NULL && n != 0) || key_len == 0 || (values == NULL && val_len != 0 && n != 0)) {
+        return NULL;
+    }
+
+    // Positions are stored as uint32_t
+    const uint64_t table_size = (uint64_t)n + n / 100 + 1;
+    if (table_size > UINT32_MAX) {
+        return NULL;
+    }
+
+    // Check if alloc and free could be NULL
+    MapAllocFn local_alloc = alloc;
+    MapFreeFn local_free = dealloc;
+    if (alloc == NULL || dealloc == NULL) {
+        local_alloc = malloc;
+        local_free = free;
+    }
+
+    StaticMapParams params;
+    memset(&params, 0, sizeof(params));
+    params.buckets = n / STATIC_MAP_BUCKET_KEYS + 1;
+    params.dense_buckets = params.buckets >= 4 ? params.buckets * 3 / 10 : 0;
+    params.table_size = table_size;
+    params.remap_count = params.table_size - n;
+    size_t val_offset;
+    size_t slot_size;
+    map_slot_layout(key_len, val_len, &val_offset, &slot_size);
+    params.val_offset = val_offset;
+    params.slot_size = slot_size;
+
+    StaticMapBuild build;
+    build.alloc = local_alloc;
+    build.dealloc = local_free;
+    build.hashes = local_alloc(n * sizeof(uint64_t) + 1);
+    build.bucket_keys = local_alloc(n * sizeof(uint32_t) + 1);
+    build.bucket_start = local_alloc((params.buckets + 1) * sizeof(size_t));
+    build.bucket_order = local_alloc(params.buckets * sizeof(uint32_t));
+    build.positions = local_alloc(n * sizeof(uint32_t) + 1);
+    build.pilots = local_alloc(params.buckets * sizeof(uint16_t));
+    build.taken = local_alloc((params.table_size + 63) / 64 * sizeof(uint64_t));
+    build.pilot_hashes = local_alloc((STATIC_MAP_MAX_PILOT + 1) * sizeof(uint64_t));
+
+    StaticMapResult result = STATIC_MAP_RETRY;
+    if (build.hashes != NULL && build.bucket_keys != NULL && build.bucket_start != NULL &&
+            build.bucket_order != NULL && build.positions != NULL && build.pilots != NULL && build.taken != NULL &&
+            build.pilot_hashes != NULL) {
+        for (size_t attempt = 0; attempt < STATIC_MAP_ATTEMPTS && result == STATIC_MAP_RETRY; ++attempt) {
+            params.seed = hash_random_seed();
+            result = static_map_place(&params, &build, keys, n, key_len);
+        }
+    }
+
+    StaticMap *map = NULL;
+    void *body = NULL;
+    const size_t body_len = static_map_body_len(&params, n);
+    if (result == STATIC_MAP_OK) {
+        map = local_alloc(sizeof(StaticMap));
+        body = local_alloc(body_len);
+    }
+
+    if (map != NULL && body != NULL) {
+        memset(body, 0, body_len);
+        memcpy(body, &params, sizeof(params));
+        char *bytes = (char *)body + sizeof(params);
+        memcpy(bytes, build.pilots, params.buckets * sizeof(uint16_t));
+        bytes += static_map_pad(params.buckets * sizeof(uint16_t));
+
+        // Positions past the keys go to the free positions below, in order
+        uint32_t *remap = (uint32_t *)bytes;
+        size_t free_pos = 0;
+        for (size_t pos = n; pos < params.table_size; ++pos) {
+            if (build.taken[pos / 64] & ((uint64_t)1 << (pos % 64))) {
+                while (build.taken[free_pos / 64] & ((uint64_t)1 << (free_pos % 64))) {
+                    free_pos++;
+                }
+                remap[pos - n] = (uint32_t)free_pos++;
+            }
+        }
+        bytes += static_map_pad(params.remap_count * sizeof(uint32_t));
+
+        for (size_t i = 0; i < n; ++i) {
+            size_t pos = build.positions[i];
+            if (pos >= n) {
+                pos = remap[pos - n];
+            }
+            char *slot = bytes + pos * slot_size;
+            memcpy(slot, (const char *)keys + i * key_len, key_len);
+            if (val_len != 0) {
+                memcpy(slot + val_offset, (const char *)values + i * val_len, val_len);
+            }
+        }
+
+        map->dealloc = local_free;
+        map->key_len = key_len;
+        map->val_len = val_len;
+        map->size = n;
+        map->map_base = NULL;
+        map->map_len = 0;
+        static_map_attach(map, body, body_len);
+    } else {
+        if (map != NULL) {
+            local_free(map);
+            map = NULL;
+        }
+        if (body != NULL) {
+            local_free(body);
+        }
+    }
+
+    if (build.hashes != NULL) {
+        local_free(build.hashes);
+    }
+    if (build.bucket_keys != NULL) {
+        local_free(build.bucket_keys);
+    }
+    if (build.bucket_start != NULL) {
+        local_free(build.bucket_start);
+    }
+    if (build.bucket_order != NULL) {
+        local_free(build.bucket_order);
+    }
+    if (build.positions != NULL) {
+        local_free(build.positions);
+    }
+    if (build.pilots != NULL) {
+        local_free(build.pilots);
+    }
+    if (build.taken != NULL) {
+        local_free(build.taken);
+    }
+    if (build.pilot_hashes != NULL) {
+        local_free(build.pilot_hashes);
+    }
+    return map;
+}
+
+
+
+const void *static_map_get(const StaticMap *map, const void *key) {
+    // Sanity check
+    if (map == NULL || key == NULL || map->size == 0) {
+        return NULL;
+    }
+
+    const StaticMapParams *params = &map->params;
+    const uint64_t hash = static_map_hash(key, map->key_len, params->seed);
+    const uint16_t pilot = map->pilots[static_map_bucket(params, hash)];
+    size_t pos = static_map_position(params, hash, hash_u64(pilot, params->seed));
+    if (pos >= map->size) {
+        pos = map->remap[pos - map->size];
+    }
+
+    // Keys that are not in the set land on some other key
+    const char *slot = map->slots + pos * params->slot_size;
+    if (memcmp(slot, key, map->key_len) != 0) {
+        return NULL;
+    }
+    return slot + params->val_offset;
+}
+
+
+
+size_t static_map_size(const StaticMap *map) {
+    if (map == NULL) {
+        return 0;
+    }
+    return map->size;
+}
+
+
+
+size_t static_map_bytes(const StaticMap *map) {
+    if (map == NULL) {
+        return 0;
+    }
+    return sizeof(DsSnapshotHeader) + map->body_len;
+}
+
+
+
+int static_map_save(const StaticMap *map, const char *path) {
+    // Sanity check
+    if (map == NULL || path == NULL) {
+        return -1;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    DsSnapshotHeader header;
+    ds_snapshot_header_init(&header, DS_SNAPSHOT_MAGIC_STATIC_MAP, map->params.slot_size, map->key_len,
+            map->val_len, map->size);
+    DsChecksum sum;
+    ds_checksum_init(&sum);
+    ds_checksum_update(&sum, map->body, map->body_len);
+    header.checksum = ds_checksum_final(&sum);
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(map->body, map->body_len, 1, file) == 1;
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok ? 0 : -1;
+}
+
+
+
+/// Check the header and checksum of a snapshot and attach [body] to a new map
+static StaticMap *static_map_open(const DsSnapshotHeader *header, void *body, const size_t body_len,
+        const MapAllocFn alloc, const MapFreeFn dealloc) {
+    if (!ds_snapshot_header_ok(header, DS_SNAPSHOT_MAGIC_STATIC_MAP) || header->key_size == 0) {
+        return NULL;
+    }
+    DsChecksum sum;
+    ds_checksum_init(&sum);
+    ds_checksum_update(&sum, body, body_len);
+    if (ds_checksum_final(&sum) != header->checksum) {
+        return NULL;
+    }
+
+    StaticMap *map = alloc(sizeof(StaticMap));
+    if (map == NULL) {
+        return NULL;
+    }
+    map->dealloc = dealloc;
+    map->key_len = header->key_size;
+    map->val_len = header->val_size;
+    map->size = header->count;
+    map->map_base = NULL;
+    map->map_len = 0;
+    if (!static_map_attach(map, body, body_len)) {
+        dealloc(map);
+        return NULL;
+    }
+    return map;
+}
+
+
+
+StaticMap *static_map_load(const char *path, const MapAllocFn alloc, const MapFreeFn dealloc) {
+    // Sanity check
+    if (path == NULL) {
+        return NULL;
+    }
+
+    // Check if alloc and free could be NULL
+    MapAllocFn local_alloc = alloc;
+    MapFreeFn local_free = dealloc;
+    if (alloc == NULL || dealloc == NULL) {
+        local_alloc = malloc;
+        local_free = free;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    // The body is the rest of the file
+    DsSnapshotHeader header;
+    long end = -1;
+    if (fread(&header, sizeof(header), 1, file) == 1 && fseek(file, 0, SEEK_END) == 0) {
+        end = ftell(file);
+    }
+    if (end < (long)sizeof(header) || fseek(file, sizeof(header), SEEK_SET) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    const size_t body_len = (size_t)end - sizeof(header);
+    void *body = local_alloc(body_len + 1);
+    if (body == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    const int ok = body_len == 0 || fread(body, body_len, 1, file) == 1;
+    fclose(file);
+
+    StaticMap *map = ok ? static_map_open(&header, body, body_len, local_alloc, local_free) : NULL;
+    if (map == NULL) {
+        local_free(body);
+    }
+    return map;
+}
+
+
+
+StaticMap *static_map_map(const char *path, const MapAllocFn alloc, const MapFreeFn dealloc) {
+    // Sanity check
+    if (path == NULL) {
+        return NULL;
+    }
+
+    // Check if alloc and free could be NULL
+    MapAllocFn local_alloc = alloc;
+    MapFreeFn local_free = dealloc;
+    if (alloc == NULL || dealloc == NULL) {
+        local_alloc = malloc;
+        local_free = free;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(DsSnapshotHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    const size_t map_len = info.st_size;
+    void *map_base = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map_base == MAP_FAILED) {
+        return NULL;
+    }
+
+    DsSnapshotHeader header;
+    memcpy(&header, map_base, sizeof(header));
+    StaticMap *map = static_map_open(&header, (char *)map_base + sizeof(header), map_len - sizeof(header),
+            local_alloc, local_free);
+    if (map == NULL) {
+        munmap(map_base, map_len);
+        return NULL;
+    }
+    map->map_base = map_base;
+    map->map_len = map_len;
+    return map;
+}
+
+
+
+void static_map_free(StaticMap *map) {
+    // Sanity check
+    if (map == NULL) {
+        return;
+    }
+
+    if (map->map_base != NULL) {
+        munmap(map->map_base, map->map_len);
+    } else {
+        map->dealloc(map->body);
+    }
+    map->dealloc(map);
+}
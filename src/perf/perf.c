@@ -0,0 +1,241 @@
+// Needed for syscall and clock_gettime
+#define _DEFAULT_SOURCE
+
+// Header file
+#include "../../include/perf.h"
+
+// Libraries
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+/********************************** Private ***********************************/
+
+/// Every event is opened on its own instead of as a group, so one event the
+/// PMU can not schedule does not take the others down with it. The kernel
+/// multiplexes them if there are more events than counters, which is what
+/// time_enabled and time_running are read for.
+
+
+static const char *const ds_perf_names[DS_PERF_EVENTS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses", "page_faults",
+};
+
+
+struct ds_perf {
+    int fd[DS_PERF_EVENTS]; /* -1 if the event is not available */
+    uint64_t start_ns;
+};
+
+
+
+static uint64_t ds_perf_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+
+#if defined(__linux__)
+
+/// Type and config of every event
+static void ds_perf_event_attr(const DsPerfEvent event, struct perf_event_attr *attr) {
+    const uint64_t cache_miss = (uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8 |
+            (uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+    switch (event) {
+    case DS_PERF_CYCLES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case DS_PERF_INSTRUCTIONS:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case DS_PERF_L1D_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_L1D | cache_miss;
+        break;
+    case DS_PERF_LLC_MISSES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+    case DS_PERF_DTLB_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_DTLB | cache_miss;
+        break;
+    case DS_PERF_BRANCH_MISSES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    case DS_PERF_PAGE_FAULTS:
+    default:
+        attr->type = PERF_TYPE_SOFTWARE;
+        attr->config = PERF_COUNT_SW_PAGE_FAULTS;
+        break;
+    }
+}
+
+static int ds_perf_open(const DsPerfEvent event) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    ds_perf_event_attr(event, &attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // This thread on any CPU
+    const long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd < 0 ? -1 : (int)fd;
+}
+
+#endif
+
+
+
+/********************************** Public ************************************/
+
+DsPerf *ds_perf_init(void) {
+    DsPerf *perf = malloc(sizeof(DsPerf));
+    if (perf == NULL) {
+        return NULL;
+    }
+    for (int event = 0; event < DS_PERF_EVENTS; ++event) {
+#if defined(__linux__)
+        perf->fd[event] = ds_perf_open((DsPerfEvent)event);
+#else
+        perf->fd[event] = -1;
+#endif
+    }
+    perf->start_ns = 0;
+    return perf;
+}
+
+
+
+int ds_perf_available(const DsPerf *perf, const DsPerfEvent event) {
+    // Sanity check
+    if (perf == NULL || (int)event < 0 || event >= DS_PERF_EVENTS) {
+        return 0;
+    }
+    return perf->fd[event] >= 0;
+}
+
+
+
+void ds_perf_begin(DsPerf *perf) {
+    // Sanity check
+    if (perf == NULL) {
+        return;
+    }
+
+#if defined(__linux__)
+    for (int event = 0; event < DS_PERF_EVENTS; ++event) {
+        if (perf->fd[event] >= 0) {
+            ioctl(perf->fd[event], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fd[event], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+    // Last, so opening the counters is not part of the time
+    perf->start_ns = ds_perf_now_ns();
+}
+
+
+
+void ds_perf_end(DsPerf *perf, DsPerfCounts *counts) {
+    const uint64_t end_ns = ds_perf_now_ns();
+
+    // Sanity check
+    if (perf == NULL || counts == NULL) {
+        return;
+    }
+
+    memset(counts, 0, sizeof(*counts));
+    counts->ns = end_ns - perf->start_ns;
+#if defined(__linux__)
+    for (int event = 0; event < DS_PERF_EVENTS; ++event) {
+        if (perf->fd[event] >= 0) {
+            ioctl(perf->fd[event], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int event = 0; event < DS_PERF_EVENTS; ++event) {
+        uint64_t data[3]; /* value, time enabled, time running */
+        if (perf->fd[event] < 0 || read(perf->fd[event], data, sizeof(data)) != (ssize_t)sizeof(data)) {
+            continue;
+        }
+
+        // Never scheduled, the count says nothing
+        if (data[2] == 0) {
+            continue;
+        }
+        double value = (double)data[0];
+        if (data[2] < data[1]) {
+            value = value * (double)data[1] / (double)data[2];
+        }
+        counts->value[event] = (uint64_t)value;
+        counts->available |= 1u << event;
+    }
+#endif
+}
+
+
+
+const char *ds_perf_event_name(const DsPerfEvent event) {
+    if ((int)event < 0 || event >= DS_PERF_EVENTS) {
+        return NULL;
+    }
+    return ds_perf_names[event];
+}
+
+
+
+void ds_perf_print(FILE *out, const DsPerfCounts *counts, const size_t ops) {
+    // Sanity check
+    if (out == NULL || counts == NULL) {
+        return;
+    }
+
+    const double divisor = ops == 0 ? 1.0 : (double)ops;
+    fprintf(out, "{\"ns\": %.2f", (double)counts->ns / divisor);
+    for (int event = 0; event < DS_PERF_EVENTS; ++event) {
+        if (counts->available & (1u << event)) {
+            fprintf(out, ", \"%s\": %.3f", ds_perf_names[event], (double)counts->value[event] / divisor);
+        }
+    }
+    const unsigned ipc_events = 1u << DS_PERF_CYCLES | 1u << DS_PERF_INSTRUCTIONS;
+    if ((counts->available & ipc_events) == ipc_events && counts->value[DS_PERF_CYCLES] != 0) {
+        fprintf(out, ", \"ipc\": %.3f",
+                (double)counts->value[DS_PERF_INSTRUCTIONS] / (double)counts->value[DS_PERF_CYCLES]);
+    }
+    fprintf(out, "}");
+}
+
+
+
+void ds_perf_free(DsPerf *perf) {
+    // Sanity check
+    if (perf == NULL) {
+        return;
+    }
+
+#if defined(__linux__)
+    for (int event = 0; event < DS_PERF_EVENTS; ++event) {
+        if (perf->fd[event] >= 0) {
+            close(perf->fd[event]);
+        }
+    }
+#endif
+    free(perf);
+}
@@ -0,0 +1,35 @@
+/// ds.h, the library as a single header
+///
+/// Generated by `make single` from include/ and src/. Include it for the
+/// declarations and define DS_IMPLEMENTATION in exactly one source file to
+/// compile the library into it. That file has to include ds.h before any
+/// system header and the program has to be linked with -pthread.
+///
+///     #define DS_IMPLEMENTATION
+///     #include "ds.h"
+///
+/// Unlike libds.a, ds.h shows the layout of Vector and Tree to every file
+/// that includes it, so vector_at, vector_size, vector_elem_size,
+/// vector_insert, tree_lookup, tree_get_value, tree_size, tree_min and
+/// tree_max are inlined into the caller. Growing and rebalancing stay out of
+/// line. Define DS_NO_INLINE to call the library functions instead, DS_TRACE
+/// builds always do so every operation is recorded.
+///
+/// DS_STATS and DS_TRACE change the layout, they have to be defined the same
+/// way in every file. Next to the public names ds.h defines the internal
+/// helpers of the containers, which start with vector_, tree_, node_, heap_,
+/// art_ or ds_.
+
+#ifndef JAZZY_DS_H
+#define JAZZY_DS_H
+
+#if defined(DS_IMPLEMENTATION)
+// Needed for mmap, pthread_key_t, posix_memalign, clock_gettime and syscall
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#endif
+
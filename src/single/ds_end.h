@@ -0,0 +1,15 @@
+
+/// Fast paths, see the top of this file
+#if !defined(DS_NO_INLINE) && !defined(DS_TRACE)
+#define vector_at(vec, index) vector_at_inline((vec), (index))
+#define vector_size(vec) vector_size_inline(vec)
+#define vector_elem_size(vec) vector_elem_size_inline(vec)
+#define vector_insert(vec, data, data_len) vector_insert_inline((vec), (data), (data_len))
+#define tree_lookup(tree, value) tree_lookup_inline((tree), (value))
+#define tree_get_value(tree, key) tree_get_value_inline((tree), (key))
+#define tree_size(tree) tree_size_inline(tree)
+#define tree_min(tree) tree_min_inline(tree)
+#define tree_max(tree) tree_max_inline(tree)
+#endif
+
+#endif // JAZZY_DS_H
@@ -0,0 +1,260 @@
+// Needed for clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+// Header file
+#include "../../include/trace.h"
+#include "../../include/hash.h"
+
+// Libraries
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/********************************** Private ***********************************/
+
+/// File format
+///
+/// A trace starts with the 8 bytes of DS_TRACE_MAGIC, the last one is the
+/// version. Every record follows as
+///
+///   op | source << 2 (1 byte) | ns delta | key delta | size
+///
+/// with the last three as LEB128 varints. The ns delta is the time since
+/// the previous record and the key delta is zigzag encoded, so sequential
+/// keys and bursts of operations take a byte each.
+
+
+#define DS_TRACE_MAGIC "DSTRACE\x01"
+#define DS_TRACE_MAGIC_LEN 8
+
+/// Longest encoding of a record
+#define DS_TRACE_RECORD_MAX (1 + 3 * 10)
+
+/// Records are encoded into a buffer of this size before they are written
+#define DS_TRACE_BUF_SIZE ((size_t)64 << 10)
+
+
+struct ds_trace {
+    FILE *file;
+    uint64_t start_ns;
+    uint64_t last_ns;
+    uint64_t last_key;
+    size_t records;
+    int failed; /* A write failed */
+    size_t used;
+    unsigned char buf[DS_TRACE_BUF_SIZE];
+};
+
+
+
+static uint64_t ds_trace_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+
+static size_t ds_trace_put_varint(unsigned char *out, uint64_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (unsigned char)value;
+    return len;
+}
+
+/// Returns:
+///   1 on success, 0 if the varint is cut off or too long
+static int ds_trace_get_varint(const unsigned char **pos, const unsigned char *end, uint64_t *value) {
+    *value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (*pos == end) {
+            return 0;
+        }
+        const unsigned char byte = *(*pos)++;
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+static void ds_trace_flush(DsTrace *trace) {
+    if (trace->used != 0 && fwrite(trace->buf, 1, trace->used, trace->file) != trace->used) {
+        trace->failed = 1;
+    }
+    trace->used = 0;
+}
+
+
+
+/********************************** Public ************************************/
+
+DsTrace *ds_trace_open(const char *path) {
+    // Sanity check
+    if (path == NULL) {
+        return NULL;
+    }
+
+    DsTrace *trace = malloc(sizeof(DsTrace));
+    if (trace == NULL) {
+        return NULL;
+    }
+    trace->file = fopen(path, "wb");
+    if (trace->file == NULL) {
+        free(trace);
+        return NULL;
+    }
+    memcpy(trace->buf, DS_TRACE_MAGIC, DS_TRACE_MAGIC_LEN);
+    trace->used = DS_TRACE_MAGIC_LEN;
+    trace->start_ns = ds_trace_now_ns();
+    trace->last_ns = 0;
+    trace->last_key = 0;
+    trace->records = 0;
+    trace->failed = 0;
+    return trace;
+}
+
+
+
+void ds_trace_record(DsTrace *trace, const DsTraceSource source, const DsTraceOp op, const uint64_t key,
+        const size_t size) {
+    // Sanity check
+    if (trace == NULL) {
+        return;
+    }
+
+    if (trace->used > DS_TRACE_BUF_SIZE - DS_TRACE_RECORD_MAX) {
+        ds_trace_flush(trace);
+    }
+
+    const uint64_t ns = ds_trace_now_ns() - trace->start_ns;
+    const uint64_t key_delta = key - trace->last_key;
+    unsigned char *out = trace->buf + trace->used;
+    size_t len = 0;
+    out[len++] = (unsigned char)((unsigned)op | (unsigned)source << 2);
+    len += ds_trace_put_varint(out + len, ns - trace->last_ns);
+    len += ds_trace_put_varint(out + len, key_delta << 1 ^ (uint64_t)-(int64_t)(key_delta >> 63));
+    len += ds_trace_put_varint(out + len, size > UINT32_MAX ? UINT32_MAX : size);
+    trace->used += len;
+    trace->last_ns = ns;
+    trace->last_key = key;
+    trace->records++;
+}
+
+
+
+uint64_t ds_trace_key(const void *key, const size_t len) {
+    if (len > sizeof(uint64_t)) {
+        return hash_bytes(key, len, 0);
+    }
+    const unsigned char *bytes = key;
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; ++i) {
+        value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+
+
+size_t ds_trace_size(const DsTrace *trace) {
+    return trace == NULL ? 0 : trace->records;
+}
+
+
+
+int ds_trace_close(DsTrace *trace) {
+    // Sanity check
+    if (trace == NULL) {
+        return 0;
+    }
+
+    ds_trace_flush(trace);
+    // Close the file even after a failed write
+    const int closed = fclose(trace->file) == 0;
+    const int ok = closed && !trace->failed;
+    free(trace);
+    return ok;
+}
+
+
+
+DsTraceRecord *ds_trace_load(const char *path, size_t *count) {
+    // Sanity check
+    if (path == NULL || count == NULL) {
+        return NULL;
+    }
+
+    // Read the whole file, traces are decoded into 24 byte records anyway
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    size_t cap = DS_TRACE_BUF_SIZE, len = 0;
+    unsigned char *data = malloc(cap);
+    while (data != NULL) {
+        len += fread(data + len, 1, cap - len, file);
+        if (len < cap) {
+            break;
+        }
+        unsigned char *grown = realloc(data, cap * 2);
+        if (grown == NULL) {
+            free(data);
+        }
+        data = grown;
+        cap *= 2;
+    }
+    const int read_error = ferror(file);
+    fclose(file);
+    if (data == NULL) {
+        return NULL;
+    }
+    if (read_error || len < DS_TRACE_MAGIC_LEN || memcmp(data, DS_TRACE_MAGIC, DS_TRACE_MAGIC_LEN) != 0) {
+        free(data);
+        return NULL;
+    }
+
+    // Every record takes at least 4 bytes
+    const size_t max_records = (len - DS_TRACE_MAGIC_LEN) / 4;
+    DsTraceRecord *records = malloc((max_records == 0 ? 1 : max_records) * sizeof(DsTraceRecord));
+    if (records == NULL) {
+        free(data);
+        return NULL;
+    }
+
+    const unsigned char *pos = data + DS_TRACE_MAGIC_LEN, *end = data + len;
+    uint64_t ns = 0, key = 0;
+    size_t n = 0;
+    while (pos < end) {
+        const unsigned char head = *pos++;
+        uint64_t ns_delta, key_delta, size;
+        if ((head & 3) >= DS_TRACE_OPS || head >> 2 >= DS_TRACE_SOURCES ||
+                !ds_trace_get_varint(&pos, end, &ns_delta) || !ds_trace_get_varint(&pos, end, &key_delta) ||
+                !ds_trace_get_varint(&pos, end, &size) || size > UINT32_MAX) {
+            free(records);
+            free(data);
+            return NULL;
+        }
+        ns += ns_delta;
+        key += key_delta >> 1 ^ (uint64_t)-(int64_t)(key_delta & 1);
+        records[n].ns = ns;
+        records[n].key = key;
+        records[n].size = (uint32_t)size;
+        records[n].op = head & 3;
+        records[n].source = head >> 2;
+        n++;
+    }
+
+    free(data);
+    *count = n;
+    return records;
+}
@@ -0,0 +1,244 @@
+// Header file
+#include "../../include/tree.h"
+#include "tree_internal.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/********************************** Private ***********************************/
+
+/// How many levels below the current node are prefetched. The 16 descendants
+/// four levels down are stored next to each other, so for small elements they
+/// share one or two cache lines.
+#define FROZEN_PREFETCH_LEVELS 4
+
+/// Size of a cache line
+#define FROZEN_LINE_SIZE 64
+
+
+struct _FrozenTree {
+    size_t elem_size;
+    size_t key_size;
+    size_t point_size; /* Non zero for interval trees */
+    size_t size;
+    TreeComparator comp;
+    DsAllocState heap; /* Copied from the tree, which may be freed first */
+    void *raw; /* Allocation that elems points into */
+    size_t raw_size;
+    char *elems; /* Elements in Eytzinger order. Index 0 is unused */
+};
+
+
+
+static inline const char *frozen_elem(const FrozenTree *frozen, const size_t index) {
+    return frozen->elems + index * frozen->elem_size;
+}
+
+
+
+static inline void frozen_prefetch(const FrozenTree *frozen, const size_t index) {
+#if defined(__GNUC__)
+    const size_t first = index << FROZEN_PREFETCH_LEVELS;
+    if (first > frozen->size) {
+        return;
+    }
+    const char *block = frozen_elem(frozen, first);
+    const size_t block_size = frozen->elem_size << FROZEN_PREFETCH_LEVELS;
+    for (size_t offset = 0; offset < block_size; offset += FROZEN_LINE_SIZE) {
+        __builtin_prefetch(block + offset);
+    }
+#else
+    (void)frozen;
+    (void)index;
+#endif
+}
+
+
+
+/// Undo the descent past the lower bound
+///
+/// The descent in `frozen_search` ends below the leaves. The lower bound is the
+/// node where the last left turn was taken, so all trailing right turns
+/// (1 bits) and that left turn are shifted out.
+static inline size_t frozen_lower_bound_index(const size_t index) {
+#if defined(__GNUC__)
+    if (~index == 0) {
+        return 0;
+    }
+    return index >> (__builtin_ctzll((unsigned long long)~index) + 1);
+#else
+    size_t result = index;
+    while (result & 1) {
+        result >>= 1;
+    }
+    return result >> 1;
+#endif
+}
+
+
+
+/// Find the index of the first element that is not less than [key]
+///
+/// Returns:
+///   the index of that element or 0 if all elements are less than [key]
+static size_t frozen_search(const FrozenTree *frozen, const void *key) {
+    size_t index = 1;
+    while (index <= frozen->size) {
+        frozen_prefetch(frozen, index);
+        const int compval = tree_key_compare(frozen->comp, frozen->key_size, frozen->point_size,
+                frozen_elem(frozen, index), key);
+        index = 2 * index + (compval < 0);
+    }
+    return frozen_lower_bound_index(index);
+}
+
+
+
+/// Copy the nodes starting at [cursor] into the subtree of [index]
+static void frozen_fill(FrozenTree *frozen, const Tree *tree, TreeCursor *cursor, const size_t index) {
+    if (index > frozen->size) {
+        return;
+    }
+    frozen_fill(frozen, tree, cursor, 2 * index);
+
+    memcpy(frozen->elems + index * frozen->elem_size, node_value(tree, cursor->node), frozen->elem_size);
+    tree_cursor_next(tree, cursor);
+
+    frozen_fill(frozen, tree, cursor, 2 * index + 1);
+}
+
+
+/*********************************** Public ***********************************/
+
+
+FrozenTree *tree_freeze(const Tree *tree) {
+    // Sanity check
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    FrozenTree *frozen = ds_state_alloc(&tree->heap, sizeof(FrozenTree));
+    if (frozen == NULL) {
+        return NULL;
+    }
+
+    // One extra element for the unused index 0 and slack for alignment
+    const size_t storage_size = (tree->size + 1) * tree->elem_size + FROZEN_LINE_SIZE;
+    void *raw = ds_state_alloc(&tree->heap, storage_size);
+    if (raw == NULL) {
+        ds_state_free(&tree->heap, frozen, sizeof(FrozenTree));
+        return NULL;
+    }
+
+    // Align the storage so that blocks of descendants start on a cache line
+    const uintptr_t aligned = ((uintptr_t)raw + FROZEN_LINE_SIZE - 1) & ~(uintptr_t)(FROZEN_LINE_SIZE - 1);
+
+    frozen->elem_size = tree->elem_size;
+    frozen->key_size = tree->key_size;
+    frozen->point_size = tree->point_size;
+    frozen->size = tree->size;
+    frozen->comp = tree->comp;
+    frozen->heap = tree->heap;
+    frozen->raw = raw;
+    frozen->raw_size = storage_size;
+    frozen->elems = (char *)aligned;
+
+    TreeCursor cursor;
+    tree_cursor_first(tree, &cursor);
+    frozen_fill(frozen, tree, &cursor, 1);
+
+    return frozen;
+}
+
+
+
+const void *frozen_lookup(const FrozenTree *frozen, const void *key) {
+    // Sanity check
+    if (frozen == NULL || key == NULL) {
+        return NULL;
+    }
+
+    const size_t index = frozen_search(frozen, key);
+    if (index == 0) {
+        return NULL;
+    }
+
+    const char *elem = frozen_elem(frozen, index);
+    if (tree_key_compare(frozen->comp, frozen->key_size, frozen->point_size, key, elem) != 0) {
+        return NULL;
+    }
+    return elem;
+}
+
+
+
+const void *frozen_lookup_u32(const FrozenTree *frozen, const uint32_t key) {
+    // Sanity check
+    if (frozen == NULL || frozen->key_size != sizeof(uint32_t) || frozen->point_size != 0) {
+        return NULL;
+    }
+
+    size_t index = 1;
+    uint32_t elem_key;
+    while (index <= frozen->size) {
+        frozen_prefetch(frozen, index);
+        memcpy(&elem_key, frozen_elem(frozen, index), sizeof(elem_key));
+        index = 2 * index + (elem_key < key);
+    }
+    index = frozen_lower_bound_index(index);
+
+    if (index == 0) {
+        return NULL;
+    }
+    memcpy(&elem_key, frozen_elem(frozen, index), sizeof(elem_key));
+    return elem_key == key ? frozen_elem(frozen, index) : NULL;
+}
+
+
+
+const void *frozen_lookup_u64(const FrozenTree *frozen, const uint64_t key) {
+    // Sanity check
+    if (frozen == NULL || frozen->key_size != sizeof(uint64_t) || frozen->point_size != 0) {
+        return NULL;
+    }
+
+    size_t index = 1;
+    uint64_t elem_key;
+    while (index <= frozen->size) {
+        frozen_prefetch(frozen, index);
+        memcpy(&elem_key, frozen_elem(frozen, index), sizeof(elem_key));
+        index = 2 * index + (elem_key < key);
+    }
+    index = frozen_lower_bound_index(index);
+
+    if (index == 0) {
+        return NULL;
+    }
+    memcpy(&elem_key, frozen_elem(frozen, index), sizeof(elem_key));
+    return elem_key == key ? frozen_elem(frozen, index) : NULL;
+}
+
+
+
+size_t frozen_size(const FrozenTree *frozen) {
+    if (frozen == NULL) {
+        return 0;
+    }
+    return frozen->size;
+}
+
+
+
+void frozen_free(FrozenTree *frozen) {
+    // Sanity check
+    if (frozen == NULL) {
+        return;
+    }
+
+    const DsAllocState heap = frozen->heap;
+    ds_state_free(&heap, frozen->raw, frozen->raw_size);
+    ds_state_free(&heap, frozen, sizeof(FrozenTree));
+}
@@ -1,138 +1,108 @@
 // Header file
 #include "../../include/tree.h"
+#include "tree_internal.h"
+#include "../common/snapshot.h"
 
 // Libraries
 #include <assert.h>
-#include <complex.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 
 // Macros
-#define min(x,y) (((x) < (y)) ? (x) : (y))
 #define max(x,y) (((x) > (y)) ? (x) : (y))
 
-/********************************* TreeNode ***********************************/
-
-typedef struct _TreeNode TreeNode;
-
-
-struct _TreeNode {
-    uint64_t height;
-    TreeNode *parent;
-    TreeNode *left;
-    TreeNode *right;
-    void *value;
-};
+/// Node sizes are rounded up to a multiple of this. Allocators hand out blocks
+/// in multiples of it anyway and nodes that are placed back to back by an
+/// arena stay aligned.
+#define TREE_NODE_ALIGN sizeof(uint64_t)
 
-typedef enum {
-    Left,
-    Right,
-    Root,
-    Fail,
-} Direction;
+/********************************* TreeNode ***********************************/
 
 typedef enum {
     LeftRot,
     RightRot,
 } RotationDir;
 
-static TreeNode *node_init(const void *value, const TreeNode *parent, size_t elem_size, TreeAllocFn alloc) {
+/// Recompute the max end of [node] from its own end and its children
+static void node_update_max(const Tree *tree, TreeNode *node) {
+    if (tree->point_size == 0) {
+        return;
+    }
+    const void *max_end = (const char *)node_value(tree, node) + tree->point_size;
+    if (node->left != NULL && tree->comp(node_max(tree, node->left), max_end, tree->point_size) > 0) {
+        max_end = node_max(tree, node->left);
+    }
+    if (node->right != NULL && tree->comp(node_max(tree, node->right), max_end, tree->point_size) > 0) {
+        max_end = node_max(tree, node->right);
+    }
+    memmove(node_max(tree, node), max_end, tree->point_size);
+}
+
+
+
+static TreeNode *node_init(const Tree *tree, const void *value, const size_t copy_size, TreeNode *parent) {
     // Allocate Node
-    TreeNode *new_node = alloc(sizeof(TreeNode) + elem_size);
+    TreeNode *new_node = ds_state_alloc(&tree->heap, tree->node_size);
     if (new_node == NULL) {
         return NULL;
     }
 
     // Get storage pointer
-    void *value_ptr = (char *)new_node + sizeof(TreeNode);
+    void *value_ptr = node_value(tree, new_node);
 
-    memcpy(value_ptr, value, elem_size);
+    // Copy what was provided, zero the rest
+    if (value != NULL) {
+        memcpy(value_ptr, value, copy_size);
+    } else {
+        assert(copy_size == 0);
+    }
+    memset((char *)value_ptr + copy_size, 0, tree->elem_size - copy_size);
 
 
     // Assign values
-    new_node->parent = (TreeNode *)parent;
-    new_node->value = value_ptr;
-    new_node->height = 1;
     new_node->left = NULL;
     new_node->right = NULL; 
+    node_set_parent(tree, new_node, parent);
+    node_set_bal(tree, new_node, 0);
+    node_update_max(tree, new_node);
 
     return new_node;
 }
 
-static Direction child_dir(const TreeNode *node) {
-    assert(node != NULL);
-    if (node->parent == NULL) {
-        return Root;
-    }
-    if (node->parent->left == node) {
-        return Left;
-    }
-    if (node->parent->right == node) {
-        return Right;
-    }
-    // Something's not right
-    return Fail;
-}
-
 
 
-static uint64_t node_height(const TreeNode *node) {
-    if (node != NULL) {
-        return node->height;
-    } else {
-        return 0;
-    }
-}
-// NOTE:
-// return_val < 0 ==> Right heavy
-// return_val > 0 ==> Left heavy
-static int64_t node_get_balance(const TreeNode *node) {
-    if (node != NULL) {
-        return node_height(node->left) - node_height(node->right);
-    } else {
-        return 0;
-    }
-}
-
-static void node_update_height(TreeNode *node) {
-    if (node == NULL) {
-        return;
-    }
-    node->height = 1 + max(node_height(node->left), node_height(node->right));
-}
-
-
-
-static TreeNode *node_rotate(TreeNode *node, const RotationDir dir) {
-    // NULL checks
-    if (node == NULL) {
-        return NULL;
-    }
-
-    TreeNode *old_root = node, *old_parent = node->parent;
+/// Rotate the subtree at [node]. Only links and max ends are changed,
+/// balance factors are up to the caller.
+static TreeNode *node_rotate(const Tree *tree, TreeNode *node, const RotationDir dir) {
+    DS_STAT_ADD(tree->stat_rotations, 1);
     TreeNode *new_root, *inner_grandchild;
     switch (dir) {
-    case Left:
+    case LeftRot:
         new_root = node->right;
         inner_grandchild = new_root->left;
-        new_root->left = old_root;
-        old_root->right = inner_grandchild;
-        old_root->parent = new_root;
-        new_root->parent = old_parent;
-        node_update_height(old_root);
-        node_update_height(new_root);
+        new_root->left = node;
+        node->right = inner_grandchild;
         break;
-    case Right:
+    case RightRot:
         new_root = node->left;
         inner_grandchild = new_root->right;
-        new_root->right = old_root;
-        old_root->left = inner_grandchild;
-        node_update_height(old_root);
-        node_update_height(new_root);
+        new_root->right = node;
+        node->left = inner_grandchild;
         break;
     }
+
+    // Fix parent pointers
+    node_set_parent(tree, inner_grandchild, node);
+    node_set_parent(tree, new_root, node_parent(tree, node));
+    node_set_parent(tree, node, new_root);
+
+    // [node] is a child of [new_root] now
+    node_update_max(tree, node);
+    node_update_max(tree, new_root);
+
     return new_root;
 }
 
@@ -140,31 +110,57 @@ static TreeNode *node_rotate(TreeNode *node, const RotationDir dir) {
 
 
 
-static TreeNode *node_balance(TreeNode *node) {
-    if (node == NULL) {
-        return NULL;
-    }
-    int balance_value = node_get_balance(node);
-    if (balance_value <= -2) { // Is right heavy -> rotate left
-        int inner_bal = node_get_balance(node->right);
-        if (inner_bal >= 1) {
-            node->right = node_rotate(node->right, RightRot);
+/// Rebalance a node whose balance factor is +2 or -2
+///
+/// Returns:
+///   the new root of the subtree. Its balance factor is 0 unless the taller
+///   child was balanced, which can only happen after a deletion.
+static TreeNode *node_balance(const Tree *tree, TreeNode *node) {
+    const int8_t balance_value = node_bal(tree, node);
+    if (balance_value >= 2) { // Is right heavy -> rotate left
+        TreeNode *right = node->right;
+        const int8_t inner_bal = node_bal(tree, right);
+        if (inner_bal >= 0) {
+            TreeNode *new_root = node_rotate(tree, node, LeftRot);
+            node_set_bal(tree, node, inner_bal == 0 ? 1 : 0);
+            node_set_bal(tree, right, inner_bal == 0 ? -1 : 0);
+            return new_root;
         }
-        return node_rotate(node, LeftRot);
 
-    } else if (balance_value >= 2) { // Is left heavy -> rotate right
-        int inner_bal = node_get_balance(node->left);
-        if (inner_bal <= -1) {
-            node->left = node_rotate(node->left, LeftRot);
+        TreeNode *inner = right->left;
+        const int8_t grand_bal = node_bal(tree, inner);
+        node->right = node_rotate(tree, right, RightRot);
+        TreeNode *new_root = node_rotate(tree, node, LeftRot);
+        node_set_bal(tree, node, grand_bal > 0 ? -1 : 0);
+        node_set_bal(tree, right, grand_bal < 0 ? 1 : 0);
+        node_set_bal(tree, inner, 0);
+        return new_root;
+
+    } else if (balance_value <= -2) { // Is left heavy -> rotate right
+        TreeNode *left = node->left;
+        const int8_t inner_bal = node_bal(tree, left);
+        if (inner_bal <= 0) {
+            TreeNode *new_root = node_rotate(tree, node, RightRot);
+            node_set_bal(tree, node, inner_bal == 0 ? -1 : 0);
+            node_set_bal(tree, left, inner_bal == 0 ? 1 : 0);
+            return new_root;
         }
-        return node_rotate(node, RightRot);
+
+        TreeNode *inner = left->right;
+        const int8_t grand_bal = node_bal(tree, inner);
+        node->left = node_rotate(tree, left, LeftRot);
+        TreeNode *new_root = node_rotate(tree, node, RightRot);
+        node_set_bal(tree, node, grand_bal < 0 ? 1 : 0);
+        node_set_bal(tree, left, grand_bal > 0 ? -1 : 0);
+        node_set_bal(tree, inner, 0);
+        return new_root;
     }
     return node;
 }
 
 
-static void node_free(TreeFreeFn dealloc, TreeNode *node) {
-    dealloc(node);
+static void node_free(const Tree *tree, TreeNode *node) {
+    ds_state_free(&tree->heap, node, tree->node_size);
 }
 
 
@@ -172,149 +168,366 @@ static void node_free(TreeFreeFn dealloc, TreeNode *node) {
 
 /********************************* Tree ***************************************/
 
-struct _Tree {
-    size_t elem_size;
-    TreeNode *root;
-    TreeAllocFn alloc;
-    TreeFreeFn dealloc;
-    TreeComparator comp;
-};
-
-
-Tree *tree_init(const size_t elem_size, const TreeAllocFn alloc, const TreeFreeFn dealloc, const TreeComparator comp) {
-    // Check if alloc and free could be NULL
-    TreeAllocFn local_alloc = alloc;
-    TreeFreeFn local_free = dealloc;
-    if (alloc == NULL || dealloc == NULL) {
-        local_alloc = malloc;
-        local_free = free;
+/// Set up a tree. [point_size] is only non zero for interval trees
+static Tree *tree_create(const size_t key_size, const size_t val_size, const size_t point_size, const int flags,
+        const DsAllocState *heap, const TreeComparator comp) {
+    // Values are aligned like a struct member of their size would be
+    size_t val_align = val_size == 0 ? 1 : val_size & (~val_size + 1);
+    if (val_align > sizeof(uint64_t)) {
+        val_align = sizeof(uint64_t);
     }
+    const size_t val_offset = (key_size + val_align - 1) & ~(val_align - 1);
+    const size_t elem_size = val_offset + val_size;
+
+    // Node layout, see tree_internal.h
+    const size_t elem_offset = sizeof(TreeNode) + (flags & TREE_NO_PARENT ? 0 : sizeof(TreeNode *));
+    size_t point_align = point_size == 0 ? 1 : point_size & (~point_size + 1);
+    if (point_align > sizeof(uint64_t)) {
+        point_align = sizeof(uint64_t);
+    }
+    const size_t max_offset = (elem_offset + elem_size + point_align - 1) & ~(point_align - 1);
+    const size_t bal_offset = max_offset + point_size;
+    const size_t node_size = (bal_offset + sizeof(int8_t) + TREE_NODE_ALIGN - 1) & ~(TREE_NODE_ALIGN - 1);
 
 
     // Allcoate local tree
     Tree local_tree = {
         .elem_size = elem_size,
-        .alloc = local_alloc,
-        .dealloc = local_free,
+        .key_size = key_size,
+        .val_size = val_size,
+        .val_offset = val_offset,
+        .point_size = point_size,
+        .elem_offset = elem_offset,
+        .max_offset = max_offset,
+        .bal_offset = bal_offset,
+        .node_size = node_size,
+        .size = 0,
+        .flags = flags,
+        .heap = *heap,
         .root = NULL,
+        .leftmost = NULL,
+        .rightmost = NULL,
         .comp = comp == NULL ? memcmp : comp,
+#if defined(DS_TRACE)
+        .trace = NULL,
+#endif
     };
 
 
     // Allocate space on heap
-    Tree *new_tree = local_alloc(sizeof(Tree));
+    Tree *new_tree = ds_state_alloc(heap, sizeof(Tree));
     if (new_tree == NULL) {
         return NULL;
     }
     memcpy(new_tree, &local_tree, sizeof(Tree));
 
+    // Includes the allocation of the tree itself
+    new_tree->heap = *heap;
+
     return new_tree;
 }
 
 
+Tree *tree_init(const size_t elem_size, const TreeAllocFn alloc, const TreeFreeFn dealloc, const TreeComparator comp) {
+    return tree_init_map(elem_size, 0, alloc, dealloc, comp);
+}
+
+
+Tree *tree_init_map(const size_t key_size, const size_t val_size, const TreeAllocFn alloc,
+        const TreeFreeFn dealloc, const TreeComparator comp) {
+    return tree_init_ex(key_size, val_size, TREE_DEFAULT, alloc, dealloc, comp);
+}
+
+
+Tree *tree_init_ex(const size_t key_size, const size_t val_size, const int flags, const TreeAllocFn alloc,
+        const TreeFreeFn dealloc, const TreeComparator comp) {
+    DsAllocState heap;
+    ds_alloc_state_fns(&heap, alloc, dealloc);
+    return tree_create(key_size, val_size, 0, flags, &heap, comp);
+}
+
+
+Tree *tree_init_alloc(const size_t key_size, const size_t val_size, const int flags, const DsAllocator *allocator,
+        const TreeComparator comp) {
+    DsAllocState heap;
+    ds_alloc_state_init(&heap, allocator);
+    return tree_create(key_size, val_size, 0, flags, &heap, comp);
+}
+
+
+Tree *tree_init_interval(const size_t point_size, const size_t val_size, const TreeAllocFn alloc,
+        const TreeFreeFn dealloc, const TreeComparator comp) {
+    // Sanity check
+    if (point_size == 0) {
+        return NULL;
+    }
+    DsAllocState heap;
+    ds_alloc_state_fns(&heap, alloc, dealloc);
+    return tree_create(2 * point_size, val_size, point_size, TREE_DEFAULT, &heap, comp);
+}
+
+
 
 
 Tree *tree_init_def(const size_t elem_size, const TreeComparator comp) {
-    // Allcoate local tree
-    Tree local_tree = {
-        .elem_size = elem_size,
-        .alloc = malloc,
-        .dealloc = free,
-        .root = NULL,
-        .comp = comp,
-    };
+    return tree_init_map(elem_size, 0, malloc, free, comp);
+}
 
-    Tree *new_tree = malloc(sizeof(Tree));
-    if (new_tree == NULL) {
+
+
+/// Point the link that leads to path[index] at [node]
+///
+/// [path] holds the nodes from the root down and [dirs] whether the right
+/// child was taken at each of them. Index 0 is the root link.
+static void tree_set_link(Tree *tree, TreeNode *const *path, const unsigned char *dirs,
+        const size_t index, TreeNode *node) {
+    if (index == 0) {
+        tree->root = node;
+    } else if (dirs[index - 1]) {
+        path[index - 1]->right = node;
+    } else {
+        path[index - 1]->left = node;
+    }
+}
+
+
+
+/// Keep the cached extremes up to date after [node] was linked below [parent]
+static void tree_note_attach(Tree *tree, const TreeNode *parent, const int right, TreeNode *node) {
+    if (parent == NULL) {
+        tree->leftmost = node;
+        tree->rightmost = node;
+    } else if (right && parent == tree->rightmost) {
+        tree->rightmost = node;
+    } else if (!right && parent == tree->leftmost) {
+        tree->leftmost = node;
+    }
+}
+
+
+
+/// Link a new node below [parent] and fix balance factors using parent pointers
+///
+/// The walk up stops at the first subtree whose height did not change, which
+/// for ascending keys is after two steps on average.
+///
+/// Returns:
+///   the new node or NULL if the allocation failed
+static TreeNode *tree_attach_at(Tree *tree, TreeNode *parent, const int right, const void *value,
+        const size_t copy_size) {
+    assert(!(tree->flags & TREE_NO_PARENT));
+
+    TreeNode *node = node_init(tree, value, copy_size, parent);
+    if (node == NULL) {
         return NULL;
     }
-    memcpy(new_tree, &local_tree, sizeof(Tree));
+    if (right) {
+        parent->right = node;
+    } else {
+        parent->left = node;
+    }
+    tree_note_attach(tree, parent, right, node);
+    tree->size++;
 
-    return new_tree;
+    // Max ends of an interval tree have to be fixed all the way up
+    TreeNode *new_node = node;
+    int balancing = 1;
+    while (parent != NULL) {
+        if (balancing) {
+            const int8_t bal = node_bal(tree, parent) + (parent->right == node ? 1 : -1);
+            node_set_bal(tree, parent, bal);
+            if (bal == 0) { // Height did not change
+                balancing = 0;
+            } else if (bal == 2 || bal == -2) { // One rotation restores the old height
+                TreeNode *grand_parent = node_parent(tree, parent);
+                TreeNode *new_root = node_balance(tree, parent);
+                if (grand_parent == NULL) {
+                    tree->root = new_root;
+                } else if (grand_parent->left == parent) {
+                    grand_parent->left = new_root;
+                } else {
+                    grand_parent->right = new_root;
+                }
+                parent = new_root;
+                balancing = 0;
+            }
+        } else if (tree->point_size == 0) {
+            break;
+        }
+        node_update_max(tree, parent);
+        node = parent;
+        parent = node_parent(tree, node);
+    }
+
+    return new_node;
 }
 
-void tree_insert(Tree *tree, const void *value, const size_t val_size) {
-    // Sanity check
-    if (value == NULL || tree->comp == NULL || 
-            tree->alloc == NULL || tree->dealloc == NULL || val_size != tree->elem_size) {
-        return;
+
+
+/// Find the node that holds [key] or attach a new one for it
+///
+/// This is a single descent from the root. Keys larger than the current
+/// maximum skip the descent and are attached right below the cached rightmost
+/// node if the tree keeps parent pointers. If a new node is attached, the first
+/// [copy_size] bytes of [value] are copied into it and the rest is zeroed.
+/// Balance factors are then fixed along the recorded path, which stops as
+/// soon as a subtree did not grow.
+///
+/// Returns:
+///   the node holding [key], or NULL if the allocation failed. [inserted] is
+///   set to 1 if the node is new and 0 otherwise.
+static TreeNode *tree_find_or_attach(Tree *tree, const void *key, const void *value,
+        const size_t copy_size, int *inserted) {
+    TreeNode *path[TREE_MAX_HEIGHT];
+    unsigned char dirs[TREE_MAX_HEIGHT];
+    size_t depth = 0;
+    *inserted = 0;
+
+    // Appending a new maximum
+    if (tree->rightmost != NULL && !(tree->flags & TREE_NO_PARENT)) {
+        DS_STAT_ADD(tree->stat_compares, 1);
+        const int compval = tree_compare(tree, key, node_value(tree, tree->rightmost));
+        if (compval == 0) {
+            return tree->rightmost;
+        } else if (compval > 0) {
+            TreeNode *new_node = tree_attach_at(tree, tree->rightmost, 1, value, copy_size);
+            *inserted = new_node != NULL;
+            return new_node;
+        }
     }
 
-    // This is the first insertion
-    if (tree->root == NULL) {
-        tree->root = node_init(value, NULL, tree->elem_size, tree->alloc);
-        if (tree->root == NULL) {
-            return;
+    // Find the parent of the new node
+    TreeNode *node = tree->root;
+    while (node != NULL) {
+        DS_STAT_ADD(tree->stat_compares, 1);
+        int compval = tree_compare(tree, key, node_value(tree, node));
+        if (compval == 0) { // NO duplicates!!
+            return node;
         }
-        return;
+        path[depth] = node;
+        dirs[depth] = compval > 0;
+        depth++;
+        node = compval < 0 ? node->left : node->right;
     }
 
     // Create new node that will be added to the tree
-    TreeNode *new_node = node_init(value, NULL, tree->elem_size, tree->alloc);
+    TreeNode *new_node = node_init(tree, value, copy_size, depth == 0 ? NULL : path[depth - 1]);
     if (new_node == NULL) {
+        return NULL;
+    }
+    tree_set_link(tree, path, dirs, depth, new_node);
+    tree_note_attach(tree, depth == 0 ? NULL : path[depth - 1], depth == 0 ? 0 : dirs[depth - 1], new_node);
+    tree->size++;
+    *inserted = 1;
+
+    // Fix balance factors on the way up, max ends all the way up
+    int balancing = 1;
+    for (size_t i = depth; i-- > 0;) {
+        TreeNode *node = path[i];
+        if (balancing) {
+            const int8_t bal = node_bal(tree, node) + (dirs[i] ? 1 : -1);
+            node_set_bal(tree, node, bal);
+            if (bal == 0) { // Height did not change
+                balancing = 0;
+            } else if (bal == 2 || bal == -2) { // One rotation restores the old height
+                node = node_balance(tree, node);
+                tree_set_link(tree, path, dirs, i, node);
+                balancing = 0;
+            }
+        } else if (tree->point_size == 0) {
+            break;
+        }
+        node_update_max(tree, node);
+    }
+
+    return new_node;
+}
+
+void tree_insert(Tree *tree, const void *value, const size_t val_size) {
+    // Sanity check
+    if (tree == NULL || value == NULL || tree->comp == NULL || val_size != tree->elem_size) {
         return;
     }
+    DS_TRACE_RECORD(tree->trace, DS_TRACE_TREE, DS_TRACE_INSERT, ds_trace_key(value, tree->key_size), val_size);
 
-    // Find the parent of the new node
-    TreeNode *parent = tree->root;
-    while (parent != NULL) {
-        int compval = tree->comp(value, parent->value, tree->elem_size); 
+    int inserted;
+    tree_find_or_attach(tree, value, value, tree->elem_size, &inserted);
+}
 
-        if (compval == 0) { // NO duplicates!!
-            // We have to free this node first
-            node_free(tree->dealloc, new_node);
-            return;
-        } else if (compval < 0) { // Go left
-            if (parent->left == NULL) {
-                // Set for parent node
-                parent->left = new_node;
-                new_node->parent = parent;
-                break;
-            }
-            // Keep going
-            parent = parent->left;
-        } else if (compval > 0) { // Go right
-            if (parent->right == NULL) {
-                // Set for parent node
-                parent->right = new_node;
-                new_node->parent = parent;
-                break;
-            }
-            // Keep going
-            parent = parent->right;
+
+
+
+
+
+
+/// Attach a node for [value] next to [hint] if that is where it belongs
+///
+/// Returns:
+///   the node holding [value] or NULL if [hint] was not adjacent to [value]
+///   or the allocation failed
+static TreeNode *tree_attach_near(Tree *tree, TreeNode *hint, const void *value) {
+    const int compval = tree_compare(tree, value, node_value(tree, hint));
+    if (compval == 0) {
+        return hint;
+    }
+
+    // Find the in-order neighbour on the side of [value]
+    TreeNode *neighbour, *child = compval > 0 ? hint->right : hint->left;
+    if (child != NULL) {
+        neighbour = child;
+        while ((compval > 0 ? neighbour->left : neighbour->right) != NULL) {
+            neighbour = compval > 0 ? neighbour->left : neighbour->right;
+        }
+    } else if (hint == (compval > 0 ? tree->rightmost : tree->leftmost)) {
+        neighbour = NULL;
+    } else {
+        TreeNode *node = hint;
+        neighbour = node_parent(tree, node);
+        while (neighbour != NULL && (compval > 0 ? neighbour->right : neighbour->left) == node) {
+            node = neighbour;
+            neighbour = node_parent(tree, node);
         }
     }
-    // Parent cannot be null
-    assert(parent != NULL);
 
-    // We have to rotate the grand parent node
-    TreeNode *g_parent = parent->parent;
+    // [value] has to lie strictly between [hint] and [neighbour]
+    if (neighbour != NULL) {
+        const int neighbour_comp = tree_compare(tree, value, node_value(tree, neighbour));
+        if (neighbour_comp == 0 || (neighbour_comp > 0) == (compval > 0)) {
+            return NULL;
+        }
+    }
 
-    // update heights
-    while (parent != NULL) {
-        node_update_height(parent);
-        parent = parent->parent;
+    // The free link is on [hint] if it has no child on that side, else on [neighbour]
+    if (child == NULL) {
+        return tree_attach_at(tree, hint, compval > 0, value, tree->elem_size);
     }
+    return tree_attach_at(tree, neighbour, compval < 0, value, tree->elem_size);
+}
 
-    if (g_parent == NULL) {
-        return;
+
+
+const void *tree_insert_hint(Tree *tree, const void *hint, const void *value, const size_t val_size) {
+    // Sanity check
+    if (tree == NULL || value == NULL || val_size != tree->elem_size) {
+        return NULL;
     }
-    const Direction dir = child_dir(g_parent);
-    assert(dir != Fail && "Getting direction failed\n");
+    DS_TRACE_RECORD(tree->trace, DS_TRACE_TREE, DS_TRACE_INSERT, ds_trace_key(value, tree->key_size), val_size);
 
-    switch (dir) {
-    case Left:
-        g_parent->parent->left = node_balance(g_parent);
-        break;
-    case Right:
-        g_parent->parent->right = node_balance(g_parent);
-        break;
-    case Root:
-        tree->root = node_balance(g_parent);
-        break;
-    case Fail:
-        break;
+    TreeNode *node = NULL;
+    if (hint != NULL && !(tree->flags & TREE_NO_PARENT)) {
+        node = tree_attach_near(tree, (TreeNode *)((char *)hint - tree->elem_offset), value);
+    }
+
+    // Hint did not help, do a regular insert
+    if (node == NULL) {
+        int inserted;
+        node = tree_find_or_attach(tree, value, value, tree->elem_size, &inserted);
+        if (node == NULL) {
+            return NULL;
+        }
     }
+
+    return node_value(tree, node);
 }
 
 
@@ -325,142 +538,278 @@ void tree_insert(Tree *tree, const void *value, const size_t val_size) {
 
 void *tree_insert_with_buf(Tree *tree, const void *value, const size_t val_size) {
     // Sanity check
-    if (value == NULL || tree->comp == NULL || 
-            tree->alloc == NULL || tree->dealloc == NULL || val_size != tree->elem_size) {
+    if (tree == NULL || value == NULL || tree->comp == NULL || val_size != tree->elem_size) {
         return NULL;
     }
+    DS_TRACE_RECORD(tree->trace, DS_TRACE_TREE, DS_TRACE_INSERT, ds_trace_key(value, tree->key_size), val_size);
 
-    // This is the first insertion
-    if (tree->root == NULL) {
-        tree->root = node_init(NULL, NULL, tree->elem_size, tree->alloc);
-        if (tree->root == NULL) {
-            return NULL;
-        }
-        return (void *)tree->root->value;
+    int inserted;
+    TreeNode *node = tree_find_or_attach(tree, value, value, tree->key_size, &inserted);
+    if (node == NULL || !inserted) { // NO duplicates!!
+        return NULL;
     }
 
-    // Create new node that will be added to the tree
-    TreeNode *new_node = node_init(NULL, NULL, tree->elem_size, tree->alloc);
-    if (new_node == NULL) {
+    // Return buffer to write to
+    return node_value(tree, node);
+}
+
+
+
+void *tree_upsert(Tree *tree, const void *key, const void *value) {
+    // Sanity check
+    if (tree == NULL || key == NULL || value == NULL) {
         return NULL;
     }
+    DS_TRACE_RECORD(tree->trace, DS_TRACE_TREE, DS_TRACE_INSERT, ds_trace_key(key, tree->key_size), tree->val_size);
 
-    // Find the parent of the new node
-    TreeNode *parent = tree->root;
-    while (parent != NULL) {
-        int compval = tree->comp(value, parent->value, tree->elem_size); 
+    int inserted;
+    TreeNode *node = tree_find_or_attach(tree, key, key, tree->key_size, &inserted);
+    if (node == NULL) {
+        return NULL;
+    }
 
-        if (compval == 0) { // NO duplicates!!
-            // We have to free this node first
-            node_free(tree->dealloc, new_node);
-            return NULL;
-        } else if (compval < 0) { // Go left
-            if (parent->left == NULL) {
-                // Set for parent node
-                parent->left = new_node;
-                new_node->parent = parent;
-                break;
+    // Overwrite the value in place
+    void *slot = (char *)node_value(tree, node) + tree->val_offset;
+    memcpy(slot, value, tree->val_size);
+
+    return slot;
+}
+
+
+
+void *tree_get_or_insert(Tree *tree, const void *key, int *inserted) {
+    // Sanity check
+    if (tree == NULL || key == NULL) {
+        return NULL;
+    }
+    DS_TRACE_RECORD(tree->trace, DS_TRACE_TREE, DS_TRACE_INSERT, ds_trace_key(key, tree->key_size), tree->val_size);
+
+    int local_inserted;
+    TreeNode *node = tree_find_or_attach(tree, key, key, tree->key_size, &local_inserted);
+    if (node == NULL) {
+        return NULL;
+    }
+    if (inserted != NULL) {
+        *inserted = local_inserted;
+    }
+
+    return (char *)node_value(tree, node) + tree->val_offset;
+}
+
+
+
+
+
+
+
+
+const void *tree_lookup(const Tree *tree, const void *value) {
+    // Sanity check
+    if (tree == NULL || value == NULL) {
+        return NULL;
+    }
+    DS_TRACE_RECORD(tree->trace, DS_TRACE_TREE, DS_TRACE_FIND, ds_trace_key(value, tree->key_size), 0);
+    return tree_lookup_inline(tree, value);
+}
+
+
+void *tree_get_value(const Tree *tree, const void *key) {
+    // Sanity check
+    if (tree == NULL || key == NULL) {
+        return NULL;
+    }
+    DS_TRACE_RECORD(tree->trace, DS_TRACE_TREE, DS_TRACE_FIND, ds_trace_key(key, tree->key_size), 0);
+    return tree_get_value_inline(tree, key);
+}
+
+
+/*********************************** Bounds ***********************************/
+
+/// Find the closest node to [key] in one descent
+///
+/// With [above] set this is the smallest node after [key], otherwise the
+/// largest node before it. With [inclusive] set a node equal to [key] counts.
+static const TreeNode *tree_bound_node(const Tree *tree, const void *key, const int above, const int inclusive) {
+    const TreeNode *node = tree->root, *best = NULL;
+    while (node != NULL) {
+        const int compval = tree_compare(tree, key, node_value(tree, node));
+        if (compval == 0 && inclusive) {
+            return node;
+        }
+        if (above) {
+            if (compval < 0) { // Node is after key, look for a closer one on the left
+                best = node;
+                node = node->left;
+            } else {
+                node = node->right;
             }
-            // Keep going
-            parent = parent->left;
-        } else if (compval > 0) { // Go right
-            if (parent->right == NULL) {
-                // Set for parent node
-                parent->right = new_node;
-                new_node->parent = parent;
-                break;
+        } else {
+            if (compval > 0) { // Node is before key, look for a closer one on the right
+                best = node;
+                node = node->right;
+            } else {
+                node = node->left;
             }
-            // Keep going
-            parent = parent->right;
         }
     }
-    // Parent cannot be null
-    assert(parent != NULL);
+    return best;
+}
 
-    // We have to rotate the grand parent node
-    TreeNode *g_parent = parent->parent;
+/// Get the element of [node] or NULL
+static const void *tree_bound_value(const Tree *tree, const TreeNode *node) {
+    if (node == NULL) {
+        return NULL;
+    }
+    return node_value(tree, node);
+}
 
-    // update heights
-    while (parent != NULL) {
-        node_update_height(parent);
-        parent = parent->parent;
+
+
+const void *tree_lower_bound(const Tree *tree, const void *key) {
+    if (tree == NULL || key == NULL) {
+        return NULL;
     }
+    return tree_bound_value(tree, tree_bound_node(tree, key, 1, 1));
+}
 
-    if (g_parent == NULL) {
+const void *tree_upper_bound(const Tree *tree, const void *key) {
+    if (tree == NULL || key == NULL) {
         return NULL;
     }
-    const Direction dir = child_dir(g_parent);
-    assert(dir != Fail && "Getting direction failed\n");
+    return tree_bound_value(tree, tree_bound_node(tree, key, 1, 0));
+}
 
-    switch (dir) {
-    case Left:
-        g_parent->parent->left = node_balance(g_parent);
-        break;
-    case Right:
-        g_parent->parent->right = node_balance(g_parent);
-        break;
-    case Root:
-        tree->root = node_balance(g_parent);
-        break;
-    case Fail:
-        break;
+const void *tree_ceil(const Tree *tree, const void *key) {
+    return tree_lower_bound(tree, key);
+}
+
+const void *tree_floor(const Tree *tree, const void *key) {
+    if (tree == NULL || key == NULL) {
+        return NULL;
     }
+    return tree_bound_value(tree, tree_bound_node(tree, key, 0, 1));
+}
 
-    // Return buffer to write to
-    return (void *)new_node->value;
+const void *tree_successor(const Tree *tree, const void *key) {
+    return tree_upper_bound(tree, key);
 }
 
+const void *tree_predecessor(const Tree *tree, const void *key) {
+    if (tree == NULL || key == NULL) {
+        return NULL;
+    }
+    return tree_bound_value(tree, tree_bound_node(tree, key, 0, 0));
+}
 
+const void *tree_min(const Tree *tree) {
+    return tree_min_inline(tree);
+}
+
+const void *tree_max(const Tree *tree) {
+    return tree_max_inline(tree);
+}
+
+
+/// Copy the element of an extreme [node] to [out] and delete it
+static int tree_pop_node(Tree *tree, const TreeNode *node, void *out) {
+    if (node == NULL) {
+        return 0;
+    }
+    if (out != NULL) {
+        memcpy(out, node_value(tree, node), tree->elem_size);
+    }
+    // An extreme has at most one child, so its element is not moved while
+    // tree_delete still compares against it
+    tree_delete(tree, node_value(tree, node));
+    return 1;
+}
+
+int tree_pop_min(Tree *tree, void *out) {
+    if (tree == NULL) {
+        return 0;
+    }
+    return tree_pop_node(tree, tree->leftmost, out);
+}
 
+int tree_pop_max(Tree *tree, void *out) {
+    if (tree == NULL) {
+        return 0;
+    }
+    return tree_pop_node(tree, tree->rightmost, out);
+}
 
 
 
+size_t tree_size(const Tree *tree) {
+    return tree_size_inline(tree);
+}
 
 
-static const TreeNode *tree_lookup_node(const Tree *tree, const void *value) {
-    TreeNode *cur_node = tree->root;
-    int compare_value;
-    while (cur_node != NULL) {
-        compare_value = tree->comp(value, cur_node->value, tree->elem_size);
-        if (compare_value == 0) {
-            return cur_node;
-        } else if (compare_value < 0) { // Go left
-            cur_node = cur_node->left;
-        } else { // Go right
-            cur_node = cur_node->right;
-        }
+/// Nodes on the longest path from [node] down
+static size_t node_height(const TreeNode *node) {
+    if (node == NULL) {
+        return 0;
     }
-    return NULL;
+    const size_t left = node_height(node->left);
+    const size_t right = node_height(node->right);
+    return 1 + (left > right ? left : right);
 }
 
-const void *tree_lookup(const Tree *tree, const void *value) {
+
+void tree_stats(const Tree *tree, TreeStats *stats) {
     // Sanity check
-    if (tree == NULL || value == NULL) {
-        return NULL;
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (tree == NULL) {
+        return;
     }
 
-    // Find node
-    const TreeNode *found_node = tree_lookup_node(tree, value);
-
-    if (found_node == NULL) {
-        return NULL;
+#if defined(DS_STATS)
+    stats->counting = 1;
+    stats->compares = tree->stat_compares;
+    stats->rotations = tree->stat_rotations;
+#endif
+    ds_alloc_state_stats(&tree->heap, &stats->alloc);
+    stats->size = tree->size;
+    stats->height = node_height(tree->root);
+
+    // A perfect tree of height h holds 2^h - 1 nodes
+    while (stats->ideal_height < 64 && (((uint64_t)1 << stats->ideal_height) - 1) < tree->size) {
+        stats->ideal_height++;
     }
+    stats->node_bytes = tree->node_size;
+    stats->overhead_bytes = (tree->node_size - tree->elem_size) * tree->size;
+}
+
+
 
-    // return value
-    return found_node->value;
+int tree_set_trace(Tree *tree, DsTrace *trace) {
+    // Sanity check
+    if (tree == NULL) {
+        return 0;
+    }
 
+#if defined(DS_TRACE)
+    tree->trace = trace;
+    return 1;
+#else
+    (void)trace;
+    return 0;
+#endif
 }
 
 
-static void free_nodes(TreeNode *root, TreeFreeFn dealloc) {
+static void free_nodes(const Tree *tree, TreeNode *root) {
     if (root == NULL) {
         return;
     } else if (root->left == NULL && root->right == NULL) {
-        node_free(dealloc, root);
+        node_free(tree, root);
     } else {
-        free_nodes(root->left, dealloc);
-        free_nodes(root->right, dealloc);
-        dealloc(root);
+        free_nodes(tree, root->left);
+        free_nodes(tree, root->right);
+        node_free(tree, root);
     }
 }
 
@@ -470,102 +819,87 @@ void tree_delete(Tree *tree, const void *value) {
     if (tree == NULL || value == NULL) {
         return;
     }
+    DS_TRACE_RECORD(tree->trace, DS_TRACE_TREE, DS_TRACE_REMOVE, ds_trace_key(value, tree->key_size), 0);
+
+    TreeNode *path[TREE_MAX_HEIGHT];
+    unsigned char dirs[TREE_MAX_HEIGHT];
+    size_t depth = 0;
 
     // find node to delete
-    TreeNode *to_delete = (TreeNode *) tree_lookup_node(tree, value);
-    TreeNode *to_del_parent = to_delete->parent;
-    if (to_delete == NULL) {
-        return;
-    }
+    TreeNode *to_delete = tree->root;
     while (to_delete != NULL) {
-        if (to_delete->left != NULL && to_delete->right != NULL) {
-            // Find next greater
-            TreeNode *next = to_delete->left;
-            while (next->right != NULL) {
-                next = next->right;
-            }
-            // Replace value
-            to_delete-> value = next->value;
-
-            // Now delete the next
-            to_delete = next;
-        } else if (to_delete->left != NULL) {
-            const Direction dir = child_dir(to_delete);
-            switch (dir) {
-            case Left:
-                to_delete->parent->left = to_delete->left;
-                to_delete->left->parent = to_delete->parent;
-                break;
-            case Right:
-                to_delete->parent->right = to_delete->left;
-                to_delete->left->parent = to_delete->parent;
-                break;
-            case Root:
-                tree->root = to_delete->left;
-                to_delete->left->parent = NULL;
-                break;
-            case Fail:
-                break;
-            }
-            node_free(tree->dealloc, to_delete);
-            break;
-        } else if (to_delete->right != NULL) {
-            const Direction dir = child_dir(to_delete);
-            switch (dir) {
-            case Left:
-                to_delete->parent->left = to_delete->right;
-                to_delete->right->parent = to_delete->parent;
-                break;
-            case Right:
-                to_delete->parent->right = to_delete->right;
-                to_delete->right->parent = to_delete->parent;
-                break;
-            case Root:
-                tree->root = to_delete->right;
-                to_delete->right->parent = NULL;
-                break;
-            case Fail:
-                break;
-            }
-            node_free(tree->dealloc, to_delete);
-            break;
-        } else { // Both are NULL
-            const Direction dir = child_dir(to_delete);
-            switch (dir) {
-            case Left:
-                to_delete->parent->left = NULL;
-                break;
-            case Right:
-                to_delete->parent->right = NULL;
-                break;
-            case Root:
-                tree->root = NULL;
-                break;
-            case Fail:
-                break;
-            }
-            node_free(tree->dealloc, to_delete);
+        int compval = tree_compare(tree, value, node_value(tree, to_delete));
+        if (compval == 0) {
             break;
         }
+        path[depth] = to_delete;
+        dirs[depth] = compval > 0;
+        depth++;
+        to_delete = compval < 0 ? to_delete->left : to_delete->right;
+    }
+    if (to_delete == NULL) {
+        return;
+    }
 
-        if (to_del_parent == NULL) {
-            return;
+    if (to_delete->left != NULL && to_delete->right != NULL) {
+        // Find next smaller
+        TreeNode *replaced = to_delete;
+        path[depth] = to_delete;
+        dirs[depth] = 0;
+        depth++;
+        to_delete = to_delete->left;
+        while (to_delete->right != NULL) {
+            path[depth] = to_delete;
+            dirs[depth] = 1;
+            depth++;
+            to_delete = to_delete->right;
         }
-        const Direction dir = child_dir(to_del_parent);
+        // Replace value, then delete the next smaller
+        memcpy(node_value(tree, replaced), node_value(tree, to_delete), tree->elem_size);
+    }
 
-        switch (dir) {
-        case Left:
-            to_del_parent->parent->left = node_balance(to_del_parent);
-            break;
-        case Right:
-            to_del_parent->parent->right = node_balance(to_del_parent);
-            break;
-        case Root:
-            tree->root = node_balance(to_del_parent);
-            break;
-        case Fail:
+    // At this point [to_delete] has at most one child
+    TreeNode *child = to_delete->left != NULL ? to_delete->left : to_delete->right;
+
+    // An extreme is replaced by the closest node of its child or its parent
+    TreeNode *new_extreme = depth == 0 ? NULL : path[depth - 1];
+    if (child != NULL) {
+        new_extreme = child;
+        while ((to_delete == tree->leftmost ? new_extreme->left : new_extreme->right) != NULL) {
+            new_extreme = to_delete == tree->leftmost ? new_extreme->left : new_extreme->right;
+        }
+    }
+    if (to_delete == tree->leftmost) {
+        tree->leftmost = new_extreme;
+    }
+    if (to_delete == tree->rightmost) {
+        tree->rightmost = new_extreme;
+    }
+    tree_set_link(tree, path, dirs, depth, child);
+    node_set_parent(tree, child, depth == 0 ? NULL : path[depth - 1]);
+    node_free(tree, to_delete);
+    tree->size--;
+
+    // Fix balance factors on the way up, max ends all the way up
+    int balancing = 1;
+    for (size_t i = depth; i-- > 0;) {
+        TreeNode *node = path[i];
+        if (balancing) {
+            const int8_t bal = node_bal(tree, node) - (dirs[i] ? 1 : -1);
+            node_set_bal(tree, node, bal);
+            if (bal == 1 || bal == -1) { // Height did not change
+                balancing = 0;
+            } else if (bal == 2 || bal == -2) {
+                node = node_balance(tree, node);
+                tree_set_link(tree, path, dirs, i, node);
+                if (node_bal(tree, node) != 0) { // Rotation kept the height
+                    balancing = 0;
+                }
+            }
+        } else if (tree->point_size == 0) {
             break;
         }
+        node_update_max(tree, node);
     }
 }
 
@@ -576,10 +910,207 @@ void tree_free(Tree *tree) {
         return;
     }
     // Free all nodes
-    free_nodes(tree->root, tree->dealloc);
+    free_nodes(tree, tree->root);
+
+    const DsAllocState heap = tree->heap;
+    ds_state_free(&heap, tree, sizeof(Tree));
+}
+
+
+/********************************* Intervals **********************************/
+
+/// Visit the intervals in the subtree of [node] that overlap [lo, hi]
+///
+/// Subtrees whose max end lies before [lo] are skipped, and so is everything
+/// right of a node that starts after [hi].
+///
+/// Returns:
+///   1 if [visit] asked to stop, 0 otherwise
+static int tree_overlaps_node(const Tree *tree, const TreeNode *node, const void *lo, const void *hi,
+        const TreeVisitFn visit, void *ctx, size_t *count) {
+    const size_t point_size = tree->point_size;
+    while (node != NULL) {
+        // Nothing in this subtree ends at or after lo
+        if (tree->comp(node_max(tree, node), lo, point_size) < 0) {
+            return 0;
+        }
+
+        if (tree_overlaps_node(tree, node->left, lo, hi, visit, ctx, count)) {
+            return 1;
+        }
+
+        // This node and everything right of it starts after hi
+        const char *elem = node_value(tree, node);
+        if (tree->comp(elem, hi, point_size) > 0) {
+            return 0;
+        }
+
+        if (tree->comp(elem + point_size, lo, point_size) >= 0) {
+            (*count)++;
+            if (visit != NULL && visit(elem, ctx)) {
+                return 1;
+            }
+        }
+        node = node->right;
+    }
+    return 0;
+}
+
+
+
+size_t tree_overlaps(const Tree *tree, const void *lo, const void *hi, const TreeVisitFn visit, void *ctx) {
+    // Sanity check
+    if (tree == NULL || lo == NULL || hi == NULL || tree->point_size == 0) {
+        return 0;
+    }
+
+    size_t count = 0;
+    tree_overlaps_node(tree, tree->root, lo, hi, visit, ctx, &count);
+    return count;
+}
+
+
+
+size_t tree_stab(const Tree *tree, const void *point, const TreeVisitFn visit, void *ctx) {
+    return tree_overlaps(tree, point, point, visit, ctx);
+}
+
+
+/********************************** Snapshot **********************************/
+
+int tree_save(const Tree *tree, const char *path) {
+    // Sanity check
+    if (tree == NULL || path == NULL) {
+        return -1;
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    // The checksum is only known at the end, the header is rewritten then
+    DsSnapshotHeader header;
+    ds_snapshot_header_init(&header, DS_SNAPSHOT_MAGIC_TREE, tree->elem_size, tree->key_size, tree->val_size, tree->size);
+    header.point_size = tree->point_size;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    DsChecksum sum;
+    ds_checksum_init(&sum);
+    TreeCursor cursor;
+    for (const TreeNode *node = tree_cursor_first(tree, &cursor); ok && node != NULL;
+            node = tree_cursor_next(tree, &cursor)) {
+        ds_checksum_update(&sum, node_value(tree, node), tree->elem_size);
+        ok = fwrite(node_value(tree, node), tree->elem_size, 1, file) == 1;
+    }
+
+    header.checksum = ds_checksum_final(&sum);
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok ? 0 : -1;
+}
+
+
+
+/// Build a balanced subtree out of the next [count] elements of [file]
+///
+/// The left half is built first, so the elements are read in order. Nodes are
+/// linked in before anything is read, a failure leaves a tree that can still
+/// be freed and sets [ok] to 0. The height of the subtree goes to [height].
+static TreeNode *tree_build_sorted(Tree *tree, FILE *file, const size_t count, TreeNode *parent,
+        DsChecksum *sum, int *ok, size_t *height) {
+    *height = 0;
+    if (count == 0 || !*ok) {
+        return NULL;
+    }
+
+    TreeNode *node = node_init(tree, NULL, 0, parent);
+    if (node == NULL) {
+        *ok = 0;
+        return NULL;
+    }
+
+    size_t left_height, right_height;
+    const size_t left_count = count / 2;
+    node->left = tree_build_sorted(tree, file, left_count, node, sum, ok, &left_height);
+
+    if (*ok && fread(node_value(tree, node), tree->elem_size, 1, file) == 1) {
+        ds_checksum_update(sum, node_value(tree, node), tree->elem_size);
+    } else {
+        *ok = 0;
+    }
+
+    node->right = tree_build_sorted(tree, file, count - left_count - 1, node, sum, ok, &right_height);
+
+    // Right half is never smaller, so this is 0 or 1 for a complete build
+    node_set_bal(tree, node, (int8_t)(right_height - left_height));
+    node_update_max(tree, node);
+    *height = 1 + max(left_height, right_height);
+
+    return node;
+}
+
+
+
+Tree *tree_load(const char *path, const TreeAllocFn alloc, const TreeFreeFn dealloc, const TreeComparator comp) {
+    // Sanity check
+    if (path == NULL) {
+        return NULL;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    DsSnapshotHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+            !ds_snapshot_header_ok(&header, DS_SNAPSHOT_MAGIC_TREE)) {
+        fclose(file);
+        return NULL;
+    }
+
+    if (header.point_size != 0 && header.key_size != 2 * header.point_size) {
+        fclose(file);
+        return NULL;
+    }
+
+    DsAllocState heap;
+    ds_alloc_state_fns(&heap, alloc, dealloc);
+    Tree *tree = tree_create(header.key_size, header.val_size, header.point_size, TREE_DEFAULT, &heap, comp);
+    if (tree == NULL || tree->elem_size != header.elem_size) {
+        tree_free(tree);
+        fclose(file);
+        return NULL;
+    }
+
+    DsChecksum sum;
+    ds_checksum_init(&sum);
+    int ok = 1;
+    size_t height;
+    tree->root = tree_build_sorted(tree, file, header.count, NULL, &sum, &ok, &height);
+    tree->size = header.count;
+    fclose(file);
+
+    // Find the extremes
+    tree->leftmost = tree->root;
+    tree->rightmost = tree->root;
+    while (tree->leftmost != NULL && tree->leftmost->left != NULL) {
+        tree->leftmost = tree->leftmost->left;
+    }
+    while (tree->rightmost != NULL && tree->rightmost->right != NULL) {
+        tree->rightmost = tree->rightmost->right;
+    }
+
+    if (!ok || ds_checksum_final(&sum) != header.checksum) {
+        tree_free(tree);
+        return NULL;
+    }
 
-    TreeFreeFn dealloc = tree->dealloc;
-    dealloc(tree);
+    return tree;
 }
 
 
@@ -590,7 +1121,7 @@ void *tree_init_buf(const Tree *tree) {
     if (tree == NULL) {
         return NULL;
     }
-    void *new_buf = tree->alloc(tree->elem_size * 1);
+    void *new_buf = ds_state_alloc(&tree->heap, tree->elem_size * 1);
     if (new_buf == NULL) {
         return NULL;
     }
@@ -605,5 +1136,5 @@ void tree_free_buf(const Tree *tree, void *buf) {
     }
 
     // Free buffer
-    tree->dealloc(buf);
+    ds_state_free(&tree->heap, buf, tree->elem_size);
 }
@@ -0,0 +1,239 @@
+#ifndef JAZZY_TREE_INTERNAL_H
+#define JAZZY_TREE_INTERNAL_H
+
+// Header file
+#include "../../include/tree.h"
+#include "../common/alloc_internal.h"
+#include "../common/stats_internal.h"
+#include "../common/trace_internal.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+
+
+/// Layout of the tree and its nodes. This is shared between the source files
+/// in src/tree and is not part of the public interface.
+
+
+/// Upper bound for the height of an AVL tree. A tree of height h holds at
+/// least fib(h + 2) - 1 nodes, which exceeds 2^64 long before h reaches this.
+#define TREE_MAX_HEIGHT 96
+
+
+/********************************* TreeNode ***********************************/
+
+typedef struct _TreeNode TreeNode;
+
+
+/// A node is laid out in one allocation of tree->node_size bytes:
+///
+///   left | right | parent (unless TREE_NO_PARENT) | element | max end | balance
+///
+/// The element starts at tree->elem_offset and the balance factor is a single
+/// signed byte at tree->bal_offset, right height minus left height. The max
+/// end is only there in interval trees, it is the largest end point in the
+/// subtree of the node.
+struct _TreeNode {
+    TreeNode *left;
+    TreeNode *right;
+};
+
+
+
+/********************************* Tree ***************************************/
+
+struct _Tree {
+    size_t elem_size; /* val_offset + val_size */
+    size_t key_size; /* Bytes passed to comp */
+    size_t val_size; /* 0 if this is not a map */
+    size_t val_offset; /* key_size padded to the alignment of the value */
+    size_t point_size; /* Size of an end point, 0 if this is not an interval tree */
+    size_t elem_offset; /* Offset of the element inside a node */
+    size_t max_offset; /* Offset of the max end inside a node */
+    size_t bal_offset; /* Offset of the balance factor inside a node */
+    size_t node_size; /* Rounded up to TREE_NODE_ALIGN */
+    size_t size;
+    int flags;
+    TreeNode *root;
+    TreeNode *leftmost; /* Smallest node, NULL if empty */
+    TreeNode *rightmost; /* Largest node, NULL if empty */
+    DsAllocState heap;
+    TreeComparator comp;
+#if defined(DS_STATS)
+    uint64_t stat_compares; /* Comparator calls of insertions */
+    uint64_t stat_rotations;
+#endif
+#if defined(DS_TRACE)
+    DsTrace *trace; /* NULL if not recording */
+#endif
+};
+
+
+
+/******************************** Comparison **********************************/
+
+/// Compare two keys
+///
+/// Keys of an interval tree are a start and an end point, they are ordered
+/// by start first and by end second. All other keys are passed to [comp] as
+/// a whole.
+static inline int tree_key_compare(const TreeComparator comp, const size_t key_size, const size_t point_size,
+        const void *a, const void *b) {
+    if (point_size == 0) {
+        return comp(a, b, key_size);
+    }
+    const int compval = comp(a, b, point_size);
+    if (compval != 0) {
+        return compval;
+    }
+    return comp((const char *)a + point_size, (const char *)b + point_size, point_size);
+}
+
+static inline int tree_compare(const Tree *tree, const void *a, const void *b) {
+    return tree_key_compare(tree->comp, tree->key_size, tree->point_size, a, b);
+}
+
+
+
+/****************************** Node accessors ********************************/
+
+static inline void *node_value(const Tree *tree, const TreeNode *node) {
+    return (char *)node + tree->elem_offset;
+}
+
+static inline void *node_max(const Tree *tree, const TreeNode *node) {
+    return (char *)node + tree->max_offset;
+}
+
+static inline int8_t node_bal(const Tree *tree, const TreeNode *node) {
+    return *((const int8_t *)node + tree->bal_offset);
+}
+
+static inline void node_set_bal(const Tree *tree, TreeNode *node, const int8_t bal) {
+    *((int8_t *)node + tree->bal_offset) = bal;
+}
+
+static inline TreeNode *node_parent(const Tree *tree, const TreeNode *node) {
+    if (tree->flags & TREE_NO_PARENT) {
+        return NULL;
+    }
+    return *(TreeNode *const *)(node + 1);
+}
+
+static inline void node_set_parent(const Tree *tree, TreeNode *node, TreeNode *parent) {
+    if (node != NULL && !(tree->flags & TREE_NO_PARENT)) {
+        *(TreeNode **)(node + 1) = parent;
+    }
+}
+
+
+
+/******************************** Traversal ***********************************/
+
+/// In-order cursor
+///
+/// With parent pointers the cursor climbs up the tree, otherwise it keeps the
+/// ancestors it still has to visit on a stack.
+typedef struct {
+    const TreeNode *node;
+    const TreeNode *stack[TREE_MAX_HEIGHT];
+    size_t depth;
+} TreeCursor;
+
+
+/// Go to the smallest node of the subtree at [node]
+static inline const TreeNode *tree_cursor_descend(const Tree *tree, TreeCursor *cursor, const TreeNode *node) {
+    if (node == NULL) {
+        cursor->node = NULL;
+        return NULL;
+    }
+    while (node->left != NULL) {
+        if (tree->flags & TREE_NO_PARENT) {
+            cursor->stack[cursor->depth++] = node;
+        }
+        node = node->left;
+    }
+    cursor->node = node;
+    return node;
+}
+
+/// Start at the smallest node of [tree]
+static inline const TreeNode *tree_cursor_first(const Tree *tree, TreeCursor *cursor) {
+    cursor->depth = 0;
+    return tree_cursor_descend(tree, cursor, tree->root);
+}
+
+/// Advance to the in-order successor or NULL if it was the last one
+static inline const TreeNode *tree_cursor_next(const Tree *tree, TreeCursor *cursor) {
+    const TreeNode *node = cursor->node;
+    if (node == NULL) {
+        return NULL;
+    }
+    if (node->right != NULL) {
+        return tree_cursor_descend(tree, cursor, node->right);
+    }
+
+    if (tree->flags & TREE_NO_PARENT) {
+        cursor->node = cursor->depth == 0 ? NULL : cursor->stack[--cursor->depth];
+        return cursor->node;
+    }
+
+    const TreeNode *parent = node_parent(tree, node);
+    while (parent != NULL && parent->right == node) {
+        node = parent;
+        parent = node_parent(tree, node);
+    }
+    cursor->node = parent;
+    return parent;
+}
+
+
+
+/******************************** Fast paths **********************************/
+
+/// Lookups and accessors without recording. Insertions and deletions stay
+/// out of line, rebalancing is too large to inline.
+
+
+static inline const TreeNode *tree_lookup_node(const Tree *tree, const void *value) {
+    const TreeNode *cur_node = tree->root;
+    while (cur_node != NULL) {
+        const int compare_value = tree_compare(tree, value, node_value(tree, cur_node));
+        if (compare_value == 0) {
+            return cur_node;
+        }
+        cur_node = compare_value < 0 ? cur_node->left : cur_node->right;
+    }
+    return NULL;
+}
+
+static inline const void *tree_lookup_inline(const Tree *tree, const void *value) {
+    if (tree == NULL || value == NULL) {
+        return NULL;
+    }
+    const TreeNode *node = tree_lookup_node(tree, value);
+    return node == NULL ? NULL : node_value(tree, node);
+}
+
+static inline void *tree_get_value_inline(const Tree *tree, const void *key) {
+    if (tree == NULL || key == NULL) {
+        return NULL;
+    }
+    const TreeNode *node = tree_lookup_node(tree, key);
+    return node == NULL ? NULL : (char *)node_value(tree, node) + tree->val_offset;
+}
+
+static inline size_t tree_size_inline(const Tree *tree) {
+    return tree == NULL ? 0 : tree->size;
+}
+
+static inline const void *tree_min_inline(const Tree *tree) {
+    return tree == NULL || tree->leftmost == NULL ? NULL : node_value(tree, tree->leftmost);
+}
+
+static inline const void *tree_max_inline(const Tree *tree) {
+    return tree == NULL || tree->rightmost == NULL ? NULL : node_value(tree, tree->rightmost);
+}
+
+#endif
@@ -1,10 +1,23 @@
+// Needed for mmap
+#define _POSIX_C_SOURCE 200809L
+
 // Header file
 #include "../../include/vector.h"
+#include "../common/alloc_internal.h"
+#include "../common/snapshot.h"
+#include "../common/stats_internal.h"
+#include "../common/trace_internal.h"
+#include "vector_internal.h"
 
 // Libraries
+#include <fcntl.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 /********************************** Private ***********************************/
@@ -14,45 +27,76 @@
 
 
 
-struct _vector {
-    size_t cap;
-    size_t len;
-    size_t elem_size;
-    VecAllocFn alloc;
-    VecFreeFn dealloc;
-    void *stroage;
-};
+/// Release the storage of [vec] according to where it came from
+static void vector_release_storage(Vector *vec) {
+    if (vec->map_base != NULL) {
+        munmap(vec->map_base, vec->map_len);
+        vec->map_base = NULL;
+        vec->map_len = 0;
+    } else {
+        ds_state_free(&vec->heap, vec->stroage, vec->cap * vec->elem_size);
+    }
+}
 
 
 
-/// Initialize a vector
-///
-/// This function initializes a vector. It allocates memory
-/// according to [alloc].
-///
-/// Parameters:
-///   - alloc: an allocator function the function malloc is of this type
-///   - dealloc: a function that frees memory
-///   - elemsize: sizeof the elements that will be stored
-Vector *vector_init(const VecAllocFn alloc, const VecFreeFn dealloc, const size_t elemsize) {
-    // check if input is valid
-    VecAllocFn local_all = alloc;
-    VecFreeFn local_dea = dealloc;
-    if (alloc == NULL || dealloc == NULL) {
-        local_all = malloc;
-        local_dea = free;
+int vector_grow(Vector *vec, const size_t cap) {
+    if (cap <= vec->cap) {
+        return 1;
     }
+    const size_t old_size = vec->cap * vec->elem_size;
+    const size_t new_size = cap * vec->elem_size;
+    void *new_stroage;
+    if (vec->map_base != NULL) {
+        // A mapping can not be resized, copy it into new storage
+        new_stroage = ds_state_alloc(&vec->heap, new_size);
+        if (new_stroage == NULL) {
+            return 0;
+        }
+        memcpy(new_stroage, vec->stroage, vec->elem_size * vec->len);
+        DS_STAT_ADD(vec->stat_copy_bytes, vec->elem_size * vec->len);
+        vector_release_storage(vec);
+    } else {
+#if defined(DS_STATS)
+        const uintptr_t old_address = (uintptr_t)vec->stroage;
+#endif
+        new_stroage = ds_state_realloc(&vec->heap, vec->stroage, old_size, new_size);
+        if (new_stroage == NULL) {
+            return 0;
+        }
+#if defined(DS_STATS)
+        // Growing in place copies nothing
+        if ((uintptr_t)new_stroage != old_address) {
+            vec->stat_copy_bytes += old_size;
+        }
+#endif
+    }
+    DS_STAT_ADD(vec->stat_grows, 1);
+
+    // Set everything behind the elements to 0
+    const size_t used_size = vec->len * vec->elem_size;
+    memset((char *)new_stroage + used_size, 0, new_size - used_size);
+
+    // Update vec's capacity and assign new storage
+    vec->cap = cap;
+    vec->stroage = new_stroage;
+    return 1;
+}
+
+
 
+/// Shared by both initializers
+Vector *vector_create(const DsAllocState *heap, const size_t elemsize) {
     // Allocate struct
-    Vector *vector = local_all(sizeof(Vector));
+    Vector *vector = ds_state_alloc(heap, sizeof(Vector));
     if (vector == NULL) {
         return NULL;
     }
 
     // Allocate storage
-    void *new_storage = local_all(elemsize * VEC_INIT_SIZE);
+    void *new_storage = ds_state_alloc(heap, elemsize * VEC_INIT_SIZE);
     if (new_storage == NULL) {
-        local_dea(vector);
+        ds_state_free(heap, vector, sizeof(Vector));
         return NULL;
     }
     // Zero out
@@ -62,15 +106,56 @@ Vector *vector_init(const VecAllocFn alloc, const VecFreeFn dealloc, const size_
     vector->cap = VEC_INIT_SIZE;
     vector->len = 0;
     vector->elem_size = elemsize;
-    vector->alloc = alloc;
-    vector->dealloc = dealloc;
+    vector->heap = *heap;
     vector->stroage = new_storage;
+    vector->map_base = NULL;
+    vector->map_len = 0;
+#if defined(DS_STATS)
+    vector->stat_grows = 0;
+    vector->stat_copy_bytes = 0;
+#endif
+#if defined(DS_TRACE)
+    vector->trace = NULL;
+#endif
 
     return vector;
 }
 
 
 
+/// Initialize a vector
+///
+/// This function initializes a vector. It allocates memory
+/// according to [alloc].
+///
+/// Parameters:
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///   - elemsize: sizeof the elements that will be stored
+Vector *vector_init(const VecAllocFn alloc, const VecFreeFn dealloc, const size_t elemsize) {
+    DsAllocState heap;
+    ds_alloc_state_fns(&heap, alloc, dealloc);
+    return vector_create(&heap, elemsize);
+}
+
+
+
+/// Initialize a vector with a DsAllocator
+///
+/// This function works like `vector_init`, but all memory comes from
+/// [allocator].
+///
+/// Parameters:
+///   - allocator: the allocator, NULL for malloc and free
+///   - elemsize: sizeof the elements that will be stored
+Vector *vector_init_alloc(const DsAllocator *allocator, const size_t elemsize) {
+    DsAllocState heap;
+    ds_alloc_state_init(&heap, allocator);
+    return vector_create(&heap, elemsize);
+}
+
+
+
 
 
 /// Push a value into the vector
@@ -90,33 +175,9 @@ void vector_insert(Vector *vec, void *data, size_t data_len) {
     if (data_len != vec->elem_size) {
         return;
     }
-    if (vec->len >= vec->cap - 1) {
-        // Allocate new storage
-        void *new_stroage = vec->alloc(vec->cap * 2 * vec->elem_size);
-        if (new_stroage == NULL) {
-            return;
-        }
-
-        // Copy old storage
-        memcpy(new_stroage, vec->stroage, vec->elem_size * vec->len);
-
-        // calculate the border pointer
-        void *border_ptr = (char *)new_stroage + vec->cap *vec->elem_size;
-
-        // Determine restsize (which is still the half)
-        const size_t rest_size =  vec->cap * vec->elem_size;
-
-        // Set the rest to 0
-        memset(border_ptr, 0, rest_size);
-
-        // Update vec's capacity
-        vec->cap *= 2;
-
-        // Free old storage
-        vec->dealloc(vec->stroage);
-
-        // Assign new storage
-        vec->stroage = new_stroage;
+    DS_TRACE_RECORD(vec->trace, DS_TRACE_VECTOR, DS_TRACE_INSERT, vec->len, data_len);
+    if (vec->len >= vec->cap - 1 && !vector_grow(vec, vec->cap * 2)) {
+        return;
     }
 
     // Determine pointer to write at
@@ -143,14 +204,12 @@ void vector_free(Vector *vec) {
         return;
     }
 
-    // Store pointer to free function
-    VecFreeFn freefunc = vec->dealloc;
-
-    // Free storage first 
-    freefunc(vec->stroage);
+    // Free storage first
+    vector_release_storage(vec);
 
     // Free actual struct
-    freefunc(vec);
+    const DsAllocState heap = vec->heap;
+    ds_state_free(&heap, vec, sizeof(Vector));
 }
 
 
@@ -170,14 +229,8 @@ void *vector_at(const Vector *vec, const size_t index) {
     if (vec == NULL) {
         return NULL;
     }
-    // Check if index is correct
-    if (index >= vec->len) {
-        return NULL;
-    }
-    // Determine pointer to look for
-    void *lookup_ptr = (char *)vec->stroage + (vec->elem_size * index);
-
-    return lookup_ptr;
+    DS_TRACE_RECORD(vec->trace, DS_TRACE_VECTOR, DS_TRACE_FIND, index, 0);
+    return vector_at_inline(vec, index);
 }
 
 
@@ -192,10 +245,7 @@ void *vector_at(const Vector *vec, const size_t index) {
 /// Returns:
 ///   amount of elements in the vector. Length of NULL is 0;
 size_t vector_size(const Vector *vec) {
-    if (vec == NULL) {
-        return 0;
-    }
-    return vec->len;
+    return vector_size_inline(vec);
 }
 
 /// Get size of the elements in the vector
@@ -208,10 +258,7 @@ size_t vector_size(const Vector *vec) {
 /// Returns:
 ///   size of elements in the vector. if vec is NULL, 0 is returned;
 size_t vector_elem_size(const Vector *vec) {
-    if (vec == NULL) {
-        return 0;
-    }
-    return vec->elem_size;
+    return vector_elem_size_inline(vec);
 }
 
 
@@ -223,12 +270,13 @@ size_t vector_elem_size(const Vector *vec) {
 ///   - vec: handle to a Vector that was returned by `vec_init`
 ///
 /// Returns:
-///   function pointer to the alloc function, NULL if [vec] is NULL
+///   function pointer to the alloc function, NULL if [vec] is NULL or was
+///   initialized with a DsAllocator
 VecAllocFn vector_alloc_fn(const Vector *vec) {
     if (vec == NULL) {
         return NULL;
     }
-    return vec->alloc;
+    return vec->heap.alloc;
 }
 
 
@@ -240,15 +288,287 @@ VecAllocFn vector_alloc_fn(const Vector *vec) {
 ///   - vec: handle to a Vector that was returned by `vec_init`
 ///
 /// Returns:
-///   function pointer to the alloc function, NULL if [vec] is NULL
+///   function pointer to the alloc function, NULL if [vec] is NULL or was
+///   initialized with a DsAllocator
 VecFreeFn vector_dealloc_fn(const Vector *vec) {
     if (vec == NULL) {
         return NULL;
     }
-    return vec->dealloc;
+    return vec->heap.dealloc;
+}
+
+
+/// Get statistics of a vector
+///
+/// This function fills [stats] with the counters of [vec] and its current
+/// shape. The counters are only kept if the library was built with DS_STATS.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - stats: filled with the statistics, all 0 if [vec] is NULL
+void vector_stats(const Vector *vec, VectorStats *stats) {
+    // Sanity check
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (vec == NULL) {
+        return;
+    }
+
+#if defined(DS_STATS)
+    stats->counting = 1;
+    stats->grows = vec->stat_grows;
+    stats->copy_bytes = vec->stat_copy_bytes;
+#endif
+    ds_alloc_state_stats(&vec->heap, &stats->alloc);
+    stats->len = vec->len;
+    stats->cap = vec->cap;
+    stats->slack_bytes = (vec->cap - vec->len) * vec->elem_size;
 }
 
 
+
+/// Record the operations on a vector
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - trace: trace that was returned by `ds_trace_open`, NULL to stop
+int vector_set_trace(Vector *vec, DsTrace *trace) {
+    // Sanity check
+    if (vec == NULL) {
+        return 0;
+    }
+
+#if defined(DS_TRACE)
+    vec->trace = trace;
+    return 1;
+#else
+    (void)trace;
+    return 0;
+#endif
+}
+
+
+/********************************** Snapshot **********************************/
+
+
+/// Save a vector to a file
+///
+/// This function writes a snapshot of [vec] to [path]. An existing file is
+/// overwritten.
+///
+/// Parameters:
+///   - vec: handle to a Vector that was returned by `vec_init`
+///   - path: path of the file to write
+///
+/// Returns:
+///   0 on success, -1 if the file could not be written
+int vector_save(const Vector *vec, const char *path) {
+    // Sanity check
+    if (vec == NULL || path == NULL) {
+        return -1;
+    }
+
+    DsSnapshotHeader header;
+    ds_snapshot_header_init(&header, DS_SNAPSHOT_MAGIC_VECTOR, vec->elem_size, vec->elem_size, 0, vec->len);
+
+    // Elements are contiguous, so they can be summed up front
+    DsChecksum sum;
+    ds_checksum_init(&sum);
+    ds_checksum_update(&sum, vec->stroage, vec->elem_size * vec->len);
+    header.checksum = ds_checksum_final(&sum);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && vec->len != 0) {
+        ok = fwrite(vec->stroage, vec->elem_size, vec->len, file) == vec->len;
+    }
+
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok ? 0 : -1;
+}
+
+
+
+/// Read and check the header of a vector snapshot
+static int vector_read_header(FILE *file, DsSnapshotHeader *header) {
+    if (fread(header, sizeof(*header), 1, file) != 1) {
+        return 0;
+    }
+    return ds_snapshot_header_ok(header, DS_SNAPSHOT_MAGIC_VECTOR) && header->elem_size != 0;
+}
+
+
+
+/// Load a vector from a file
+///
+/// This function reads a snapshot that was written by `vector_save` and copies
+/// its elements into a new vector.
+///
+/// Parameters:
+///   - path: path of the file to read
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///
+/// Returns:
+///   a new vector or NULL if the file is invalid or memory allocation fails
+Vector *vector_load(const char *path, const VecAllocFn alloc, const VecFreeFn dealloc) {
+    // Sanity check
+    if (path == NULL) {
+        return NULL;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    DsSnapshotHeader header;
+    struct stat info;
+    if (!vector_read_header(file, &header) || fstat(fileno(file), &info) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    // The elements have to fit into the file, which also keeps the sizes below from overflowing
+    const uint64_t file_len = info.st_size < 0 ? 0 : (uint64_t)info.st_size;
+    if (file_len < sizeof(header) || header.count > (file_len - sizeof(header)) / header.elem_size) {
+        fclose(file);
+        return NULL;
+    }
+
+    // Size the storage so the next insert does not have to grow it
+    size_t cap = VEC_INIT_SIZE;
+    while (cap <= header.count + 1) {
+        if (cap > SIZE_MAX / 2 / header.elem_size) {
+            fclose(file);
+            return NULL;
+        }
+        cap *= 2;
+    }
+
+    Vector *vec = vector_init(alloc, dealloc, header.elem_size);
+    if (vec == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    if (cap != vec->cap) {
+        void *new_stroage = ds_state_alloc(&vec->heap, cap * vec->elem_size);
+        if (new_stroage == NULL) {
+            vector_free(vec);
+            fclose(file);
+            return NULL;
+        }
+        vector_release_storage(vec);
+        vec->stroage = new_stroage;
+        vec->cap = cap;
+    }
+
+    const size_t data_len = header.count * header.elem_size;
+    int ok = fread(vec->stroage, header.elem_size, header.count, file) == header.count;
+    fclose(file);
+
+    // Verify the data
+    DsChecksum sum;
+    ds_checksum_init(&sum);
+    ds_checksum_update(&sum, vec->stroage, data_len);
+    if (!ok || ds_checksum_final(&sum) != header.checksum) {
+        vector_free(vec);
+        return NULL;
+    }
+
+    memset((char *)vec->stroage + data_len, 0, (cap - header.count) * header.elem_size);
+    vec->len = header.count;
+
+    return vec;
+}
+
+
+
+/// Map a vector from a file
+///
+/// This function works like `vector_load` but the elements are not copied.
+/// They are mapped privately from [path], so pages are only read when they
+/// are touched and changes are never written back. The mapping is replaced
+/// by regular storage the first time the vector grows.
+///
+/// Parameters:
+///   - path: path of the file to map
+///   - alloc: an allocator function the function malloc is of this type
+///   - dealloc: a function that frees memory
+///
+/// Returns:
+///   a new vector or NULL if the file is invalid or mapping it fails
+Vector *vector_map(const char *path, const VecAllocFn alloc, const VecFreeFn dealloc) {
+    // Sanity check
+    if (path == NULL) {
+        return NULL;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(DsSnapshotHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    const size_t map_len = info.st_size;
+    void *map_base = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map_base == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Check header and size
+    DsSnapshotHeader header;
+    memcpy(&header, map_base, sizeof(header));
+    void *data = (char *)map_base + sizeof(header);
+    const size_t data_len = header.count * header.elem_size;
+    if (!ds_snapshot_header_ok(&header, DS_SNAPSHOT_MAGIC_VECTOR) || header.elem_size == 0 ||
+            data_len / header.elem_size != header.count || data_len > map_len - sizeof(header)) {
+        munmap(map_base, map_len);
+        return NULL;
+    }
+
+    // Verify the data
+    DsChecksum sum;
+    ds_checksum_init(&sum);
+    ds_checksum_update(&sum, data, data_len);
+    if (ds_checksum_final(&sum) != header.checksum) {
+        munmap(map_base, map_len);
+        return NULL;
+    }
+
+    Vector *vec = vector_init(alloc, dealloc, header.elem_size);
+    if (vec == NULL) {
+        munmap(map_base, map_len);
+        return NULL;
+    }
+
+    // Swap in the mapping. With cap == len + 1 the next insert grows the vector
+    vector_release_storage(vec);
+    vec->stroage = data;
+    vec->len = header.count;
+    vec->cap = header.count + 1;
+    vec->map_base = map_base;
+    vec->map_len = map_len;
+
+    return vec;
+}
+
+
+
 /// Initialize a vector buffer that stores temporary values
 ///
 /// This function allocates memory according to [vec's] alloc
@@ -267,7 +587,7 @@ void *vector_init_buf(const Vector *vec) {
         return NULL;
     }
 
-    void *buf = vec->alloc(vec->elem_size);
+    void *buf = ds_state_alloc(&vec->heap, vec->elem_size);
     if (buf == NULL) {
         return NULL;
     }
@@ -290,11 +610,7 @@ void vector_free_buf(const Vector *vec, void *buf) {
         return;
     }
 
-    // Store pointer to free function
-    VecFreeFn freefunc = vec->dealloc;
-
-    // Free storage first 
-    freefunc(buf);
+    ds_state_free(&vec->heap, buf, vec->elem_size);
 }
 
 
@@ -0,0 +1,79 @@
+#ifndef JAZZY_VECTOR_INTERNAL_H
+#define JAZZY_VECTOR_INTERNAL_H
+
+// Header file
+#include "../../include/vector.h"
+#include "../common/alloc_internal.h"
+#include "../common/trace_internal.h"
+
+// Libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/// Layout of a vector and its fast paths. This is not part of the public
+/// interface, but the single header ds.h exposes it so the fast paths can be
+/// inlined into the caller.
+
+
+struct _vector {
+    size_t cap;
+    size_t len;
+    size_t elem_size;
+    DsAllocState heap;
+    void *stroage; /* cap * elem_size bytes */
+    void *map_base; /* Non NULL if stroage points into a mapped snapshot */
+    size_t map_len;
+#if defined(DS_STATS)
+    uint64_t stat_grows;
+    uint64_t stat_copy_bytes; /* Bytes moved to new storage while growing */
+#endif
+#if defined(DS_TRACE)
+    DsTrace *trace; /* NULL if not recording */
+#endif
+};
+
+
+
+/// Create an empty vector that allocates from [heap]
+Vector *vector_create(const DsAllocState *heap, size_t elemsize);
+
+/// Give [vec] room for [cap] elements, its capacity never shrinks
+///
+/// Returns:
+///   1 on success, 0 if the allocation fails
+int vector_grow(Vector *vec, size_t cap);
+
+
+
+/******************************** Fast paths **********************************/
+
+/// Like `vector_at` without recording
+static inline void *vector_at_inline(const Vector *vec, const size_t index) {
+    if (vec == NULL || index >= vec->len) {
+        return NULL;
+    }
+    return (char *)vec->stroage + vec->elem_size * index;
+}
+
+static inline size_t vector_size_inline(const Vector *vec) {
+    return vec == NULL ? 0 : vec->len;
+}
+
+static inline size_t vector_elem_size_inline(const Vector *vec) {
+    return vec == NULL ? 0 : vec->elem_size;
+}
+
+/// Append in place while there is room, growing is left to `vector_insert`.
+/// The copy uses [data_len], which is a constant at most call sites.
+static inline void vector_insert_inline(Vector *vec, void *data, const size_t data_len) {
+    if (vec != NULL && data != NULL && data_len == vec->elem_size && vec->len < vec->cap - 1) {
+        memcpy((char *)vec->stroage + data_len * vec->len, data, data_len);
+        vec->len++;
+        return;
+    }
+    vector_insert(vec, data, data_len);
+}
+
+#endif // JAZZY_VECTOR_INTERNAL_H
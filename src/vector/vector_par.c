@@ -0,0 +1,559 @@
+// Needed for pthread_key_t and sysconf
+#define _POSIX_C_SOURCE 200809L
+
+// Header file
+#include "../../include/vector.h"
+#include "../common/alloc_internal.h"
+#include "vector_internal.h"
+
+// Libraries
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/********************************** Private ***********************************/
+
+/// Work is handed out as task numbers. Every worker owns a range of them,
+/// takes its next task from the front and steals the back half of the range
+/// of another worker once its own is empty. Ranges are only changed under
+/// their lock, a task is at most [grain] elements so the lock is cheap next
+/// to the task. The threads are started by the first parallel call and wait
+/// for the next job until `vector_par_shutdown`.
+
+
+/// Smallest grain that is picked automatically
+#define VEC_PAR_MIN_GRAIN 1024
+
+/// Tasks per thread that are aimed for if the grain is picked automatically,
+/// more than one so steals can even out uneven tasks
+#define VEC_PAR_TASKS_PER_THREAD 8
+
+
+typedef struct vec_par_job VecParJob;
+
+/// Runs task [task], which covers the elements [begin, end)
+typedef void (*VecParTaskFn)(VecParJob *job, size_t task, size_t begin, size_t end);
+
+
+/// Tasks [begin, end) of a worker, padded so workers do not share a line
+typedef union {
+    struct {
+        pthread_mutex_t lock;
+        size_t begin;
+        size_t end;
+    } range;
+    char pad[128];
+} VecParRange;
+
+
+struct vec_par_job {
+    VecParTaskFn run;
+    size_t len;
+    size_t grain;
+    size_t tasks;
+    size_t workers; /* Including the calling thread */
+
+    // Arguments of the algorithms
+    const Vector *in;
+    Vector *out;
+    void *ctx;
+    VecVisitFn visit;
+    VecMapFn map;
+    VecFoldFn fold;
+    VecFoldFn combine;
+    VecPredFn pred;
+    const void *acc;
+    size_t acc_size;
+    char *scratch;
+    size_t *counts;
+    unsigned char *flags;
+
+    VecParRange ranges[VEC_PAR_MAX_THREADS];
+};
+
+
+
+/// Only one job runs at a time
+static pthread_mutex_t vec_par_submit = PTHREAD_MUTEX_INITIALIZER;
+
+/// Guards everything below
+static pthread_mutex_t vec_par_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t vec_par_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t vec_par_done = PTHREAD_COND_INITIALIZER;
+static pthread_t vec_par_threads[VEC_PAR_MAX_THREADS];
+static uint64_t vec_par_born[VEC_PAR_MAX_THREADS]; /* Generation a thread was started in */
+static size_t vec_par_started; /* Threads 1 to vec_par_started are running */
+static uint64_t vec_par_generation; /* Bumped for every job */
+static VecParJob *vec_par_job;
+static size_t vec_par_finished; /* Threads that are done with vec_par_job */
+static int vec_par_stop;
+
+/// Set on threads that are running a job, parallel calls from them run
+/// serially instead of waiting for themselves
+static pthread_key_t vec_par_key;
+static pthread_once_t vec_par_once = PTHREAD_ONCE_INIT;
+static int vec_par_key_ok;
+static char vec_par_busy;
+
+
+
+static void vec_par_make_key(void) {
+    vec_par_key_ok = pthread_key_create(&vec_par_key, NULL) == 0;
+}
+
+static int vec_par_nested(void) {
+    pthread_once(&vec_par_once, vec_par_make_key);
+    return vec_par_key_ok && pthread_getspecific(vec_par_key) != NULL;
+}
+
+static void vec_par_set_busy(const int busy) {
+    if (vec_par_key_ok) {
+        pthread_setspecific(vec_par_key, busy ? &vec_par_busy : NULL);
+    }
+}
+
+
+
+static inline char *vec_par_elem(const Vector *vec, const size_t index) {
+    return (char *)vec->stroage + vec->elem_size * index;
+}
+
+
+
+/// Take the next task of worker [self]
+///
+/// Returns:
+///   1 if [task] was set, 0 if no worker has tasks left
+static int vec_par_next(VecParJob *job, const size_t self, size_t *task) {
+    VecParRange *own = &job->ranges[self];
+    pthread_mutex_lock(&own->range.lock);
+    if (own->range.begin < own->range.end) {
+        *task = own->range.begin++;
+        pthread_mutex_unlock(&own->range.lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&own->range.lock);
+
+    for (size_t i = 1; i < job->workers; ++i) {
+        VecParRange *victim = &job->ranges[(self + i) % job->workers];
+        pthread_mutex_lock(&victim->range.lock);
+        const size_t left = victim->range.end - victim->range.begin;
+        if (left == 0) {
+            pthread_mutex_unlock(&victim->range.lock);
+            continue;
+        }
+        const size_t stolen_end = victim->range.end;
+        const size_t stolen_begin = stolen_end - (left + 1) / 2;
+        victim->range.end = stolen_begin;
+        pthread_mutex_unlock(&victim->range.lock);
+
+        // Run the first stolen task, the rest can be stolen from us again
+        pthread_mutex_lock(&own->range.lock);
+        own->range.begin = stolen_begin + 1;
+        own->range.end = stolen_end;
+        pthread_mutex_unlock(&own->range.lock);
+        *task = stolen_begin;
+        return 1;
+    }
+    return 0;
+}
+
+static void vec_par_work(VecParJob *job, const size_t self) {
+    size_t task;
+    while (vec_par_next(job, self, &task)) {
+        const size_t begin = task * job->grain;
+        const size_t end = job->len - begin < job->grain ? job->len : begin + job->grain;
+        job->run(job, task, begin, end);
+    }
+}
+
+
+
+static void *vec_par_thread(void *arg) {
+    const size_t self = (size_t)(uintptr_t)arg;
+    vec_par_set_busy(1);
+
+    pthread_mutex_lock(&vec_par_lock);
+    uint64_t seen = vec_par_born[self];
+    for (;;) {
+        while (!vec_par_stop && vec_par_generation == seen) {
+            pthread_cond_wait(&vec_par_wake, &vec_par_lock);
+        }
+        if (vec_par_stop) {
+            break;
+        }
+        seen = vec_par_generation;
+        VecParJob *job = vec_par_job;
+        if (self >= job->workers) {
+            continue;
+        }
+        pthread_mutex_unlock(&vec_par_lock);
+
+        vec_par_work(job, self);
+
+        pthread_mutex_lock(&vec_par_lock);
+        if (++vec_par_finished == job->workers - 1) {
+            pthread_cond_signal(&vec_par_done);
+        }
+    }
+    pthread_mutex_unlock(&vec_par_lock);
+    return NULL;
+}
+
+
+
+/// Split [len] elements into tasks according to [config]
+static void vec_par_plan(VecParJob *job, const size_t len, const VecParConfig *config) {
+    size_t threads = config == NULL ? 0 : config->threads;
+    if (threads == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (size_t)cpus : 1;
+    }
+    if (threads > VEC_PAR_MAX_THREADS) {
+        threads = VEC_PAR_MAX_THREADS;
+    }
+
+    size_t grain = config == NULL ? 0 : config->grain;
+    if (grain == 0) {
+        grain = (len + threads * VEC_PAR_TASKS_PER_THREAD - 1) / (threads * VEC_PAR_TASKS_PER_THREAD);
+        grain = grain < VEC_PAR_MIN_GRAIN ? VEC_PAR_MIN_GRAIN : grain;
+    }
+
+    job->len = len;
+    job->grain = grain;
+    job->tasks = len / grain + (len % grain != 0);
+    job->workers = threads < job->tasks ? threads : job->tasks;
+}
+
+
+
+/// Run all tasks of [job] and wait for them, with fewer threads if some can
+/// not be started
+static void vec_par_run(VecParJob *job, const VecParTaskFn run) {
+    job->run = run;
+
+    // Too small or called from a task, run everything here
+    if (job->workers <= 1 || vec_par_nested()) {
+        for (size_t task = 0; task < job->tasks; ++task) {
+            const size_t begin = task * job->grain;
+            const size_t end = job->len - begin < job->grain ? job->len : begin + job->grain;
+            run(job, task, begin, end);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&vec_par_submit);
+
+    // Start missing threads, use fewer workers if that fails
+    while (vec_par_started < job->workers - 1) {
+        const size_t index = vec_par_started + 1;
+        pthread_mutex_lock(&vec_par_lock);
+        vec_par_born[index] = vec_par_generation;
+        pthread_mutex_unlock(&vec_par_lock);
+        if (pthread_create(&vec_par_threads[index], NULL, vec_par_thread, (void *)(uintptr_t)index) != 0) {
+            job->workers = vec_par_started + 1;
+            break;
+        }
+        vec_par_started++;
+    }
+
+    for (size_t w = 0; w < job->workers; ++w) {
+        pthread_mutex_init(&job->ranges[w].range.lock, NULL);
+        job->ranges[w].range.begin = job->tasks * w / job->workers;
+        job->ranges[w].range.end = job->tasks * (w + 1) / job->workers;
+    }
+
+    pthread_mutex_lock(&vec_par_lock);
+    vec_par_job = job;
+    vec_par_finished = 0;
+    vec_par_generation++;
+    pthread_cond_broadcast(&vec_par_wake);
+    pthread_mutex_unlock(&vec_par_lock);
+
+    vec_par_set_busy(1);
+    vec_par_work(job, 0);
+    vec_par_set_busy(0);
+
+    pthread_mutex_lock(&vec_par_lock);
+    while (vec_par_finished < job->workers - 1) {
+        pthread_cond_wait(&vec_par_done, &vec_par_lock);
+    }
+    vec_par_job = NULL;
+    pthread_mutex_unlock(&vec_par_lock);
+
+    for (size_t w = 0; w < job->workers; ++w) {
+        pthread_mutex_destroy(&job->ranges[w].range.lock);
+    }
+    pthread_mutex_unlock(&vec_par_submit);
+}
+
+
+
+/********************************* Algorithms *********************************/
+
+static void vec_par_for_each_task(VecParJob *job, const size_t task, const size_t begin, const size_t end) {
+    (void)task;
+    for (size_t i = begin; i < end; ++i) {
+        job->visit(vec_par_elem(job->out, i), job->ctx);
+    }
+}
+
+static void vec_par_map_task(VecParJob *job, const size_t task, const size_t begin, const size_t end) {
+    (void)task;
+    for (size_t i = begin; i < end; ++i) {
+        job->map(vec_par_elem(job->in, i), vec_par_elem(job->out, i), job->ctx);
+    }
+}
+
+static void vec_par_reduce_task(VecParJob *job, const size_t task, const size_t begin, const size_t end) {
+    char *acc = job->scratch + task * job->acc_size;
+    memcpy(acc, job->acc, job->acc_size);
+    for (size_t i = begin; i < end; ++i) {
+        job->fold(acc, vec_par_elem(job->in, i), job->ctx);
+    }
+}
+
+/// First pass of a scan, the total of every task but the last
+static void vec_par_total_task(VecParJob *job, const size_t task, const size_t begin, const size_t end) {
+    if (task == job->tasks - 1) {
+        return;
+    }
+    char *total = job->scratch + task * job->out->elem_size;
+    memcpy(total, vec_par_elem(job->out, begin), job->out->elem_size);
+    for (size_t i = begin + 1; i < end; ++i) {
+        job->fold(total, vec_par_elem(job->out, i), job->ctx);
+    }
+}
+
+/// Second pass of a scan, the prefix of every task starts at its carry
+static void vec_par_scan_task(VecParJob *job, const size_t task, const size_t begin, const size_t end) {
+    const size_t elem_size = job->out->elem_size;
+    char *running = job->scratch + task * elem_size;
+    size_t i = begin;
+    if (task == 0) {
+        memcpy(running, vec_par_elem(job->out, i++), elem_size);
+    }
+    for (; i < end; ++i) {
+        char *elem = vec_par_elem(job->out, i);
+        job->fold(running, elem, job->ctx);
+        memcpy(elem, running, elem_size);
+    }
+}
+
+/// First pass of a partition, remember and count the matches
+static void vec_par_count_task(VecParJob *job, const size_t task, const size_t begin, const size_t end) {
+    size_t matches = 0;
+    for (size_t i = begin; i < end; ++i) {
+        job->flags[i] = job->pred(vec_par_elem(job->out, i), job->ctx) != 0;
+        matches += job->flags[i];
+    }
+    job->counts[task] = matches;
+}
+
+/// Second pass of a partition, copy to the offsets of the task
+static void vec_par_scatter_task(VecParJob *job, const size_t task, const size_t begin, const size_t end) {
+    const size_t elem_size = job->out->elem_size;
+    size_t front = job->counts[task];
+    size_t back = job->counts[job->tasks] + begin - front;
+    for (size_t i = begin; i < end; ++i) {
+        const size_t dest = job->flags[i] ? front++ : back++;
+        memcpy(job->scratch + dest * elem_size, vec_par_elem(job->out, i), elem_size);
+    }
+}
+
+
+
+/********************************** Public ************************************/
+
+int vector_par_for_each(Vector *vec, VecVisitFn visit, void *ctx, const VecParConfig *config) {
+    // Sanity check
+    if (vec == NULL || visit == NULL) {
+        return 0;
+    }
+
+    VecParJob job;
+    vec_par_plan(&job, vec->len, config);
+    job.out = vec;
+    job.visit = visit;
+    job.ctx = ctx;
+    vec_par_run(&job, vec_par_for_each_task);
+    return 1;
+}
+
+
+
+int vector_par_map(const Vector *vec, Vector *out, VecMapFn map, void *ctx, const VecParConfig *config) {
+    // Sanity check
+    if (vec == NULL || out == NULL || map == NULL || vec == out) {
+        return 0;
+    }
+
+    // Keep room for one more, like after an insert
+    if (!vector_grow(out, vec->len + 1)) {
+        return 0;
+    }
+
+    VecParJob job;
+    vec_par_plan(&job, vec->len, config);
+    job.in = vec;
+    job.out = out;
+    job.map = map;
+    job.ctx = ctx;
+    vec_par_run(&job, vec_par_map_task);
+
+    // Zero what is left of the old elements
+    if (out->len > vec->len) {
+        memset(vec_par_elem(out, vec->len), 0, (out->len - vec->len) * out->elem_size);
+    }
+    out->len = vec->len;
+    return 1;
+}
+
+
+
+int vector_par_reduce(const Vector *vec, void *acc, const size_t acc_size, VecFoldFn fold, VecFoldFn combine,
+        void *ctx, const VecParConfig *config) {
+    // Sanity check
+    if (vec == NULL || acc == NULL || fold == NULL || combine == NULL) {
+        return 0;
+    }
+
+    VecParJob job;
+    vec_par_plan(&job, vec->len, config);
+    if (job.tasks == 0) {
+        return 1;
+    }
+    job.in = vec;
+    job.fold = fold;
+    job.ctx = ctx;
+    job.acc = acc;
+    job.acc_size = acc_size;
+    job.scratch = ds_state_alloc(&vec->heap, job.tasks * acc_size);
+    if (job.scratch == NULL) {
+        return 0;
+    }
+    vec_par_run(&job, vec_par_reduce_task);
+
+    // Combine in task order
+    memcpy(acc, job.scratch, acc_size);
+    for (size_t task = 1; task < job.tasks; ++task) {
+        combine(acc, job.scratch + task * acc_size, ctx);
+    }
+    ds_state_free(&vec->heap, job.scratch, job.tasks * acc_size);
+    return 1;
+}
+
+
+
+int vector_par_scan(Vector *vec, VecFoldFn op, void *ctx, const VecParConfig *config) {
+    // Sanity check
+    if (vec == NULL || op == NULL) {
+        return 0;
+    }
+
+    VecParJob job;
+    vec_par_plan(&job, vec->len, config);
+    if (job.tasks == 0) {
+        return 1;
+    }
+    const size_t elem_size = vec->elem_size;
+    job.out = vec;
+    job.fold = op;
+    job.ctx = ctx;
+    job.scratch = ds_state_alloc(&vec->heap, job.tasks * elem_size);
+    if (job.scratch == NULL) {
+        return 0;
+    }
+
+    // Turn the totals into carries, the carry of task t is everything before
+    // it and goes to slot t. Slot 0 is free as a temporary until pass two
+    if (job.tasks > 1) {
+        vec_par_run(&job, vec_par_total_task);
+        for (size_t task = job.tasks - 1; task > 0; --task) {
+            memcpy(job.scratch + task * elem_size, job.scratch + (task - 1) * elem_size, elem_size);
+        }
+        for (size_t task = 2; task < job.tasks; ++task) {
+            memcpy(job.scratch, job.scratch + (task - 1) * elem_size, elem_size);
+            op(job.scratch, job.scratch + task * elem_size, ctx);
+            memcpy(job.scratch + task * elem_size, job.scratch, elem_size);
+        }
+    }
+
+    vec_par_run(&job, vec_par_scan_task);
+    ds_state_free(&vec->heap, job.scratch, job.tasks * elem_size);
+    return 1;
+}
+
+
+
+int vector_par_partition(Vector *vec, VecPredFn pred, void *ctx, size_t *count, const VecParConfig *config) {
+    // Sanity check
+    if (vec == NULL || pred == NULL) {
+        return 0;
+    }
+
+    VecParJob job;
+    vec_par_plan(&job, vec->len, config);
+    const size_t buf_size = vec->cap * vec->elem_size;
+    job.out = vec;
+    job.pred = pred;
+    job.ctx = ctx;
+    job.counts = ds_state_alloc(&vec->heap, (job.tasks + 1) * sizeof(size_t));
+    job.flags = ds_state_alloc(&vec->heap, vec->len + 1);
+    job.scratch = ds_state_alloc(&vec->heap, buf_size);
+    const int ok = job.counts != NULL && job.flags != NULL && job.scratch != NULL;
+    if (ok) {
+        vec_par_run(&job, vec_par_count_task);
+
+        // Front offset of every task, the total ends up in counts[tasks]
+        size_t matches = 0;
+        for (size_t task = 0; task <= job.tasks; ++task) {
+            const size_t task_matches = task < job.tasks ? job.counts[task] : 0;
+            job.counts[task] = matches;
+            matches += task_matches;
+        }
+        vec_par_run(&job, vec_par_scatter_task);
+
+        if (count != NULL) {
+            *count = job.counts[job.tasks];
+        }
+        // The buffer becomes the storage unless that is a mapped snapshot
+        memset(job.scratch + vec->len * vec->elem_size, 0, buf_size - vec->len * vec->elem_size);
+        if (vec->map_base == NULL) {
+            char *old = vec->stroage;
+            vec->stroage = job.scratch;
+            job.scratch = old;
+        } else {
+            memcpy(vec->stroage, job.scratch, vec->len * vec->elem_size);
+        }
+    }
+
+    ds_state_free(&vec->heap, job.scratch, buf_size);
+    ds_state_free(&vec->heap, job.flags, vec->len + 1);
+    ds_state_free(&vec->heap, job.counts, (job.tasks + 1) * sizeof(size_t));
+    return ok;
+}
+
+
+
+void vector_par_shutdown(void) {
+    pthread_mutex_lock(&vec_par_submit);
+    pthread_mutex_lock(&vec_par_lock);
+    vec_par_stop = 1;
+    pthread_cond_broadcast(&vec_par_wake);
+    pthread_mutex_unlock(&vec_par_lock);
+
+    for (size_t index = 1; index <= vec_par_started; ++index) {
+        pthread_join(vec_par_threads[index], NULL);
+    }
+
+    pthread_mutex_lock(&vec_par_lock);
+    vec_par_started = 0;
+    vec_par_stop = 0;
+    pthread_mutex_unlock(&vec_par_lock);
+    pthread_mutex_unlock(&vec_par_submit);
+}
@@ -2,7 +2,49 @@
 #include <stdio.h>
 
 #include "test_vec.c"
+#include "test_tree.c"
+#include "test_map.c"
+#include "test_hash.c"
+#include "test_filter.c"
+#include "test_alloc.c"
+#include "test_perf.c"
+#include "test_trace.c"
+#include "test_heap.c"
+#include "test_art.c"
 
 int main(void) {
     test_vec();
+    test_vec_snapshot();
+    test_vec_stats();
+    test_vec_par();
+    test_tree();
+    test_tree_map();
+    test_tree_freeze();
+    test_tree_snapshot();
+    test_tree_no_parent();
+    test_tree_hint();
+    test_tree_interval();
+    test_tree_bounds();
+    test_tree_stats();
+    test_map();
+    test_map_rehash();
+    test_map_collisions();
+    test_map_str();
+    test_map_cache();
+    test_map_batch();
+    test_map_stats();
+    test_static_map();
+    test_concurrent_map();
+    test_hash();
+    test_bloom_filter();
+    test_cuckoo_filter();
+    test_alloc();
+    test_alloc_arena();
+    test_alloc_pool();
+    test_perf();
+    test_trace();
+    test_heap();
+    test_heap_indexed();
+    test_art();
+    test_art_scan();
 }
@@ -0,0 +1,178 @@
+// Header file
+#include "../include/alloc.h"
+#include "../include/map.h"
+#include "../include/tree.h"
+#include "../include/vector.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+/// Allocator that checks the sizes passed to free_sized
+typedef struct {
+    size_t live_blocks;
+    size_t live_bytes;
+} CheckedHeap;
+
+static void *checked_alloc(void *ctx, size_t size) {
+    CheckedHeap *heap = ctx;
+    size_t *block = malloc(DS_ALLOC_MIN_ALIGN + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    *block = size;
+    heap->live_blocks++;
+    heap->live_bytes += size;
+    return (char *)block + DS_ALLOC_MIN_ALIGN;
+}
+
+static void checked_free(void *ctx, void *ptr, size_t size) {
+    CheckedHeap *heap = ctx;
+    size_t *block = (size_t *)((char *)ptr - DS_ALLOC_MIN_ALIGN);
+    assert(*block == size);
+    heap->live_blocks--;
+    heap->live_bytes -= size;
+    free(block);
+}
+
+
+
+static int compare_alloc_u64(const void *a, const void *b, size_t size) {
+    (void)size;
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+
+void test_alloc(void) {
+    // Containers free every block with the size it was allocated with
+    CheckedHeap heap = {0, 0};
+    const DsAllocator checked = {&heap, checked_alloc, NULL, checked_free, NULL};
+
+    Vector *vec = vector_init_alloc(&checked, sizeof(uint64_t));
+    Tree *tree = tree_init_alloc(sizeof(uint64_t), 0, TREE_DEFAULT, &checked, compare_alloc_u64);
+    Map *map = map_init_alloc(&checked, NULL, sizeof(uint64_t), sizeof(uint64_t));
+    Map *str_map = map_init_str_alloc(&checked, NULL, sizeof(uint64_t));
+    assert(vec != NULL && tree != NULL && map != NULL && str_map != NULL);
+
+    char key[64];
+    memset(key, 'k', sizeof(key));
+    for (uint64_t i = 0; i < 1000; ++i) {
+        vector_insert(vec, &i, sizeof(i));
+        tree_insert(tree, &i, sizeof(i));
+        map_put(map, &i, &i);
+        memcpy(key, &i, sizeof(i));
+        map_put_str(str_map, key, sizeof(key), &i);
+    }
+    for (uint64_t i = 0; i < 1000; i += 2) {
+        tree_delete(tree, &i);
+        map_remove(map, &i);
+    }
+    assert(*(uint64_t *)vector_at(vec, 999) == 999);
+    assert(tree_size(tree) == 500 && map_size(map) == 500);
+    assert(vector_alloc_fn(vec) == NULL);
+
+    FrozenTree *frozen = tree_freeze(tree);
+    assert(frozen != NULL);
+    tree_free(tree);
+    frozen_free(frozen);
+    vector_free(vec);
+    map_free(map);
+    map_free(str_map);
+    assert(heap.live_blocks == 0 && heap.live_bytes == 0);
+
+    // Fallbacks of the optional hooks
+    uint64_t *grown = ds_alloc(&checked, 8);
+    assert(grown != NULL);
+    *grown = 42;
+    grown = ds_realloc(&checked, grown, 8, 64);
+    assert(grown != NULL && *grown == 42);
+    assert(ds_aligned_alloc(&checked, 4096, 64) == NULL);
+    ds_free(&checked, grown, 64);
+    assert(heap.live_blocks == 0);
+}
+
+
+
+void test_alloc_arena(void) {
+    DsArena *arena = ds_arena_init(NULL, 4096);
+    assert(arena != NULL);
+    const DsAllocator allocator = ds_arena_allocator(arena);
+
+    // A request's containers live in the arena and are never freed one by one
+    for (int round = 0; round < 3; ++round) {
+        Map *map = map_init_alloc(&allocator, NULL, sizeof(uint64_t), sizeof(uint64_t));
+        Tree *tree = tree_init_alloc(sizeof(uint64_t), 0, TREE_NO_PARENT, &allocator, compare_alloc_u64);
+        assert(map != NULL && tree != NULL);
+        for (uint64_t i = 0; i < 1000; ++i) {
+            map_put(map, &i, &i);
+            tree_insert(tree, &i, sizeof(i));
+        }
+        for (uint64_t i = 0; i < 1000; ++i) {
+            assert(*(uint64_t *)map_get(map, &i) == i);
+            assert(*(const uint64_t *)tree_lookup(tree, &i) == i);
+        }
+        assert(ds_arena_used(arena) > 1000 * sizeof(uint64_t));
+        ds_arena_reset(arena);
+        assert(ds_arena_used(arena) == 0);
+    }
+
+    // The latest allocation grows in place and can be given back
+    char *a = ds_alloc(&allocator, 16);
+    char *b = ds_realloc(&allocator, a, 16, 64);
+    assert(a == b);
+    ds_free(&allocator, b, 64);
+    assert(ds_arena_used(arena) == 0);
+
+    // Alignment and blocks larger than the block size
+    void *aligned = ds_aligned_alloc(&allocator, 256, 100);
+    assert(aligned != NULL && (uintptr_t)aligned % 256 == 0);
+    char *large = ds_alloc(&allocator, 100000);
+    assert(large != NULL);
+    memset(large, 0xAB, 100000);
+    char *after = ds_alloc(&allocator, 16);
+    assert(after != NULL && (after < large || after >= large + 100000));
+
+    ds_arena_free(arena);
+}
+
+
+
+void test_alloc_pool(void) {
+    const DsAllocator pool = ds_pool_allocator();
+
+    // Freed blocks are reused by the same size class
+    void *first = ds_alloc(&pool, 40);
+    assert(first != NULL);
+    ds_free(&pool, first, 40);
+    void *second = ds_alloc(&pool, 64);
+    assert(second == first);
+
+    // Growing within a class keeps the block
+    assert(ds_realloc(&pool, second, 64, 50) == second);
+    char *moved = ds_realloc(&pool, second, 50, 5000);
+    assert(moved != NULL);
+    moved[4999] = 1;
+    ds_free(&pool, moved, 5000);
+
+    void *aligned = ds_aligned_alloc(&pool, 128, 100);
+    assert(aligned != NULL && (uintptr_t)aligned % 128 == 0);
+    ds_free(&pool, aligned, 100);
+
+    Tree *tree = tree_init_alloc(sizeof(uint64_t), sizeof(uint64_t), TREE_DEFAULT, &pool, compare_alloc_u64);
+    assert(tree != NULL);
+    for (uint64_t i = 0; i < 1000; ++i) {
+        const uint64_t pair[2] = {i, i * 2};
+        tree_insert(tree, pair, sizeof(pair));
+    }
+    for (uint64_t i = 0; i < 1000; i += 3) {
+        tree_delete(tree, &i);
+    }
+    assert(tree_size(tree) == 666);
+    tree_free(tree);
+
+    ds_pool_trim();
+}
@@ -0,0 +1,186 @@
+// Header file
+#include "../include/art.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+/// Collects the keys of a scan
+typedef struct {
+    char keys[64][32];
+    size_t count;
+    size_t stop_after;
+} TestArtScan;
+
+static int test_art_collect(const void *key, size_t key_len, void *value, void *ctx) {
+    TestArtScan *scan = ctx;
+    assert(key_len < 32 && *(uint64_t *)value == key_len);
+    memcpy(scan->keys[scan->count], key, key_len);
+    scan->keys[scan->count][key_len] = '\0';
+    scan->count++;
+    return scan->count == scan->stop_after;
+}
+
+static int test_art_compare(const void *a, const void *b) {
+    return strcmp(a, b);
+}
+
+
+
+void test_art(void) {
+    ArtTree *tree = art_init(NULL, NULL, sizeof(uint64_t));
+    assert(tree != NULL);
+    assert(art_lookup(tree, "a", 1) == NULL);
+    assert(art_delete(tree, "a", 1) == 0);
+
+    // Keys that are prefixes of each other, including the empty key
+    const char *words[] = {"", "a", "ab", "abc", "abd", "b", "romane", "romanus", "romulus", "rubens", "ruber",
+        "rubicon", "rubicundus", "http://example.com/a/very/long/shared/path/one",
+        "http://example.com/a/very/long/shared/path/two", "http://example.com/a/very/long"};
+    const size_t count = sizeof(words) / sizeof(words[0]);
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t value = i;
+        assert(art_insert(tree, words[i], strlen(words[i]), &value) != NULL);
+    }
+    assert(art_size(tree) == count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t *value = art_lookup(tree, words[i], strlen(words[i]));
+        assert(value != NULL && *value == i);
+    }
+    assert(art_lookup(tree, "abe", 3) == NULL);
+    assert(art_lookup(tree, "roman", 5) == NULL);
+    assert(art_lookup(tree, "http://example.com/a/very/long/shared/path/", 43) == NULL);
+    assert(art_lookup(tree, "http://example.com/a/xery/long/shared/path/one", 46) == NULL);
+
+    // Overwrite, NULL keeps the value
+    uint64_t value = 100;
+    assert(*(uint64_t *)art_insert(tree, "ab", 2, &value) == 100);
+    assert(*(uint64_t *)art_insert(tree, "ab", 2, NULL) == 100);
+    assert(art_size(tree) == count);
+
+    // Delete in an order that collapses nodes into their children
+    for (size_t i = count; i-- > 0;) {
+        if (i % 2 == 0) {
+            assert(art_delete(tree, words[i], strlen(words[i])));
+            assert(art_delete(tree, words[i], strlen(words[i])) == 0);
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        assert((art_lookup(tree, words[i], strlen(words[i])) != NULL) == (i % 2 == 1));
+    }
+    for (size_t i = 1; i < count; i += 2) {
+        assert(art_delete(tree, words[i], strlen(words[i])));
+    }
+    assert(art_size(tree) == 0);
+
+    // Grow every node size and shrink back
+    char key[8];
+    for (uint64_t i = 0; i < 256 * 40; ++i) {
+        const int len = sprintf(key, "k%02x%02x", (unsigned)(i % 256), (unsigned)(i / 256));
+        assert(art_insert(tree, key, (size_t)len, &i) != NULL);
+    }
+    assert(art_size(tree) == 256 * 40);
+    for (uint64_t i = 0; i < 256 * 40; ++i) {
+        const int len = sprintf(key, "k%02x%02x", (unsigned)(i % 256), (unsigned)(i / 256));
+        if (i % 256 != 7) {
+            assert(art_delete(tree, key, (size_t)len));
+        }
+    }
+    for (uint64_t i = 7; i < 256 * 40; i += 256) {
+        const int len = sprintf(key, "k%02x%02x", (unsigned)(i % 256), (unsigned)(i / 256));
+        assert(*(uint64_t *)art_lookup(tree, key, (size_t)len) == i);
+    }
+    assert(art_size(tree) == 40);
+    art_free(tree);
+
+    // Random binary keys against a sorted reference
+    ArtTree *bytes = art_init_alloc(NULL, 0);
+    uint64_t reference[2000];
+    uint64_t state = 7;
+    for (size_t i = 0; i < 2000; ++i) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        reference[i] = state >> (i % 3) * 20;
+        assert(art_insert(bytes, reference + i, sizeof(uint64_t), NULL) != NULL);
+    }
+    assert(art_size(bytes) == 2000);
+    for (size_t i = 0; i < 2000; i += 2) {
+        assert(art_delete(bytes, reference + i, sizeof(uint64_t)));
+    }
+    for (size_t i = 0; i < 2000; ++i) {
+        assert((art_lookup(bytes, reference + i, sizeof(uint64_t)) != NULL) == (i % 2 == 1));
+    }
+    assert(art_range_scan(bytes, NULL, 0, NULL, 0, NULL, NULL) == 1000);
+    art_free(bytes);
+}
+
+
+
+void test_art_scan(void) {
+    ArtTree *tree = art_init(NULL, NULL, sizeof(uint64_t));
+    const char *words[] = {"/", "/api", "/api/", "/api/users", "/api/users/42", "/api/v2", "/apix", "/b",
+        "/static/0123456789/app.js", "/static/0123456789/app.css", "/static/0123456789abc", "/static/01234x"};
+    const size_t count = sizeof(words) / sizeof(words[0]);
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t len = strlen(words[i]);
+        art_insert(tree, words[i], len, &len);
+    }
+
+    char sorted[12][32];
+    for (size_t i = 0; i < count; ++i) {
+        strcpy(sorted[i], words[i]);
+    }
+    qsort(sorted, count, sizeof(sorted[0]), test_art_compare);
+
+    // Everything in order
+    TestArtScan scan = {.count = 0};
+    assert(art_prefix_scan(tree, "", 0, test_art_collect, &scan) == count);
+    for (size_t i = 0; i < count; ++i) {
+        assert(strcmp(scan.keys[i], sorted[i]) == 0);
+    }
+
+    // Prefixes that end between, inside and after compressed paths
+    const char *prefixes[] = {"/api", "/api/", "/api/u", "/static/0123456789", "/static/0123456789/app.j", "/x",
+        "/apix", "/static/01234y"};
+    for (size_t p = 0; p < sizeof(prefixes) / sizeof(prefixes[0]); ++p) {
+        const size_t len = strlen(prefixes[p]);
+        memset(&scan, 0, sizeof(scan));
+        const size_t found = art_prefix_scan(tree, prefixes[p], len, test_art_collect, &scan);
+        assert(found == scan.count);
+        size_t expected = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (strncmp(sorted[i], prefixes[p], len) == 0) {
+                assert(strcmp(scan.keys[expected++], sorted[i]) == 0);
+            }
+        }
+        assert(expected == found);
+    }
+
+    // Ranges with bounds that are and are not keys
+    const char *bounds[][2] = {{"/api", "/api/v2"}, {"/ap", "/b"}, {"/api/users/", "/static/0123456789/app.js"},
+        {"", "/"}, {"/static/0123456789/", "/static/0123456789a"}, {"/z", "/zz"}, {"/api/users/42", "~"}};
+    for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); ++b) {
+        memset(&scan, 0, sizeof(scan));
+        art_range_scan(tree, bounds[b][0], strlen(bounds[b][0]), bounds[b][1], strlen(bounds[b][1]),
+                test_art_collect, &scan);
+        size_t expected = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (strcmp(sorted[i], bounds[b][0]) >= 0 && strcmp(sorted[i], bounds[b][1]) < 0) {
+                assert(strcmp(scan.keys[expected++], sorted[i]) == 0);
+            }
+        }
+        assert(expected == scan.count);
+    }
+
+    // Open ends and stopping early
+    assert(art_range_scan(tree, "/b", 2, NULL, 0, NULL, NULL) == 5);
+    assert(art_range_scan(tree, NULL, 0, "/api/", 5, NULL, NULL) == 2);
+    memset(&scan, 0, sizeof(scan));
+    scan.stop_after = 3;
+    assert(art_prefix_scan(tree, "/api", 4, test_art_collect, &scan) == 3);
+    assert(strcmp(scan.keys[2], "/api/users") == 0);
+
+    art_free(tree);
+}
@@ -0,0 +1,96 @@
+// Header file
+#include "../include/filter.h"
+#include <assert.h>
+#include <stdint.h>
+
+
+
+void test_bloom_filter(void) {
+    const uint64_t count = 10000;
+    BloomFilter *filter = bloom_init(NULL, NULL, count, 10);
+    assert(filter != NULL);
+
+    for (uint64_t i = 0; i < count; ++i) {
+        bloom_add(filter, &i, sizeof(i));
+    }
+
+    // No false negatives
+    for (uint64_t i = 0; i < count; ++i) {
+        assert(bloom_contains(filter, &i, sizeof(i)));
+    }
+
+    // About 1% false positives with 10 bits per key
+    size_t false_positives = 0;
+    for (uint64_t i = count; i < 11 * count; ++i) {
+        false_positives += bloom_contains(filter, &i, sizeof(i));
+    }
+    assert(false_positives < count * 10 / 50);
+
+    // Batches agree with single queries
+    uint64_t keys[100];
+    unsigned char out[100];
+    for (uint64_t i = 0; i < 100; ++i) {
+        keys[i] = i * 200;
+    }
+    const size_t found = bloom_contains_batch(filter, keys, sizeof(uint64_t), 100, out);
+    size_t expected = 0;
+    for (size_t i = 0; i < 100; ++i) {
+        assert(out[i] == bloom_contains(filter, keys + i, sizeof(uint64_t)));
+        expected += out[i];
+    }
+    assert(found == expected && found >= 50);
+
+    bloom_free(filter);
+}
+
+
+
+void test_cuckoo_filter(void) {
+    const uint64_t count = 10000;
+    CuckooFilter *filter = cuckoo_init(NULL, NULL, count);
+    assert(filter != NULL);
+
+    for (uint64_t i = 0; i < count; ++i) {
+        assert(cuckoo_add(filter, &i, sizeof(i)));
+    }
+    assert(cuckoo_size(filter) == count);
+
+    // No false negatives and very few false positives
+    for (uint64_t i = 0; i < count; ++i) {
+        assert(cuckoo_contains(filter, &i, sizeof(i)));
+    }
+    size_t false_positives = 0;
+    for (uint64_t i = count; i < 11 * count; ++i) {
+        false_positives += cuckoo_contains(filter, &i, sizeof(i));
+    }
+    assert(false_positives < count * 10 / 1000);
+
+    // Removing every other key keeps the rest
+    for (uint64_t i = 0; i < count; i += 2) {
+        assert(cuckoo_remove(filter, &i, sizeof(i)));
+    }
+    assert(cuckoo_size(filter) == count / 2);
+    uint64_t keys[100];
+    unsigned char out[100];
+    for (uint64_t i = 0; i < 100; ++i) {
+        keys[i] = i;
+    }
+    assert(cuckoo_contains_batch(filter, keys, sizeof(uint64_t), 100, out) >= 50);
+    for (size_t i = 1; i < 100; i += 2) {
+        assert(out[i]);
+    }
+
+    // Fill until full, then nothing more fits
+    uint64_t key = 11 * count;
+    while (cuckoo_add(filter, &key, sizeof(key))) {
+        key++;
+    }
+    assert(cuckoo_size(filter) >= count);
+    assert(!cuckoo_add(filter, &key, sizeof(key)));
+    for (uint64_t i = 1; i < count; i += 2) {
+        assert(cuckoo_contains(filter, &i, sizeof(i)));
+    }
+
+    cuckoo_free(filter);
+    assert(cuckoo_size(NULL) == 0);
+}
@@ -0,0 +1,41 @@
+// Header file
+#include "../include/hash.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+
+
+void test_hash(void) {
+    // Fast paths agree with the generic function
+    for (uint64_t i = 0; i < 1000; ++i) {
+        const uint64_t key = i * 0x9E3779B97F4A7C15ull;
+        const uint32_t small = (uint32_t)key;
+        assert(hash_u64(key, i) == hash_bytes(&key, sizeof(key), i));
+        assert(hash_u32(small, i) == hash_bytes(&small, sizeof(small), i));
+    }
+
+    // Every length and every seed gives a different hash
+    unsigned char bytes[200];
+    for (size_t i = 0; i < sizeof(bytes); ++i) {
+        bytes[i] = (unsigned char)(i * 7);
+    }
+    uint64_t hashes[sizeof(bytes) + 1];
+    for (size_t len = 0; len <= sizeof(bytes); ++len) {
+        hashes[len] = hash_bytes(bytes, len, 1);
+        assert(hash_bytes(bytes, len, 1) == hashes[len]);
+        assert(hash_bytes(bytes, len, 2) != hashes[len]);
+        for (size_t j = 0; j < len; ++j) {
+            assert(hashes[j] != hashes[len]);
+        }
+    }
+
+    // Flipping any bit changes the hash
+    for (size_t bit = 0; bit < 8 * 64; ++bit) {
+        bytes[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+        assert(hash_bytes(bytes, 64, 1) != hashes[64]);
+        bytes[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+    }
+
+    assert(hash_random_seed() != hash_random_seed());
+}
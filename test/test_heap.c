@@ -0,0 +1,144 @@
+// Header file
+#include "../include/heap.h"
+#include "../include/vector.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+
+static int test_heap_compare_u64(const void *a, const void *b, size_t size) {
+    (void)size;
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+
+void test_heap(void) {
+    const size_t arities[] = {0, 2, 8, HEAP_MAX_ARITY};
+    uint64_t value;
+
+    // Invalid arities
+    assert(heap_init(NULL, NULL, sizeof(uint64_t), 1, NULL) == NULL);
+    assert(heap_init(NULL, NULL, sizeof(uint64_t), HEAP_MAX_ARITY + 1, NULL) == NULL);
+
+    for (size_t a = 0; a < sizeof(arities) / sizeof(arities[0]); ++a) {
+        Heap *heap = heap_init(NULL, NULL, sizeof(uint64_t), arities[a], test_heap_compare_u64);
+        assert(heap != NULL);
+        assert(heap_peek(heap) == NULL);
+        assert(heap_pop(heap, &value) == 0);
+
+        // Pseudo random keys with duplicates come out sorted
+        uint64_t state = 1;
+        for (size_t i = 0; i < 1000; ++i) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            value = (state >> 33) % 500;
+            assert(heap_push(heap, &value));
+        }
+        assert(heap_size(heap) == 1000);
+
+        uint64_t last = 0;
+        for (size_t i = 0; i < 1000; ++i) {
+            const uint64_t top = *(const uint64_t *)heap_peek(heap);
+            assert(heap_pop(heap, &value));
+            assert(value == top && value >= last);
+            last = value;
+        }
+        assert(heap_size(heap) == 0);
+        assert(heap_pop(heap, NULL) == 0);
+
+        heap_free(heap);
+    }
+
+    // Heapify a vector in place
+    Vector *vec = vector_init(NULL, NULL, sizeof(uint64_t));
+    for (uint64_t i = 0; i < 777; ++i) {
+        value = (i * 7919) % 777;
+        vector_insert(vec, &value, sizeof(value));
+    }
+    Heap *heap = heap_from_vector(vec, 8, test_heap_compare_u64);
+    assert(heap != NULL);
+    assert(heap_size(heap) == 777);
+    value = 5;
+    assert(heap_push(heap, &value));
+    for (uint64_t i = 0; i < 778; ++i) {
+        assert(heap_pop(heap, &value));
+        assert(value == (i <= 5 ? i : i - 1));
+    }
+    heap_free(heap);
+
+    // memcmp orders single bytes
+    Heap *bytes = heap_init_alloc(NULL, 1, 0, NULL);
+    const unsigned char input[] = {9, 3, 7, 1, 1, 200};
+    for (size_t i = 0; i < sizeof(input); ++i) {
+        assert(heap_push(bytes, input + i));
+    }
+    unsigned char byte;
+    assert(heap_pop(bytes, &byte) && byte == 1);
+    assert(heap_pop(bytes, &byte) && byte == 1);
+    assert(heap_pop(bytes, &byte) && byte == 3);
+    heap_free(bytes);
+}
+
+
+
+void test_heap_indexed(void) {
+    Heap *heap = heap_init_indexed(NULL, NULL, sizeof(uint64_t), 4, test_heap_compare_u64);
+    assert(heap != NULL);
+
+    size_t handles[200];
+    for (uint64_t i = 0; i < 200; ++i) {
+        const uint64_t value = 1000 + i;
+        assert(heap_push_handle(heap, &value, handles + i));
+        assert(handles[i] == i);
+    }
+
+    // Decrease-key moves an element to the top
+    uint64_t value = 1;
+    assert(heap_update(heap, handles[150], &value));
+    assert(*(const uint64_t *)heap_peek(heap) == 1);
+    assert(*(const uint64_t *)heap_get(heap, handles[150]) == 1);
+
+    // Increase-key moves it back down
+    value = 5000;
+    assert(heap_update(heap, handles[0], &value));
+    assert(*(const uint64_t *)heap_get(heap, handles[0]) == 5000);
+
+    // Removed handles are invalid and reused
+    assert(heap_remove(heap, handles[10]));
+    assert(heap_get(heap, handles[10]) == NULL);
+    assert(heap_remove(heap, handles[10]) == 0);
+    assert(heap_update(heap, handles[10], &value) == 0);
+    size_t handle;
+    value = 2;
+    assert(heap_push_handle(heap, &value, &handle));
+    assert(handle == handles[10]);
+    assert(heap_size(heap) == 200);
+
+    size_t popped;
+    assert(heap_pop_handle(heap, &value, &popped));
+    assert(value == 1 && popped == handles[150]);
+    assert(heap_get(heap, popped) == NULL);
+    assert(heap_pop_handle(heap, &value, &popped));
+    assert(value == 2 && popped == handles[10]);
+
+    // The rest comes out sorted, with every handle still pointing at its element
+    uint64_t last = 0;
+    while (heap_size(heap) > 0) {
+        const uint64_t top = *(const uint64_t *)heap_peek(heap);
+        assert(heap_pop_handle(heap, &value, &popped));
+        assert(value == top && value >= last);
+        assert(heap_get(heap, popped) == NULL);
+        assert(popped == handles[0] || popped == handles[value - 1000]);
+        last = value;
+    }
+    assert(last == 5000);
+    heap_free(heap);
+
+    // Handles need an indexed heap
+    Heap *plain = heap_init(NULL, NULL, sizeof(uint64_t), 4, NULL);
+    assert(heap_push_handle(plain, &value, &handle) == 0);
+    assert(heap_get(plain, 0) == NULL);
+    heap_free(plain);
+}
@@ -0,0 +1,369 @@
+// Header file
+#include "../include/map.h"
+#include "../include/concurrent_map.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+void test_map(void) {
+    Map *map = map_init(malloc, free, NULL, sizeof(uint64_t), sizeof(uint32_t));
+    assert(map != NULL);
+
+    for (uint64_t i = 0; i < 10000; ++i) {
+        uint32_t value = (uint32_t)(i * 3);
+        assert(map_put(map, &i, &value) != NULL);
+    }
+    assert(map_size(map) == 10000);
+
+    // Overwrite in place
+    uint64_t key = 42;
+    uint32_t value = 7;
+    map_put(map, &key, &value);
+    assert(*(uint32_t *)map_get(map, &key) == 7);
+    assert(map_size(map) == 10000);
+
+    for (uint64_t i = 0; i < 10000; i += 2) {
+        assert(map_remove(map, &i) == 1);
+        assert(map_remove(map, &i) == 0);
+    }
+    assert(map_size(map) == 5000);
+
+    for (uint64_t i = 0; i < 10000; ++i) {
+        uint32_t *found = map_get(map, &i);
+        if (i % 2 == 0) {
+            assert(found == NULL);
+        } else {
+            assert(found != NULL && *found == (i == 42 ? 7 : i * 3));
+        }
+    }
+
+    map_free(map);
+}
+
+
+
+void test_map_rehash(void) {
+    Map *map = map_init(malloc, free, NULL, sizeof(uint32_t), sizeof(uint32_t));
+    assert(map != NULL);
+
+    // 12 entries fill the initial table, the 13th starts a rehash
+    for (uint32_t i = 0; i < 13; ++i) {
+        map_put(map, &i, &i);
+    }
+
+    // Lookups, overwrites and removals see both tables while it is pending
+    assert(map_rehash_step(map, 0) == 1);
+    for (uint32_t i = 0; i < 13; ++i) {
+        assert(*(uint32_t *)map_get(map, &i) == i);
+    }
+    uint32_t key = 3;
+    uint32_t value = 30;
+    map_put(map, &key, &value);
+    key = 5;
+    assert(map_remove(map, &key) == 1);
+    assert(map_get(map, &key) == NULL);
+    assert(map_size(map) == 12);
+
+    assert(map_rehash_step(map, SIZE_MAX) == 0);
+    for (uint32_t i = 0; i < 13; ++i) {
+        uint32_t *found = map_get(map, &i);
+        if (i == 5) {
+            assert(found == NULL);
+        } else {
+            assert(found != NULL && *found == (i == 3 ? 30 : i));
+        }
+    }
+
+    map_free(map);
+}
+
+
+
+#define CMAP_TEST_THREADS 8
+#define CMAP_TEST_KEYS 20000
+
+typedef struct {
+    ConcurrentMap *map;
+    uint64_t base;
+} ConcurrentMapWorker;
+
+static void *concurrent_map_worker(void *arg) {
+    ConcurrentMap *map = ((ConcurrentMapWorker *)arg)->map;
+    const uint64_t base = ((ConcurrentMapWorker *)arg)->base;
+
+    // Every thread owns its own keys, so what it reads back is what it wrote
+    for (uint64_t i = 0; i < CMAP_TEST_KEYS; ++i) {
+        uint64_t key = base * CMAP_TEST_KEYS + i;
+        uint64_t value = key * 2;
+        assert(concurrent_map_put(map, &key, &value) == 1);
+    }
+    for (uint64_t i = 0; i < CMAP_TEST_KEYS; i += 2) {
+        uint64_t key = base * CMAP_TEST_KEYS + i;
+        uint64_t value;
+        assert(concurrent_map_get(map, &key, &value) == 1 && value == key * 2);
+        assert(concurrent_map_remove(map, &key) == 1);
+        assert(concurrent_map_get(map, &key, NULL) == 0);
+    }
+    return NULL;
+}
+
+void test_concurrent_map(void) {
+    ConcurrentMap *map = concurrent_map_init(malloc, free, NULL, sizeof(uint64_t), sizeof(uint64_t), 6);
+    assert(map != NULL);
+
+    pthread_t threads[CMAP_TEST_THREADS];
+    ConcurrentMapWorker workers[CMAP_TEST_THREADS];
+    for (size_t i = 0; i < CMAP_TEST_THREADS; ++i) {
+        workers[i].map = map;
+        workers[i].base = i;
+        assert(pthread_create(&threads[i], NULL, concurrent_map_worker, &workers[i]) == 0);
+    }
+    for (size_t i = 0; i < CMAP_TEST_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    assert(concurrent_map_size(map) == CMAP_TEST_THREADS * CMAP_TEST_KEYS / 2);
+    for (uint64_t key = 1; key < CMAP_TEST_THREADS * CMAP_TEST_KEYS; key += 2) {
+        uint64_t value;
+        assert(concurrent_map_get(map, &key, &value) == 1 && value == key * 2);
+    }
+
+    concurrent_map_free(map);
+}
+
+
+
+static uint64_t hash_collide(const void *key, size_t len, uint64_t seed) {
+    (void)key;
+    (void)len;
+    (void)seed;
+    return 0x0123456789ABCDEFull;
+}
+
+void test_map_collisions(void) {
+    Map *map = map_init(malloc, free, hash_collide, sizeof(uint32_t), sizeof(uint32_t));
+    assert(map != NULL);
+
+    // Every key has the same home and tag, the map degrades but stays correct
+    for (uint32_t i = 0; i < 200; ++i) {
+        map_put(map, &i, &i);
+    }
+    for (uint32_t i = 0; i < 200; i += 3) {
+        assert(map_remove(map, &i) == 1);
+    }
+    for (uint32_t i = 0; i < 200; ++i) {
+        uint32_t *found = map_get(map, &i);
+        assert((found != NULL) == (i % 3 != 0));
+        assert(found == NULL || *found == i);
+    }
+
+    map_free(map);
+}
+
+
+
+void test_map_str(void) {
+    Map *map = map_init_str(malloc, free, NULL, sizeof(uint32_t));
+    assert(map != NULL);
+
+    // Short keys stay inline, long ones go to the arena
+    char key[64];
+    for (uint32_t i = 0; i < 5000; ++i) {
+        const int len = snprintf(key, sizeof(key), i % 2 ? "user-%u" : "tenant-with-a-long-name-%u", i);
+        assert(map_put_str(map, key, (size_t)len, &i) != NULL);
+    }
+    assert(map_size(map) == 5000);
+    assert(map_put(map, &key, NULL) == NULL);
+
+    // The map keeps its own copy of long keys
+    memset(key, 'x', sizeof(key));
+
+    // Empty key
+    uint32_t value = 1;
+    assert(map_put_str(map, "", 0, &value) != NULL);
+    assert(*(uint32_t *)map_get_str(map, "", 0) == 1);
+
+    for (uint32_t i = 0; i < 5000; i += 3) {
+        const int len = snprintf(key, sizeof(key), i % 2 ? "user-%u" : "tenant-with-a-long-name-%u", i);
+        assert(map_remove_str(map, key, (size_t)len) == 1);
+    }
+    for (uint32_t i = 0; i < 5000; ++i) {
+        const int len = snprintf(key, sizeof(key), i % 2 ? "user-%u" : "tenant-with-a-long-name-%u", i);
+        uint32_t *found = map_get_str(map, key, (size_t)len);
+        assert((found != NULL) == (i % 3 != 0));
+        assert(found == NULL || *found == i);
+
+        // An extension of a key is a different key
+        key[len] = '!';
+        assert(map_get_str(map, key, (size_t)len + 1) == NULL);
+    }
+
+    map_free(map);
+}
+
+
+
+static void count_evictions(const void *key, void *value, void *ctx) {
+    assert(*(const uint32_t *)key == *(uint32_t *)value);
+    (*(size_t *)ctx)++;
+}
+
+void test_map_cache(void) {
+    size_t evicted = 0;
+    Map *map = map_init_cache(malloc, free, NULL, sizeof(uint32_t), sizeof(uint32_t), 100, 0,
+            count_evictions, &evicted);
+    assert(map != NULL);
+
+    // Key 0 is used all the time, so the clock never evicts it
+    uint32_t hot = 0;
+    map_put(map, &hot, &hot);
+    for (uint32_t i = 1; i < 1000; ++i) {
+        map_put(map, &i, &i);
+        assert(map_size(map) <= 100);
+        assert(map_get(map, &hot) != NULL);
+    }
+    assert(map_size(map) == 100);
+    assert(*(uint32_t *)map_get(map, &(uint32_t){999}) == 999);
+
+    MapCacheStats stats;
+    map_cache_stats(map, &stats);
+    assert(stats.evictions == 900 && evicted == 900);
+    assert(stats.hits == 1000 && stats.misses == 0);
+    assert(map_get(map, &(uint32_t){1}) == NULL);
+    map_cache_stats(map, &stats);
+    assert(stats.misses == 1);
+
+    // Entries that are left are handed to the callback on free
+    map_free(map);
+    assert(evicted == 1000);
+
+    // A byte budget bounds the table
+    map = map_init_cache(malloc, free, NULL, sizeof(uint32_t), sizeof(uint32_t), 0, 4096, NULL, NULL);
+    assert(map != NULL);
+    for (uint32_t i = 0; i < 10000; ++i) {
+        map_put(map, &i, &i);
+    }
+    assert(map_size(map) > 0 && map_size(map) * (2 * sizeof(uint32_t) + 2) <= 4096);
+    map_free(map);
+
+    assert(map_init_cache(malloc, free, NULL, sizeof(uint32_t), sizeof(uint32_t), 0, 0, NULL, NULL) == NULL);
+}
+
+
+
+void test_static_map(void) {
+    const char *path = "build/test_static_map.bin";
+    const size_t count = 20000;
+    uint64_t *keys = malloc(count * sizeof(uint64_t));
+    uint32_t *values = malloc(count * sizeof(uint32_t));
+    assert(keys != NULL && values != NULL);
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = i * 0x9E3779B97F4A7C15ull;
+        values[i] = (uint32_t)i;
+    }
+
+    StaticMap *map = map_build_static(malloc, free, keys, values, count, sizeof(uint64_t), sizeof(uint32_t));
+    assert(map != NULL && static_map_size(map) == count);
+
+    // Index overhead is a few bits per key on top of the slots
+    assert(static_map_bytes(map) < count * (2 * sizeof(uint64_t) + 1) + 128);
+    assert(static_map_save(map, path) == 0);
+
+    StaticMap *loaded = static_map_load(path, malloc, free);
+    StaticMap *mapped = static_map_map(path, malloc, free);
+    assert(loaded != NULL && mapped != NULL);
+    for (size_t i = 0; i < count; ++i) {
+        assert(*(const uint32_t *)static_map_get(map, &keys[i]) == i);
+        assert(*(const uint32_t *)static_map_get(loaded, &keys[i]) == i);
+        assert(*(const uint32_t *)static_map_get(mapped, &keys[i]) == i);
+
+        const uint64_t missing = keys[i] + 1;
+        assert(static_map_get(map, &missing) == NULL);
+    }
+    static_map_free(mapped);
+    static_map_free(loaded);
+    static_map_free(map);
+    remove(path);
+
+    // Duplicates cannot be told apart
+    keys[1] = keys[0];
+    assert(map_build_static(malloc, free, keys, values, count, sizeof(uint64_t), sizeof(uint32_t)) == NULL);
+
+    // Empty sets and sets without values
+    map = map_build_static(malloc, free, NULL, NULL, 0, sizeof(uint64_t), 0);
+    assert(map != NULL && static_map_get(map, &keys[0]) == NULL);
+    static_map_free(map);
+    map = map_build_static(malloc, free, keys + 1, NULL, 3, sizeof(uint64_t), 0);
+    assert(map != NULL && static_map_get(map, &keys[2]) != NULL);
+    static_map_free(map);
+
+    free(values);
+    free(keys);
+}
+
+
+
+void test_map_batch(void) {
+    Map *map = map_init(malloc, free, NULL, sizeof(uint64_t), sizeof(uint64_t));
+    assert(map != NULL);
+
+    const size_t count = 1000;
+    uint64_t keys[1000];
+    uint64_t values[1000];
+    void *out[1000];
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = i * 7;
+        values[i] = i;
+    }
+    assert(map_put_batch(map, keys, values, count) == count);
+    assert(map_size(map) == count);
+
+    // Every other key is missing
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = i * 7 + (i % 2);
+    }
+    assert(map_get_batch(map, keys, count, out) == count / 2);
+    for (size_t i = 0; i < count; ++i) {
+        assert(i % 2 ? out[i] == NULL : *(uint64_t *)out[i] == i);
+    }
+
+    // Without values new keys are zeroed
+    assert(map_put_batch(map, keys, NULL, count) == count);
+    assert(map_size(map) == count + count / 2);
+    assert(map_get_batch(map, keys, count, out) == count);
+    assert(*(uint64_t *)out[1] == 0 && *(uint64_t *)out[2] == 2);
+
+    map_free(map);
+}
+
+
+
+void test_map_stats(void) {
+    Map *map = map_init(malloc, free, NULL, sizeof(uint64_t), sizeof(uint64_t));
+    assert(map != NULL);
+    for (uint64_t i = 0; i < 1000; ++i) {
+        map_put(map, &i, &i);
+    }
+    for (uint64_t i = 0; i < 1000; ++i) {
+        assert(map_get(map, &i) != NULL);
+    }
+
+    MapStats stats;
+    map_stats(map, &stats);
+    assert(stats.size == 1000 && stats.capacity >= 1334);
+    assert(stats.table_bytes >= stats.capacity * 2 * sizeof(uint64_t));
+    assert(stats.avg_displacement < 4 && stats.max_displacement < stats.capacity);
+    if (stats.counting) {
+        assert(stats.probes >= 2000 && stats.probe_slots >= stats.probes);
+        assert(stats.max_probe >= 1 && stats.max_probe <= stats.capacity);
+        assert(stats.alloc.allocs > 1 && stats.alloc.live_bytes >= stats.table_bytes);
+    } else {
+        assert(stats.probes == 0 && stats.max_probe == 0 && stats.alloc.allocs == 0);
+    }
+
+    map_free(map);
+}
@@ -0,0 +1,59 @@
+// Header file
+#include "../include/perf.h"
+#include "../include/vector.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+void test_perf() {
+    for (int event = 0; event < DS_PERF_EVENTS; ++event) {
+        assert(ds_perf_event_name((DsPerfEvent)event) != NULL);
+    }
+    assert(ds_perf_event_name(DS_PERF_EVENTS) == NULL);
+    assert(strcmp(ds_perf_event_name(DS_PERF_CYCLES), "cycles") == 0);
+
+    DsPerf *perf = ds_perf_init();
+    assert(perf != NULL);
+    assert(!ds_perf_available(perf, DS_PERF_EVENTS));
+    assert(!ds_perf_available(NULL, DS_PERF_CYCLES));
+
+    // Counters may be forbidden here, the time is always measured
+    DsPerfCounts counts;
+    ds_perf_begin(perf);
+    Vector *vec = vector_init(malloc, free, sizeof(uint64_t));
+    for (uint64_t i = 0; i < 100000; ++i) {
+        vector_insert(vec, &i, sizeof(i));
+    }
+    ds_perf_end(perf, &counts);
+    assert(vector_size(vec) == 100000);
+    vector_free(vec);
+    assert(counts.ns > 0);
+    for (int event = 0; event < DS_PERF_EVENTS; ++event) {
+        if (!(counts.available & (1u << event))) {
+            assert(counts.value[event] == 0);
+        } else {
+            assert(ds_perf_available(perf, (DsPerfEvent)event));
+        }
+    }
+    if (counts.available & (1u << DS_PERF_INSTRUCTIONS)) {
+        assert(counts.value[DS_PERF_INSTRUCTIONS] > 100000);
+    }
+    // Growing to 1 MiB touches fresh pages
+    if (counts.available & (1u << DS_PERF_PAGE_FAULTS)) {
+        assert(counts.value[DS_PERF_PAGE_FAULTS] > 0);
+    }
+
+    // Every measurement starts at 0
+    DsPerfCounts empty;
+    ds_perf_begin(perf);
+    ds_perf_end(perf, &empty);
+    if (empty.available & counts.available & (1u << DS_PERF_INSTRUCTIONS)) {
+        assert(empty.value[DS_PERF_INSTRUCTIONS] < counts.value[DS_PERF_INSTRUCTIONS]);
+    }
+
+    ds_perf_free(perf);
+    ds_perf_free(NULL);
+}
@@ -0,0 +1,101 @@
+// Header file
+#include "../include/map.h"
+#include "../include/trace.h"
+#include "../include/tree.h"
+#include "../include/vector.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+void test_trace() {
+    const char *path = "build/test_trace.bin";
+
+    // Small integer keys keep their value, long keys are hashed
+    const uint32_t small = 0x01020304;
+    assert(ds_trace_key(&small, sizeof(small)) == 0x01020304);
+    assert(ds_trace_key("0123456789", 10) == ds_trace_key("0123456789", 10));
+    assert(ds_trace_key("0123456789", 10) != ds_trace_key("0123456788", 10));
+
+    DsTrace *trace = ds_trace_open(path);
+    assert(trace != NULL);
+    for (uint64_t i = 0; i < 10000; ++i) {
+        ds_trace_record(trace, DS_TRACE_MAP, DS_TRACE_INSERT, i, 8);
+    }
+    ds_trace_record(trace, DS_TRACE_TREE, DS_TRACE_FIND, UINT64_MAX, 0);
+    ds_trace_record(trace, DS_TRACE_VECTOR, DS_TRACE_REMOVE, 0, 0);
+    assert(ds_trace_size(trace) == 10002);
+    assert(ds_trace_close(trace));
+
+    size_t count;
+    DsTraceRecord *records = ds_trace_load(path, &count);
+    assert(records != NULL);
+    assert(count == 10002);
+    for (uint64_t i = 0; i < 10000; ++i) {
+        assert(records[i].op == DS_TRACE_INSERT);
+        assert(records[i].source == DS_TRACE_MAP);
+        assert(records[i].key == i);
+        assert(records[i].size == 8);
+        assert(i == 0 || records[i].ns >= records[i - 1].ns);
+    }
+    assert(records[10000].op == DS_TRACE_FIND && records[10000].source == DS_TRACE_TREE);
+    assert(records[10000].key == UINT64_MAX);
+    assert(records[10001].op == DS_TRACE_REMOVE && records[10001].key == 0);
+    free(records);
+
+    // Containers only record in DS_TRACE builds
+    trace = ds_trace_open(path);
+    assert(trace != NULL);
+    Map *map = map_init(malloc, free, NULL, sizeof(uint64_t), sizeof(uint32_t));
+    Tree *tree = tree_init_map(sizeof(uint64_t), sizeof(uint64_t), malloc, free, NULL);
+    Vector *vec = vector_init(malloc, free, sizeof(uint16_t));
+    const int recording = map_set_trace(map, trace);
+    assert(tree_set_trace(tree, trace) == recording);
+    assert(vector_set_trace(vec, trace) == recording);
+    assert(!map_set_trace(NULL, trace));
+
+    const uint64_t key = 42, value = 7;
+    const uint16_t elem = 1;
+    map_put(map, &key, &value);
+    map_get(map, &key);
+    map_remove(map, &key);
+    tree_upsert(tree, &key, &value);
+    tree_delete(tree, &key);
+    vector_insert(vec, (void *)&elem, sizeof(elem));
+    vector_at(vec, 0);
+    assert(ds_trace_size(trace) == (recording ? 7u : 0u));
+
+    map_set_trace(map, NULL);
+    map_get(map, &key);
+    assert(ds_trace_size(trace) == (recording ? 7u : 0u));
+    assert(ds_trace_close(trace));
+
+    records = ds_trace_load(path, &count);
+    assert(records != NULL);
+    assert(count == (recording ? 7u : 0u));
+    if (recording) {
+        assert(records[0].source == DS_TRACE_MAP && records[0].op == DS_TRACE_INSERT);
+        assert(records[0].key == 42 && records[0].size == sizeof(uint32_t));
+        assert(records[1].op == DS_TRACE_FIND && records[2].op == DS_TRACE_REMOVE);
+        assert(records[3].source == DS_TRACE_TREE && records[3].size == sizeof(uint64_t));
+        assert(records[4].op == DS_TRACE_REMOVE && records[4].key == 42);
+        assert(records[5].source == DS_TRACE_VECTOR && records[5].key == 0);
+        assert(records[6].op == DS_TRACE_FIND);
+    }
+    free(records);
+
+    map_free(map);
+    tree_free(tree);
+    vector_free(vec);
+
+    // Not a trace
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    fputs("not a trace", file);
+    fclose(file);
+    assert(ds_trace_load(path, &count) == NULL);
+    remove(path);
+}
@@ -0,0 +1,323 @@
+// Header file
+#include "../include/tree.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+static int compare_u32(const void *a, const void *b, size_t size) {
+    (void)size;
+    const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+
+void test_tree(void) {
+    Tree *tree = tree_init(sizeof(uint32_t), malloc, free, compare_u32);
+    assert(tree != NULL);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        uint32_t value = (i * 7919) % 1000;
+        tree_insert(tree, &value, sizeof(value));
+    }
+    assert(tree_size(tree) == 1000);
+
+    for (uint32_t i = 0; i < 1000; i += 2) {
+        tree_delete(tree, &i);
+    }
+    assert(tree_size(tree) == 500);
+
+    for (uint32_t i = 0; i < 1000; ++i) {
+        const uint32_t *found = tree_lookup(tree, &i);
+        assert((found != NULL) == (i % 2 == 1));
+    }
+    tree_free(tree);
+}
+
+
+
+void test_tree_map(void) {
+    Tree *counters = tree_init_map(sizeof(uint32_t), sizeof(uint64_t), malloc, free, compare_u32);
+    assert(counters != NULL);
+
+    for (uint32_t i = 0; i < 300; ++i) {
+        uint32_t id = i % 30;
+        int inserted;
+        uint64_t *count = tree_get_or_insert(counters, &id, &inserted);
+        assert(count != NULL);
+        assert(inserted == (i < 30));
+        *count += 1;
+    }
+    assert(tree_size(counters) == 30);
+
+    uint32_t id = 7;
+    assert(*(uint64_t *)tree_get_value(counters, &id) == 10);
+
+    uint64_t reset = 0;
+    tree_upsert(counters, &id, &reset);
+    assert(*(uint64_t *)tree_get_value(counters, &id) == 0);
+
+    id = 1000;
+    assert(tree_get_value(counters, &id) == NULL);
+
+    tree_free(counters);
+}
+
+
+
+void test_tree_freeze(void) {
+    Tree *tree = tree_init(sizeof(uint32_t), malloc, free, compare_u32);
+    assert(tree != NULL);
+
+    for (uint32_t i = 0; i < 1000; i += 3) {
+        tree_insert(tree, &i, sizeof(i));
+    }
+
+    FrozenTree *frozen = tree_freeze(tree);
+    assert(frozen != NULL);
+    assert(frozen_size(frozen) == tree_size(tree));
+
+    for (uint32_t i = 0; i < 1002; ++i) {
+        const uint32_t *found = frozen_lookup(frozen, &i);
+        assert((found != NULL) == (i % 3 == 0));
+        assert(found == NULL || *found == i);
+        assert(frozen_lookup_u32(frozen, i) == (const void *)found);
+    }
+
+    frozen_free(frozen);
+    tree_free(tree);
+}
+
+
+
+void test_tree_snapshot(void) {
+    const char *path = "build/test_tree_snapshot.bin";
+    Tree *tree = tree_init_map(sizeof(uint32_t), sizeof(uint64_t), malloc, free, compare_u32);
+    assert(tree != NULL);
+    for (uint32_t i = 0; i < 777; ++i) {
+        uint64_t value = (uint64_t)i * i;
+        tree_upsert(tree, &i, &value);
+    }
+    assert(tree_save(tree, path) == 0);
+
+    Tree *loaded = tree_load(path, malloc, free, compare_u32);
+    assert(loaded != NULL);
+    assert(tree_size(loaded) == 777);
+    for (uint32_t i = 0; i < 777; ++i) {
+        assert(*(uint64_t *)tree_get_value(loaded, &i) == (uint64_t)i * i);
+    }
+
+    // The loaded tree keeps working like any other
+    uint32_t key = 5000;
+    tree_get_or_insert(loaded, &key, NULL);
+    tree_delete(loaded, &key);
+    assert(tree_size(loaded) == 777);
+
+    tree_free(loaded);
+    tree_free(tree);
+    remove(path);
+}
+
+
+
+void test_tree_no_parent(void) {
+    Tree *tree = tree_init_ex(sizeof(uint32_t), 0, TREE_NO_PARENT, malloc, free, compare_u32);
+    assert(tree != NULL);
+
+    for (uint32_t i = 0; i < 2000; ++i) {
+        tree_insert(tree, &i, sizeof(i));
+    }
+    for (uint32_t i = 0; i < 2000; i += 4) {
+        tree_delete(tree, &i);
+    }
+    assert(tree_size(tree) == 1500);
+
+    // Freezing walks the tree in order without parent pointers
+    FrozenTree *frozen = tree_freeze(tree);
+    assert(frozen != NULL);
+    for (uint32_t i = 0; i < 2000; ++i) {
+        assert((frozen_lookup_u32(frozen, i) != NULL) == (i % 4 != 0));
+    }
+
+    frozen_free(frozen);
+    tree_free(tree);
+}
+
+
+
+void test_tree_hint(void) {
+    Tree *tree = tree_init(sizeof(uint32_t), malloc, free, compare_u32);
+    assert(tree != NULL);
+
+    // Ascending keys, each inserted next to the previous one
+    const void *last = NULL;
+    for (uint32_t i = 0; i < 3000; i += 2) {
+        last = tree_insert_hint(tree, last, &i, sizeof(i));
+        assert(last != NULL && *(const uint32_t *)last == i);
+    }
+
+    // Fill the gaps, hinting with the left neighbour
+    for (uint32_t i = 1; i < 3000; i += 2) {
+        uint32_t left = i - 1;
+        const void *hint = tree_lookup(tree, &left);
+        const uint32_t *found = tree_insert_hint(tree, hint, &i, sizeof(i));
+        assert(found != NULL && *found == i);
+    }
+
+    // A hint that is far away still inserts correctly
+    uint32_t far = 5000, zero = 0;
+    tree_insert_hint(tree, tree_lookup(tree, &zero), &far, sizeof(far));
+    assert(tree_size(tree) == 3001);
+
+    for (uint32_t i = 0; i < 3000; ++i) {
+        assert(tree_lookup(tree, &i) != NULL);
+    }
+    tree_free(tree);
+}
+
+
+
+typedef struct {
+    uint32_t lo;
+    uint32_t hi;
+} Interval;
+
+static int compare_u64(const void *a, const void *b, size_t size) {
+    (void)size;
+    const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int sum_starts(const void *elem, void *ctx) {
+    *(uint64_t *)ctx += ((const Interval *)elem)->lo;
+    return 0;
+}
+
+void test_tree_interval(void) {
+    Tree *tree = tree_init_interval(sizeof(uint32_t), 0, malloc, free, compare_u32);
+    assert(tree != NULL);
+
+    Interval intervals[500];
+    uint32_t state = 12345;
+    for (size_t i = 0; i < 500; ++i) {
+        state = state * 1103515245 + 12345;
+        intervals[i].lo = (state >> 8) % 10000;
+        intervals[i].hi = intervals[i].lo + (state >> 20) % 300;
+        tree_insert(tree, &intervals[i], sizeof(intervals[i]));
+    }
+    // Drop a few to exercise the max ends on delete
+    for (size_t i = 0; i < 500; i += 5) {
+        tree_delete(tree, &intervals[i]);
+    }
+
+    for (uint32_t lo = 0; lo < 10400; lo += 97) {
+        const uint32_t hi = lo + 50;
+        uint64_t expected_count = 0, expected_sum = 0;
+        for (size_t i = 0; i < 500; ++i) {
+            // Duplicates are only stored once
+            int duplicate = i % 5 == 0;
+            for (size_t j = 0; j < i && !duplicate; ++j) {
+                duplicate = j % 5 != 0 && intervals[j].lo == intervals[i].lo && intervals[j].hi == intervals[i].hi;
+            }
+            if (!duplicate && intervals[i].lo <= hi && intervals[i].hi >= lo) {
+                expected_count++;
+                expected_sum += intervals[i].lo;
+            }
+        }
+
+        uint64_t sum = 0;
+        assert(tree_overlaps(tree, &lo, &hi, sum_starts, &sum) == expected_count);
+        assert(sum == expected_sum);
+    }
+
+    uint32_t point = intervals[1].lo;
+    assert(tree_stab(tree, &point, NULL, NULL) >= 1);
+
+    tree_free(tree);
+
+    // A value size that is not a multiple of the point size keeps the max ends aligned
+    Tree *wide = tree_init_interval(sizeof(uint64_t), sizeof(uint32_t), malloc, free, compare_u64);
+    assert(wide != NULL);
+    for (uint64_t i = 0; i < 200; ++i) {
+        struct {
+            uint64_t lo, hi;
+            uint32_t value;
+        } interval = {i * 10, i * 10 + 25, (uint32_t)i};
+        tree_insert(wide, &interval, sizeof(uint64_t) * 2 + sizeof(uint32_t));
+    }
+    const uint64_t lo = 1000, hi = 1040;
+    assert(tree_overlaps(wide, &lo, &hi, NULL, NULL) == 7);
+    tree_free(wide);
+}
+
+
+
+void test_tree_bounds(void) {
+    Tree *tree = tree_init(sizeof(uint32_t), malloc, free, compare_u32);
+    assert(tree != NULL);
+    assert(tree_min(tree) == NULL && tree_pop_min(tree, NULL) == 0);
+
+    // Multiples of ten from 10 to 1000
+    for (uint32_t i = 100; i > 0; --i) {
+        uint32_t value = i * 10;
+        tree_insert(tree, &value, sizeof(value));
+    }
+
+    uint32_t key = 25;
+    assert(*(const uint32_t *)tree_lower_bound(tree, &key) == 30);
+    assert(*(const uint32_t *)tree_upper_bound(tree, &key) == 30);
+    assert(*(const uint32_t *)tree_floor(tree, &key) == 20);
+    key = 30;
+    assert(*(const uint32_t *)tree_ceil(tree, &key) == 30);
+    assert(*(const uint32_t *)tree_floor(tree, &key) == 30);
+    assert(*(const uint32_t *)tree_successor(tree, &key) == 40);
+    assert(*(const uint32_t *)tree_predecessor(tree, &key) == 20);
+    key = 5;
+    assert(tree_floor(tree, &key) == NULL);
+    key = 1000;
+    assert(tree_upper_bound(tree, &key) == NULL);
+
+    assert(*(const uint32_t *)tree_min(tree) == 10);
+    assert(*(const uint32_t *)tree_max(tree) == 1000);
+
+    uint32_t popped, previous = 0;
+    for (size_t i = 0; i < 50; ++i) {
+        assert(tree_pop_min(tree, &popped) == 1);
+        assert(popped > previous);
+        previous = popped;
+    }
+    assert(tree_pop_max(tree, &popped) == 1 && popped == 1000);
+    assert(*(const uint32_t *)tree_min(tree) == 510);
+    assert(*(const uint32_t *)tree_max(tree) == 990);
+    assert(tree_size(tree) == 49);
+
+    tree_free(tree);
+}
+
+
+
+void test_tree_stats(void) {
+    Tree *tree = tree_init(sizeof(uint32_t), malloc, free, compare_u32);
+    assert(tree != NULL);
+    for (uint32_t i = 0; i < 1023; ++i) {
+        tree_insert(tree, &i, sizeof(i));
+    }
+
+    TreeStats stats;
+    tree_stats(tree, &stats);
+    assert(stats.size == 1023 && stats.ideal_height == 10);
+    assert(stats.height >= 10 && stats.height <= 15);
+    assert(stats.overhead_bytes == (stats.node_bytes - sizeof(uint32_t)) * 1023);
+    if (stats.counting) {
+        // Ascending keys rotate on every other insertion
+        assert(stats.rotations > 500 && stats.compares >= 1022);
+        assert(stats.alloc.allocs == 1024 && stats.alloc.frees == 0);
+    } else {
+        assert(stats.rotations == 0 && stats.compares == 0 && stats.alloc.allocs == 0);
+    }
+
+    tree_free(tree);
+}
@@ -1,6 +1,7 @@
 
 // Header file
 #include "../include/vector.h"
+#include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,3 +21,202 @@ void test_vec(void) {
 
     vec_del(vector);
 }
+
+
+
+void test_vec_snapshot(void) {
+    const char *path = "build/test_vec_snapshot.bin";
+    Vector *vec = vector_init(malloc, free, sizeof(uint64_t));
+    assert(vec != NULL);
+    for (uint64_t i = 0; i < 1000; ++i) {
+        vector_insert(vec, &i, sizeof(i));
+    }
+    assert(vector_save(vec, path) == 0);
+
+    Vector *loaded = vector_load(path, malloc, free);
+    Vector *mapped = vector_map(path, malloc, free);
+    assert(loaded != NULL && mapped != NULL);
+    assert(vector_size(loaded) == 1000 && vector_size(mapped) == 1000);
+    for (uint64_t i = 0; i < 1000; ++i) {
+        assert(*(uint64_t *)vector_at(loaded, i) == i);
+        assert(*(uint64_t *)vector_at(mapped, i) == i);
+    }
+
+    // Growing moves the mapped vector into regular storage
+    uint64_t next = 1000;
+    vector_insert(mapped, &next, sizeof(next));
+    assert(vector_size(mapped) == 1001);
+    assert(*(uint64_t *)vector_at(mapped, 999) == 999);
+
+    vector_free(mapped);
+    vector_free(loaded);
+
+    // A count that does not fit into the file is rejected
+    FILE *file = fopen(path, "r+b");
+    assert(file != NULL);
+    const uint64_t huge = (uint64_t)1 << 63;
+    assert(fseek(file, 40, SEEK_SET) == 0); /* count field of the header */
+    assert(fwrite(&huge, sizeof(huge), 1, file) == 1);
+    fclose(file);
+    assert(vector_load(path, malloc, free) == NULL);
+    assert(vector_map(path, malloc, free) == NULL);
+
+    // So is a truncated file
+    assert(vector_save(vec, path) == 0);
+    file = fopen(path, "r+b");
+    assert(file != NULL);
+    char head[64 + 100 * sizeof(uint64_t)];
+    assert(fread(head, sizeof(head), 1, file) == 1);
+    fclose(file);
+    file = fopen(path, "wb");
+    assert(file != NULL && fwrite(head, sizeof(head), 1, file) == 1);
+    fclose(file);
+    assert(vector_load(path, malloc, free) == NULL);
+    assert(vector_map(path, malloc, free) == NULL);
+
+    vector_free(vec);
+    remove(path);
+}
+
+
+
+void test_vec_stats(void) {
+    Vector *vec = vector_init(malloc, free, sizeof(uint64_t));
+    assert(vec != NULL);
+    for (uint64_t i = 0; i < 100; ++i) {
+        vector_insert(vec, &i, sizeof(i));
+    }
+
+    VectorStats stats;
+    vector_stats(vec, &stats);
+    assert(stats.len == 100 && stats.cap == 128);
+    assert(stats.slack_bytes == 28 * sizeof(uint64_t));
+    if (stats.counting) {
+        // 4 -> 8 -> ... -> 128
+        assert(stats.grows == 5);
+        assert(stats.alloc.allocs == 2 + 5 && stats.alloc.frees == 5);
+        assert(stats.alloc.live_bytes > 128 * sizeof(uint64_t));
+    } else {
+        assert(stats.grows == 0 && stats.copy_bytes == 0 && stats.alloc.allocs == 0);
+    }
+
+    vector_free(vec);
+    vector_stats(NULL, &stats);
+    assert(stats.len == 0);
+}
+
+
+
+static void par_square(void *elem, void *ctx) {
+    (void)ctx;
+    uint64_t *value = elem;
+    *value *= *value;
+}
+
+static void par_half(const void *in, void *out, void *ctx) {
+    (void)ctx;
+    *(uint32_t *)out = (uint32_t)(*(const uint64_t *)in / 2);
+}
+
+static void par_add(void *acc, const void *value, void *ctx) {
+    (void)ctx;
+    *(uint64_t *)acc += *(const uint64_t *)value;
+}
+
+/// Not commutative, checks that reduce combines in order
+static void par_concat(void *acc, const void *value, void *ctx) {
+    (void)ctx;
+    uint64_t *pair = acc;
+    const uint64_t *other = value;
+    if (pair[0] == UINT64_MAX) {
+        pair[0] = other[0];
+    }
+    if (other[1] != UINT64_MAX) {
+        pair[1] = other[1];
+    }
+}
+
+static void par_concat_fold(void *acc, const void *value, void *ctx) {
+    const uint64_t index = *(const uint64_t *)value;
+    const uint64_t pair[2] = {index, index};
+    par_concat(acc, pair, ctx);
+}
+
+static int par_odd(const void *elem, void *ctx) {
+    (void)ctx;
+    return *(const uint64_t *)elem & 1;
+}
+
+void test_vec_par(void) {
+    const size_t n = 100003;
+    const VecParConfig configs[] = {{1, 0}, {4, 0}, {4, 1000}, {16, 7}};
+
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); ++c) {
+        const VecParConfig *config = &configs[c];
+        Vector *vec = vector_init(malloc, free, sizeof(uint64_t));
+        assert(vec != NULL);
+        for (uint64_t i = 0; i < n; ++i) {
+            vector_insert(vec, &i, sizeof(i));
+        }
+
+        // Reduce before anything changes the elements
+        uint64_t sum = 0;
+        assert(vector_par_reduce(vec, &sum, sizeof(sum), par_add, par_add, NULL, config));
+        assert(sum == (uint64_t)n * (n - 1) / 2);
+        uint64_t ends[2] = {UINT64_MAX, UINT64_MAX};
+        assert(vector_par_reduce(vec, ends, sizeof(ends), par_concat_fold, par_concat, NULL, config));
+        assert(ends[0] == 0 && ends[1] == n - 1);
+
+        Vector *halves = vector_init(malloc, free, sizeof(uint32_t));
+        assert(vector_par_map(vec, halves, par_half, NULL, config));
+        assert(vector_size(halves) == n);
+        for (uint64_t i = 0; i < n; ++i) {
+            assert(*(uint32_t *)vector_at(halves, i) == i / 2);
+        }
+        const uint32_t after = 7;
+        vector_insert(halves, (void *)&after, sizeof(after));
+        assert(*(uint32_t *)vector_at(halves, n) == 7);
+        vector_free(halves);
+
+        // Stable, odd ones first
+        size_t odd = 0;
+        assert(vector_par_partition(vec, par_odd, NULL, &odd, config));
+        assert(odd == n / 2);
+        for (uint64_t i = 0; i < n; ++i) {
+            const uint64_t expected = i < odd ? 2 * i + 1 : 2 * (i - odd);
+            assert(*(uint64_t *)vector_at(vec, i) == expected);
+        }
+
+        assert(vector_par_for_each(vec, par_square, NULL, config));
+        assert(*(uint64_t *)vector_at(vec, 1) == 9);
+        assert(*(uint64_t *)vector_at(vec, n - 1) == (uint64_t)(2 * (n - 1 - odd)) * (2 * (n - 1 - odd)));
+
+        // Prefix sums of all ones count up
+        const uint64_t one = 1;
+        Vector *ones = vector_init(malloc, free, sizeof(uint64_t));
+        for (size_t i = 0; i < n; ++i) {
+            vector_insert(ones, (void *)&one, sizeof(one));
+        }
+        assert(vector_par_scan(ones, par_add, NULL, config));
+        for (uint64_t i = 0; i < n; ++i) {
+            assert(*(uint64_t *)vector_at(ones, i) == i + 1);
+        }
+        vector_free(ones);
+        vector_free(vec);
+    }
+
+    // Empty vectors and bad arguments
+    Vector *empty = vector_init(malloc, free, sizeof(uint64_t));
+    uint64_t sum = 5;
+    assert(vector_par_reduce(empty, &sum, sizeof(sum), par_add, par_add, NULL, NULL));
+    assert(sum == 5);
+    assert(vector_par_scan(empty, par_add, NULL, NULL));
+    size_t odd = 1;
+    assert(vector_par_partition(empty, par_odd, NULL, &odd, NULL));
+    assert(odd == 0);
+    assert(!vector_par_for_each(NULL, par_square, NULL, NULL));
+    assert(!vector_par_map(empty, empty, par_half, NULL, NULL));
+    vector_free(empty);
+
+    vector_par_shutdown();
+}